@@ -0,0 +1,68 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "kvstore/key_codec.hpp"
+
+using namespace husky;
+using Key = husky::constants::Key;
+
+/*
+ *
+ * A benchmark to compare the wire encodings of the keys in Push/Pull
+ *
+ * ./KeyCodecBench [num_keys] [avg_gap] [num_rounds]
+ *
+ * For sparse sorted keys (avg_gap > 1) and dense keys (avg_gap = 1), report for each codec
+ * the encoded bytes per key, the encoding/decoding throughput (keys/s) and the equivalent bytes/s on wire.
+ */
+void Bench(const std::string& name, const std::vector<Key>& keys, int num_rounds) {
+    kvstore::pslite::SArray<Key> sarray(keys);
+    for (auto codec : {kvstore::KeyCodec::kRaw, kvstore::KeyCodec::kDeltaVarint, kvstore::KeyCodec::kDeltaVarintRuns}) {
+        size_t bytes = 0;
+        double encode_time = 0, decode_time = 0;
+        for (int i = 0; i < num_rounds; ++ i) {
+            base::BinStream bin;
+            auto t1 = std::chrono::steady_clock::now();
+            kvstore::EncodeKeys(codec, sarray, bin);
+            auto t2 = std::chrono::steady_clock::now();
+            bytes = bin.size();
+            kvstore::pslite::SArray<Key> res;
+            kvstore::DecodeKeys(bin, &res);
+            auto t3 = std::chrono::steady_clock::now();
+            encode_time += std::chrono::duration<double>(t2 - t1).count();
+            decode_time += std::chrono::duration<double>(t3 - t2).count();
+            if (res.size() != keys.size()) {
+                std::cerr << "decode error" << std::endl;
+                exit(1);
+            }
+        }
+        double total_keys = static_cast<double>(keys.size()) * num_rounds;
+        std::cout << name << " codec " << static_cast<int>(codec)
+            << ": bytes/key " << static_cast<double>(bytes) / keys.size()
+            << ", encode " << total_keys / encode_time / 1e6 << " Mkeys/s"
+            << ", decode " << total_keys / decode_time / 1e6 << " Mkeys/s"
+            << ", wire " << bytes * num_rounds / (encode_time + decode_time) / 1e6 << " MB/s" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t num_keys = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    int avg_gap = argc > 2 ? std::stoi(argv[2]) : 50;
+    int num_rounds = argc > 3 ? std::stoi(argv[3]) : 10;
+
+    std::mt19937_64 gen(0);
+    std::uniform_int_distribution<int> gap_dist(1, 2 * avg_gap - 1);
+    std::vector<Key> sparse(num_keys), dense(num_keys);
+    Key key = 0;
+    for (size_t i = 0; i < num_keys; ++ i) {
+        key += gap_dist(gen);
+        sparse[i] = key;
+        dense[i] = i;
+    }
+    Bench("sparse", sparse, num_rounds);
+    Bench("dense", dense, num_rounds);
+    return 0;
+}
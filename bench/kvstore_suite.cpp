@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "kvstore/kvstore.hpp"
+#include "kvstore/latency_histogram.hpp"
+#include "worker/engine.hpp"
+
+#include "core/color.hpp"
+
+using namespace husky;
+using Key = husky::constants::Key;
+
+/*
+ *
+ * A benchmark suite for the Push/Pull path of the kvstore
+ *
+ * Sweep the hints (storage and consistency), the value types, the number of workers, the key
+ * distributions and the batch sizes. Each worker runs num_iters rounds of Pull then Push on a
+ * fresh batch, and the latencies of each operation are recorded after num_warmup rounds.
+ * For each setting, report the throughput (keys/s, summed over the workers) and the
+ * mean/p50/p99/p999/max latency of Pull and Push, in the log and as csv in output.<proc_id>.
+ *
+ * The number of servers is fixed in a run (num_servers_per_process), sweep it across runs.
+ * To run several processes on one machine, list localhost once per process in [worker] and
+ * start each process with its own worker_port.
+ *
+ * num_keys=1000000                      # the key space
+ * hints=default_add_vector,bsp_add_map  # default: {default,bsp,ssp}_add_{vector,map}
+ * val_types=float,double                # default: float,double
+ * num_workers=1,4                       # default: 1,4
+ * distributions=dense,uniform,zipf      # default: dense,uniform,zipf
+ * batch_sizes=100,10000                 # default: 100,10000
+ * zipf_s=0.99                           # default: 0.99
+ * num_iters=200                         # default: 200
+ * num_warmup=10                         # default: 10
+ * staleness=1                           # for ssp, default: 1
+ * num_servers_per_process=1             # default: 1
+ * output=kvstore_bench.csv              # default: kvstore_bench.csv
+ */
+
+std::string GetParam(const std::string& key, const std::string& default_val) {
+    std::string val = Context::get_param(key);
+    return val == "" ? default_val : val;
+}
+
+std::vector<std::string> Split(const std::string& str) {
+    std::vector<std::string> res;
+    std::stringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty())
+            res.push_back(item);
+    return res;
+}
+
+struct OpResult {
+    kvstore::LatencyHistogram latency;  // ns
+    uint64_t num_keys = 0;
+    double throughput = 0;  // keys/s, summed over the workers
+
+    void Merge(const OpResult& other) {
+        latency.Merge(other.latency);
+        num_keys += other.num_keys;
+        throughput += other.throughput;
+    }
+};
+
+/*
+ * The sorted keys of one batch
+ */
+class KeyGenerator {
+   public:
+    KeyGenerator(const std::string& distribution, Key num_keys, int batch_size, double zipf_s, int seed)
+        : distribution_(distribution), num_keys_(num_keys), batch_size_(std::min<Key>(batch_size, num_keys)), rng_(seed) {
+        if (distribution_ == "zipf") {
+            // the cdf of the ranks, the hot keys are spread over the key space
+            cdf_.resize(num_keys_);
+            double sum = 0;
+            for (Key i = 0; i < num_keys_; ++ i) {
+                sum += 1.0 / std::pow(i + 1, zipf_s);
+                cdf_[i] = sum;
+            }
+        } else if (distribution_ != "dense" && distribution_ != "uniform") {
+            throw base::HuskyException("Unknown distribution: " + distribution_);
+        }
+    }
+
+    void Next(std::vector<Key>* keys) {
+        keys->clear();
+        if (distribution_ == "dense") {
+            Key begin = std::uniform_int_distribution<Key>(0, num_keys_ - batch_size_)(rng_);
+            for (Key i = 0; i < batch_size_; ++ i)
+                keys->push_back(begin + i);
+            return;
+        }
+        for (Key i = 0; i < batch_size_; ++ i) {
+            if (distribution_ == "uniform") {
+                keys->push_back(std::uniform_int_distribution<Key>(0, num_keys_ - 1)(rng_));
+            } else {
+                double r = std::uniform_real_distribution<double>(0, cdf_.back())(rng_);
+                Key rank = std::lower_bound(cdf_.begin(), cdf_.end(), r) - cdf_.begin();
+                keys->push_back(rank * 2654435761ULL % num_keys_);
+            }
+        }
+        std::sort(keys->begin(), keys->end());
+        keys->erase(std::unique(keys->begin(), keys->end()), keys->end());
+    }
+
+   private:
+    std::string distribution_;
+    Key num_keys_;
+    Key batch_size_;
+    std::mt19937_64 rng_;
+    std::vector<double> cdf_;
+};
+
+template <typename Val>
+void RunHint(const std::string& hint, const std::string& val_type, int num_workers, Key num_keys,
+             const std::vector<std::string>& distributions, const std::vector<int>& batch_sizes,
+             double zipf_s, int num_iters, int num_warmup, int staleness,
+             std::map<std::string, OpResult>* results, std::mutex* results_mu) {
+    auto& engine = Engine::Get();
+    auto task = TaskFactory::Get().CreateTask<Task>(1, num_workers);
+    int kv = kvstore::KVStore::Get().CreateKVStore<Val>(hint, num_workers, staleness, num_keys);
+    engine.AddTask(task, [=](const Info& info) {
+        auto* kvworker = kvstore::KVStore::Get().get_kvworker(info.get_local_id());
+        std::vector<Key> keys;
+        std::vector<Val> vals;
+        for (auto& distribution : distributions) {
+            for (int batch_size : batch_sizes) {
+                KeyGenerator generator(distribution, num_keys, batch_size, zipf_s, info.get_cluster_id() + 1);
+                OpResult pull, push;
+                for (int i = 0; i < num_warmup + num_iters; ++ i) {
+                    generator.Next(&keys);
+                    // Pull then Push, as required by bsp/ssp
+                    auto t1 = std::chrono::steady_clock::now();
+                    kvworker->Wait(kv, kvworker->Pull(kv, keys, &vals));
+                    auto t2 = std::chrono::steady_clock::now();
+                    std::fill(vals.begin(), vals.end(), Val(1));
+                    auto t3 = std::chrono::steady_clock::now();
+                    kvworker->Wait(kv, kvworker->Push(kv, keys, vals));
+                    auto t4 = std::chrono::steady_clock::now();
+                    if (i < num_warmup)
+                        continue;
+                    pull.latency.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+                    push.latency.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(t4 - t3).count());
+                    pull.num_keys += keys.size();
+                    push.num_keys += keys.size();
+                }
+                for (auto* res : {&pull, &push}) {
+                    double seconds = res->latency.mean() * res->latency.count() / 1e9;
+                    res->throughput = seconds > 0 ? res->num_keys / seconds : 0;
+                }
+                std::string setting = hint + "," + val_type + "," + std::to_string(num_workers) + "," + distribution +
+                                      "," + std::to_string(batch_size);
+                std::lock_guard<std::mutex> lk(*results_mu);
+                (*results)[setting + ",pull"].Merge(pull);
+                (*results)[setting + ",push"].Merge(push);
+            }
+        }
+    });
+    engine.Submit();
+}
+
+int main(int argc, char** argv) {
+    bool rt = init_with_args(argc, argv, {"worker_port", "cluster_manager_host", "cluster_manager_port", "num_keys"});
+    if (!rt)
+        return 1;
+
+    Key num_keys = std::stoull(Context::get_param("num_keys"));
+    auto hints = Split(GetParam("hints", "default_add_vector,default_add_map,bsp_add_vector,bsp_add_map,"
+                                         "ssp_add_vector,ssp_add_map"));
+    auto val_types = Split(GetParam("val_types", "float,double"));
+    auto distributions = Split(GetParam("distributions", "dense,uniform,zipf"));
+    std::vector<int> num_workers_list, batch_sizes;
+    for (auto& s : Split(GetParam("num_workers", "1,4")))
+        num_workers_list.push_back(std::stoi(s));
+    for (auto& s : Split(GetParam("batch_sizes", "100,10000")))
+        batch_sizes.push_back(std::stoi(s));
+    double zipf_s = std::stod(GetParam("zipf_s", "0.99"));
+    int num_iters = std::stoi(GetParam("num_iters", "200"));
+    int num_warmup = std::stoi(GetParam("num_warmup", "10"));
+    int staleness = std::stoi(GetParam("staleness", "1"));
+    int num_servers_per_process = std::stoi(GetParam("num_servers_per_process", "1"));
+    std::string output = GetParam("output", "kvstore_bench.csv");
+
+    auto& engine = Engine::Get();
+    // Start the kvstore, should start after mailbox is up
+    kvstore::KVStore::Get().Start(Context::get_worker_info(), Context::get_mailbox_event_loop(),
+                                  Context::get_zmq_context(), num_servers_per_process);
+
+    int proc_id = Context::get_worker_info().get_process_id();
+    int num_processes = Context::get_worker_info().get_num_processes();
+    std::ofstream out(output + "." + std::to_string(proc_id));
+    out << "proc_id,num_processes,num_servers_per_process,hint,val_type,num_workers,distribution,batch_size,op,"
+        << "count,avg_keys,throughput_keys_per_s,mean_us,p50_us,p99_us,p999_us,max_us" << std::endl;
+    for (auto& val_type : val_types) {
+        for (auto& hint : hints) {
+            for (int num_workers : num_workers_list) {
+                std::map<std::string, OpResult> results;  // {setting and op, the result of the local workers}
+                std::mutex results_mu;
+                if (val_type == "float") {
+                    RunHint<float>(hint, val_type, num_workers, num_keys, distributions, batch_sizes, zipf_s,
+                                   num_iters, num_warmup, staleness, &results, &results_mu);
+                } else if (val_type == "double") {
+                    RunHint<double>(hint, val_type, num_workers, num_keys, distributions, batch_sizes, zipf_s,
+                                    num_iters, num_warmup, staleness, &results, &results_mu);
+                } else {
+                    throw base::HuskyException("Unknown val_type: " + val_type);
+                }
+                for (auto& kv : results) {
+                    auto& latency = kv.second.latency;
+                    double avg_keys = latency.count() ? static_cast<double>(kv.second.num_keys) / latency.count() : 0;
+                    out << proc_id << "," << num_processes << "," << num_servers_per_process << "," << kv.first << ","
+                        << latency.count() << "," << avg_keys << "," << kv.second.throughput << ","
+                        << latency.mean() / 1e3 << "," << latency.Percentile(50) / 1e3 << ","
+                        << latency.Percentile(99) / 1e3 << "," << latency.Percentile(99.9) / 1e3 << ","
+                        << latency.max() / 1e3 << std::endl;
+                    husky::LOG_I << GREEN(kv.first + ": " + std::to_string(kv.second.throughput) + " keys/s, p50 "
+                                          + std::to_string(latency.Percentile(50) / 1e3) + " us, p99 "
+                                          + std::to_string(latency.Percentile(99) / 1e3) + " us, p999 "
+                                          + std::to_string(latency.Percentile(99.9) / 1e3) + " us");
+                }
+            }
+        }
+    }
+
+    engine.Exit();
+    // Stop the kvstore, should stop before mailbox is down
+    kvstore::KVStore::Get().Stop();
+}
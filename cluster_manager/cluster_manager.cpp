@@ -9,6 +9,7 @@
 #include "cluster_manager/task_scheduler/history_manager.hpp"
 #include "core/constants.hpp"
 #include "core/instance.hpp"
+#include "core/tracer.hpp"
 #include "husky/base/serialization.hpp"
 #include "husky/base/concurrent_queue.hpp"
 
@@ -83,6 +84,8 @@ void ClusterManager::serve() {
             int instance_id, global_thread_id;
             bin >> instance_id >> global_thread_id;
             task_scheduler_->finish_thread(instance_id, global_thread_id);
+            if (Tracer::Enabled())
+                Tracer::Get().Instant("thread finished", "cluster_manager", "thread_id", global_thread_id);
             // husky::LOG_I << CLAY("[ClusterManager]: task id: " + std::to_string(instance_id) + " thread id: " +
             //                      std::to_string(global_thread_id) + " done");
 
@@ -121,6 +124,7 @@ void ClusterManager::recv_tasks_from_worker() {
  * If no more instances, send exit signal
  */
 void ClusterManager::extract_instaces() {
+    TraceScope scope("schedule", "cluster_manager");
     // 1. Extract and assign next instances
     auto instances = task_scheduler_->extract_instances();
     if (!instances.empty())
@@ -141,6 +145,8 @@ void ClusterManager:: send_instances(const std::vector<std::shared_ptr<Instance>
     auto& sockets = cluster_manager_connection_->get_send_sockets();
     for (auto& instance : instances) {
         instance->show_instance();
+        if (Tracer::Enabled())
+            Tracer::Get().Instant("assign instance", "cluster_manager", "instance_id", instance->get_id());
         base::BinStream bin;
         // TODO Support different types of instance in hierarchy
         instance->serialize(bin);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "cluster_manager/cluster_manager.hpp"
+#include "core/tracer.hpp"
 #include "husky/core/context.hpp"
 
 namespace husky {
@@ -24,7 +25,22 @@ class ClusterManagerContext {
     ClusterManagerContext(ClusterManagerContext&&) = delete;
     ClusterManagerContext& operator=(ClusterManagerContext&&) = delete;
 
-    void serve() { cluster_manager_.serve(); }
+    /*
+     * If trace_path is set, the scheduling is traced to trace_path.cluster_manager.json
+     */
+    void serve() {
+        std::string trace_path = Context::get_param("trace_path");
+        if (!trace_path.empty()) {
+            // after the pids of the worker processes
+            Tracer::Get().SetProcess(Context::get_worker_info().get_num_processes(), "cluster_manager");
+            Tracer::Get().Enable();
+        }
+        cluster_manager_.serve();
+        if (!trace_path.empty()) {
+            Tracer::Get().Disable();
+            Tracer::Get().WriteChromeTrace(trace_path + ".cluster_manager.json");
+        }
+    }
 
    private:
     /*
@@ -11,6 +11,8 @@ using Key = uint64_t;
 
 // TODO: magic number: channel id reserved for kvstore
 const int kv_channel_id = 37;
+// channel id for the messages among the kvworker mailboxes, see kvstore::Collective
+const int collective_channel_id = 38;
 
 const uint32_t kClusterManagerInit = 200;
 const uint32_t kClusterManagerThreadFinished = 201;
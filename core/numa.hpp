@@ -0,0 +1,100 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace husky {
+
+/*
+ * The NUMA nodes of the machine and their cpus, read from sysfs
+ *
+ * If the topology is unknown (not Linux, no sysfs), there is one node with all the cpus.
+ */
+class NumaTopology {
+   public:
+    static const NumaTopology& Get() {
+        static NumaTopology topology;
+        return topology;
+    }
+
+    int num_nodes() const { return cpus_.size(); }
+    const std::vector<int>& get_cpus(int node) const { return cpus_[node]; }
+
+    /*
+     * The node of the local_id-th of num_local_workers threads, the threads are spread evenly
+     * and the consecutive ones share a node
+     */
+    int NodeOf(int local_id, int num_local_workers) const {
+        return static_cast<long long>(local_id) * num_nodes() / num_local_workers;
+    }
+
+    /*
+     * Pin the calling thread to the cpus of node, return false if it failed
+     */
+    bool PinThread(int node) const {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        for (int cpu : cpus_[node])
+            CPU_SET(cpu, &cpu_set);
+        return SetThreadAffinity(cpu_set);
+    }
+
+    /*
+     * The affinity of the calling thread, to restore it after PinThread, return false if it failed
+     */
+    static bool GetThreadAffinity(cpu_set_t* cpu_set) {
+        return pthread_getaffinity_np(pthread_self(), sizeof(*cpu_set), cpu_set) == 0;
+    }
+    static bool SetThreadAffinity(const cpu_set_t& cpu_set) {
+        return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+    }
+
+    /*
+     * Parse the cpulist format, e.g. "0-3,8-11"
+     */
+    static std::vector<int> ParseCpuList(const std::string& list) {
+        std::vector<int> cpus;
+        std::stringstream ss(list);
+        std::string range;
+        while (std::getline(ss, range, ',')) {
+            if (range.empty() || range == "\n")
+                continue;
+            auto dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++ cpu)
+                cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+   private:
+    NumaTopology() {
+        for (int node = 0;; ++ node) {
+            std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!in)
+                break;
+            std::string list;
+            std::getline(in, list);
+            auto cpus = ParseCpuList(list);
+            if (!cpus.empty())  // memory-only nodes have no cpu
+                cpus_.push_back(std::move(cpus));
+        }
+        if (cpus_.empty()) {
+            cpus_.resize(1);
+            for (int cpu = 0; cpu < static_cast<int>(std::max(1u, std::thread::hardware_concurrency())); ++ cpu)
+                cpus_[0].push_back(cpu);
+        }
+    }
+
+    std::vector<std::vector<int>> cpus_;  // the cpus of each node
+};
+
+}  // namespace husky
@@ -5,11 +5,11 @@
 namespace husky {
 
 enum class ModeType {
-    Single, Hogwild, SPMT, PS,
+    Single, Hogwild, SPMT, PS, AllReduce,
     None
 };
 static const char* ModeTypeName[] = {
-    "Single", "Hogwild", "SPMT", "PS",
+    "Single", "Hogwild", "SPMT", "PS", "AllReduce",
     "None"
 };
 
@@ -82,6 +82,12 @@ struct TableInfo {
     int kStaleness;
     const bool kEnableDirectModelTransfer;
     const CacheInfo cache_info;
+    bool kEnableEagerSSP = false;  // servers push the modified chunks to the process caches, see ChunkBasedPSModel::Subscribe
+    bool kEnablePullCombiner = false;  // merge the Pull of the local PSWorkers (ASP/SSP), see kvstore::PullCombiner
+    bool kEnablePushCombiner = false;  // sum the Push of the local PSWorkers before sending (ASP), see kvstore::PushCombiner
+    bool kEnableLockFreeModel = false;  // SPMT updates the chunks with atomics instead of locks, see ChunkBasedMTAtomicModel
+    bool kEnableNumaReplicas = false;  // Hogwild (IntegralType) keeps a model replica per NUMA node, see ReplicatedIntegralModel
+    int kReplicaMergeInterval = 1000;  // the Push/Clock on a node between the merges of the replicas
 
     std::string DebugString() const {
         std::stringstream ss;
@@ -95,6 +101,12 @@ struct TableInfo {
         ss << " kStaleness:" << kStaleness;
         ss << " kEnableDirectModelTransfer:" << kEnableDirectModelTransfer;
         ss << " " << cache_info.DebugString();
+        ss << " kEnableEagerSSP:" << kEnableEagerSSP;
+        ss << " kEnablePullCombiner:" << kEnablePullCombiner;
+        ss << " kEnablePushCombiner:" << kEnablePushCombiner;
+        ss << " kEnableLockFreeModel:" << kEnableLockFreeModel;
+        ss << " kEnableNumaReplicas:" << kEnableNumaReplicas;
+        ss << " kReplicaMergeInterval:" << kReplicaMergeInterval;
         ss << "}";
         return ss.str();
     }
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace husky {
+
+/*
+ * Timeline tracing in the Chrome trace format (chrome://tracing, ui.perfetto.dev)
+ *
+ * Each thread records its events into its own ring buffer, which keeps the latest buffer_size
+ * events, so tracing can stay on in a long job. The buffer of an exited thread is reused by the
+ * next new thread (e.g. the threads of the next instance), which continues its lane in the trace.
+ * Tracing is off by default, the instrumented code checks Tracer::Enabled() first, which is a
+ * relaxed atomic load.
+ *
+ * In sampling mode (sample_every > 1) only 1 in sample_every of the kvstore request events
+ * (Push/Pull, Wait, server handling, SSP blocking, the waits in the SPMT consistency controllers)
+ * are recorded, the task lifecycle, Barrier and scheduling events are rare and always recorded.
+ *
+ * The names, categories and arg names must be string literals.
+ * The timestamps are the wall clock, so that the traces of the processes can be merged with
+ * MergeChromeTraces and put on one timeline.
+ */
+class Tracer {
+   public:
+    static const size_t kDefaultBufferSize = 1 << 14;
+
+    struct Event {
+        const char* name;
+        const char* cat;
+        char ph;          // X: complete, i: instant, b/e: async begin/end
+        int64_t ts;       // ns, steady clock
+        int64_t dur;      // ns, for X
+        uint64_t id;      // for b/e
+        const char* arg_name;  // nullptr if no arg
+        int64_t arg;
+    };
+
+    static Tracer& Get() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    static bool Enabled() { return EnabledFlag().load(std::memory_order_relaxed); }
+
+    /*
+     * @param sample_every record 1 in sample_every of the sampled events
+     * @param buffer_size the number of events kept per thread, for the threads started afterwards
+     */
+    void Enable(int sample_every = 1, size_t buffer_size = kDefaultBufferSize) {
+        sample_every_.store(std::max(sample_every, 1));
+        buffer_size_.store(std::max<size_t>(buffer_size, 1));
+        EnabledFlag().store(true);
+    }
+    void Disable() { EnabledFlag().store(false); }
+
+    /*
+     * The pid and the name of this process in the trace
+     */
+    void SetProcess(int pid, const std::string& name) {
+        std::lock_guard<std::mutex> lk(mu_);
+        pid_ = pid;
+        process_name_ = name;
+    }
+    /*
+     * The name of the calling thread in the trace
+     */
+    void SetThreadName(const std::string& name) {
+        auto& buffer = ThreadBuffer_();
+        std::lock_guard<std::mutex> lk(buffer.mu);
+        buffer.name = name;
+    }
+
+    static int64_t Now() { return ToNs(std::chrono::steady_clock::now()); }
+    static int64_t ToNs(std::chrono::steady_clock::time_point t) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+    }
+
+    /*
+     * Whether to record the next sampled event of the calling thread
+     */
+    bool Sample() {
+        thread_local uint64_t count = 0;
+        return count++ % sample_every_.load(std::memory_order_relaxed) == 0;
+    }
+    /*
+     * Whether to record the async events with id, the same on all threads
+     */
+    bool SampleId(uint64_t id) { return id % sample_every_.load(std::memory_order_relaxed) == 0; }
+
+    void Complete(const char* name, const char* cat, int64_t start, int64_t end, const char* arg_name = nullptr, int64_t arg = 0) {
+        Record_(Event{name, cat, 'X', start, end - start, 0, arg_name, arg});
+    }
+    void Instant(const char* name, const char* cat, const char* arg_name = nullptr, int64_t arg = 0) {
+        Record_(Event{name, cat, 'i', Now(), 0, 0, arg_name, arg});
+    }
+    void AsyncBegin(const char* name, const char* cat, uint64_t id, const char* arg_name = nullptr, int64_t arg = 0) {
+        Record_(Event{name, cat, 'b', Now(), 0, id, arg_name, arg});
+    }
+    void AsyncEnd(const char* name, const char* cat, uint64_t id) {
+        Record_(Event{name, cat, 'e', Now(), 0, id, nullptr, 0});
+    }
+
+    /*
+     * The recorded events in the Chrome trace json format, one event per line
+     */
+    std::string DumpChromeTrace() {
+        std::lock_guard<std::mutex> lk(mu_);
+        std::vector<std::string> lines;
+        std::string pid = std::to_string(pid_);
+        lines.push_back("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":0,\"args\":{\"name\":\"" +
+                        Escape_(process_name_) + "\"}}");
+        for (size_t tid = 0; tid < buffers_.size(); ++ tid) {
+            auto& buffer = *buffers_[tid];
+            std::lock_guard<std::mutex> buffer_lk(buffer.mu);
+            std::string name = buffer.name.empty() ? "thread " + std::to_string(tid) : buffer.name;
+            lines.push_back("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + std::to_string(tid) +
+                            ",\"args\":{\"name\":\"" + Escape_(name) + "\"}}");
+            size_t n = std::min<size_t>(buffer.count, buffer.events.size());
+            for (size_t i = buffer.count - n; i < buffer.count; ++ i)
+                lines.push_back(ToJson_(buffer.events[i % buffer.events.size()], pid, tid));
+        }
+        std::stringstream ss;
+        ss << "{\"traceEvents\":[\n";
+        for (size_t i = 0; i < lines.size(); ++ i)
+            ss << lines[i] << (i + 1 < lines.size() ? ",\n" : "\n");
+        ss << "],\"displayTimeUnit\":\"ns\"}\n";
+        return ss.str();
+    }
+    void WriteChromeTrace(const std::string& path) {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp);
+            out << DumpChromeTrace();
+        }
+        std::rename(tmp.c_str(), path.c_str());
+    }
+
+    /*
+     * Merge the traces written by WriteChromeTrace (e.g. of all the processes) into one
+     */
+    static void MergeChromeTraces(const std::vector<std::string>& inputs, const std::string& output) {
+        std::vector<std::string> lines;
+        for (auto& input : inputs) {
+            std::ifstream in(input);
+            std::string line;
+            while (std::getline(in, line)) {
+                if (line.compare(0, 8, "{\"name\":") != 0)  // the header and the footer
+                    continue;
+                if (line.back() == ',')
+                    line.pop_back();
+                lines.push_back(std::move(line));
+            }
+        }
+        std::ofstream out(output);
+        out << "{\"traceEvents\":[\n";
+        for (size_t i = 0; i < lines.size(); ++ i)
+            out << lines[i] << (i + 1 < lines.size() ? ",\n" : "\n");
+        out << "],\"displayTimeUnit\":\"ns\"}\n";
+    }
+
+    /*
+     * Drop the recorded events
+     */
+    void Clear() {
+        std::lock_guard<std::mutex> lk(mu_);
+        for (auto& buffer : buffers_) {
+            std::lock_guard<std::mutex> buffer_lk(buffer->mu);
+            buffer->count = 0;
+        }
+    }
+
+   private:
+    /*
+     * The ring buffer of a thread, its lock is only contended by DumpChromeTrace and Clear
+     */
+    struct Buffer {
+        std::mutex mu;
+        std::vector<Event> events;
+        uint64_t count = 0;  // the number of recorded events, the latest ones are kept
+        std::string name;
+    };
+
+    Tracer() {
+        // the offset from the steady clock to the wall clock
+        offset_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::system_clock::now().time_since_epoch()).count() - Now();
+    }
+
+    static std::atomic<bool>& EnabledFlag() {
+        static std::atomic<bool> enabled{false};
+        return enabled;
+    }
+
+    /*
+     * Give the buffer back to the free list when the thread exits
+     */
+    struct BufferHolder {
+        std::shared_ptr<Buffer> buffer;
+        ~BufferHolder() {
+            if (buffer) {
+                auto& tracer = Tracer::Get();
+                std::lock_guard<std::mutex> lk(tracer.mu_);
+                tracer.free_buffers_.push_back(buffer);
+            }
+        }
+    };
+
+    Buffer& ThreadBuffer_() {
+        thread_local BufferHolder holder;
+        if (!holder.buffer) {
+            std::lock_guard<std::mutex> lk(mu_);
+            if (!free_buffers_.empty()) {
+                holder.buffer = free_buffers_.back();
+                free_buffers_.pop_back();
+                std::lock_guard<std::mutex> buffer_lk(holder.buffer->mu);
+                holder.buffer->name.clear();
+                if (holder.buffer->events.size() != buffer_size_.load()) {  // resized by Enable
+                    holder.buffer->events.resize(buffer_size_.load());
+                    holder.buffer->count = 0;
+                }
+            } else {
+                holder.buffer = std::make_shared<Buffer>();
+                holder.buffer->events.resize(buffer_size_.load());
+                buffers_.push_back(holder.buffer);
+            }
+        }
+        return *holder.buffer;
+    }
+
+    void Record_(const Event& event) {
+        auto& buffer = ThreadBuffer_();
+        std::lock_guard<std::mutex> lk(buffer.mu);
+        buffer.events[buffer.count % buffer.events.size()] = event;
+        buffer.count += 1;
+    }
+
+    std::string ToJson_(const Event& event, const std::string& pid, size_t tid) const {
+        char ts[32];
+        snprintf(ts, sizeof(ts), "%.3f", (event.ts + offset_ns_) / 1e3);  // us
+        std::string json = std::string("{\"name\":\"") + event.name + "\",\"cat\":\"" + event.cat + "\",\"ph\":\"" +
+                           event.ph + "\",\"ts\":" + ts + ",\"pid\":" + pid + ",\"tid\":" + std::to_string(tid);
+        if (event.ph == 'X') {
+            char dur[32];
+            snprintf(dur, sizeof(dur), "%.3f", event.dur / 1e3);
+            json += std::string(",\"dur\":") + dur;
+        } else if (event.ph == 'i') {
+            json += ",\"s\":\"t\"";
+        } else {
+            json += ",\"id\":\"0x" + ToHex_(event.id) + "\"";
+        }
+        if (event.arg_name)
+            json += std::string(",\"args\":{\"") + event.arg_name + "\":" + std::to_string(event.arg) + "}";
+        return json + "}";
+    }
+
+    static std::string ToHex_(uint64_t val) {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "%llx", static_cast<unsigned long long>(val));
+        return buf;
+    }
+
+    static std::string Escape_(const std::string& str) {
+        std::string res;
+        for (char c : str) {
+            if (c == '"' || c == '\\')
+                res += '\\';
+            res += c;
+        }
+        return res;
+    }
+
+    std::mutex mu_;  // for buffers_ and the process
+    std::vector<std::shared_ptr<Buffer>> buffers_;  // index is the tid in the trace
+    std::vector<std::shared_ptr<Buffer>> free_buffers_;  // of the exited threads
+    int pid_ = 0;
+    std::string process_name_ = "process";
+    int64_t offset_ns_;
+    std::atomic<int> sample_every_{1};
+    std::atomic<size_t> buffer_size_{kDefaultBufferSize};
+};
+
+/*
+ * Record the scope as a complete event if tracing is enabled
+ *
+ * A sampled scope is subject to the sample_every of the Tracer.
+ */
+class TraceScope {
+   public:
+    TraceScope(const char* name, const char* cat, const char* arg_name = nullptr, int64_t arg = 0, bool sampled = false)
+        : name_(name), cat_(cat), arg_name_(arg_name), arg_(arg),
+          start_(Tracer::Enabled() && (!sampled || Tracer::Get().Sample()) ? Tracer::Now() : -1) {}
+    ~TraceScope() {
+        if (start_ != -1)
+            Tracer::Get().Complete(name_, cat_, start_, Tracer::Now(), arg_name_, arg_);
+    }
+
+   private:
+    const char* name_;
+    const char* cat_;
+    const char* arg_name_;
+    int64_t arg_;
+    int64_t start_;
+};
+
+}  // namespace husky
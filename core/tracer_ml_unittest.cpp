@@ -0,0 +1,116 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "core/tracer.hpp"
+
+namespace husky {
+namespace {
+
+class TestTracer: public testing::Test {
+   public:
+    TestTracer() {}
+    ~TestTracer() {}
+
+   protected:
+    void SetUp() { Tracer::Get().Clear(); }
+    void TearDown() {
+        Tracer::Get().Disable();
+        Tracer::Get().Clear();
+    }
+};
+
+int Count(const std::string& text, const std::string& pattern) {
+    int count = 0;
+    for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1))
+        count += 1;
+    return count;
+}
+
+TEST_F(TestTracer, Disabled) {
+    {
+        TraceScope scope("disabled", "test");
+    }
+    EXPECT_EQ(Count(Tracer::Get().DumpChromeTrace(), "\"disabled\""), 0);
+}
+
+TEST_F(TestTracer, Events) {
+    Tracer::Get().Enable();
+    Tracer::Get().SetProcess(3, "proc 3");
+    std::thread thread([] {
+        Tracer::Get().SetThreadName("worker 0");
+        TraceScope scope("scope", "test", "kv_id", 7);
+        Tracer::Get().Instant("instant", "test");
+        Tracer::Get().AsyncBegin("request", "test", 42);
+        Tracer::Get().AsyncEnd("request", "test", 42);
+    });
+    thread.join();
+    std::string trace = Tracer::Get().DumpChromeTrace();
+    EXPECT_EQ(trace.compare(0, 16, "{\"traceEvents\":["), 0);
+    EXPECT_NE(trace.find("\"args\":{\"name\":\"proc 3\"}"), std::string::npos);
+    EXPECT_NE(trace.find("\"args\":{\"name\":\"worker 0\"}"), std::string::npos);
+    EXPECT_NE(trace.find("{\"name\":\"scope\",\"cat\":\"test\",\"ph\":\"X\""), std::string::npos);
+    EXPECT_NE(trace.find("\"args\":{\"kv_id\":7}"), std::string::npos);
+    EXPECT_EQ(Count(trace, "\"ph\":\"i\""), 1);
+    EXPECT_EQ(Count(trace, "\"id\":\"0x2a\""), 2);
+    EXPECT_EQ(Count(trace, "\"pid\":3,"), Count(trace, "\"pid\":"));
+}
+
+TEST_F(TestTracer, Sampling) {
+    Tracer::Get().Enable(4);
+    std::thread thread([] {
+        for (int i = 0; i < 100; ++ i) {
+            TraceScope sampled("sampled", "test", nullptr, 0, true);
+            TraceScope always("always", "test");
+        }
+    });
+    thread.join();
+    std::string trace = Tracer::Get().DumpChromeTrace();
+    EXPECT_EQ(Count(trace, "\"sampled\""), 25);
+    EXPECT_EQ(Count(trace, "\"always\""), 100);
+}
+
+TEST_F(TestTracer, RingBuffer) {
+    Tracer::Get().Enable(1, 10);
+    std::thread thread([] {
+        for (int i = 0; i < 25; ++ i)
+            Tracer::Get().Instant("instant", "test", "i", i);
+    });
+    thread.join();
+    std::string trace = Tracer::Get().DumpChromeTrace();
+    // the latest 10 are kept
+    EXPECT_EQ(Count(trace, "\"instant\""), 10);
+    EXPECT_EQ(trace.find("\"args\":{\"i\":14}"), std::string::npos);
+    EXPECT_NE(trace.find("\"args\":{\"i\":15}"), std::string::npos);
+    EXPECT_NE(trace.find("\"args\":{\"i\":24}"), std::string::npos);
+}
+
+TEST_F(TestTracer, Merge) {
+    Tracer::Get().Enable();
+    Tracer::Get().SetProcess(0, "proc 0");
+    Tracer::Get().Instant("first", "test");
+    Tracer::Get().WriteChromeTrace("/tmp/husky_trace_test.0.json");
+    Tracer::Get().Clear();
+    Tracer::Get().SetProcess(1, "proc 1");
+    Tracer::Get().Instant("second", "test");
+    Tracer::Get().WriteChromeTrace("/tmp/husky_trace_test.1.json");
+    Tracer::MergeChromeTraces({"/tmp/husky_trace_test.0.json", "/tmp/husky_trace_test.1.json"},
+                              "/tmp/husky_trace_test.json");
+    std::ifstream in("/tmp/husky_trace_test.json");
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string trace = ss.str();
+    EXPECT_EQ(Count(trace, "\"traceEvents\""), 1);
+    EXPECT_EQ(Count(trace, "\"first\""), 1);
+    EXPECT_EQ(Count(trace, "\"second\""), 1);
+    EXPECT_EQ(Count(trace, "process_name"), 2);
+    EXPECT_EQ(Count(trace, ",\n"), Count(trace, "\n{\"name\":") - 1);  // one event per line
+    for (auto* path : {"/tmp/husky_trace_test.0.json", "/tmp/husky_trace_test.1.json", "/tmp/husky_trace_test.json"})
+        std::remove(path);
+}
+
+}  // namespace
+}  // namespace husky
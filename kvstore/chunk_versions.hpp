@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+#include "core/constants.hpp"
+#include "kvstore/flat_map.hpp"
+#include "kvstore/range_manager.hpp"
+
+namespace kvstore {
+
+/*
+ * ChunkVersions: the per-chunk version counters of one server, for the versioned PullChunks (cmd 6)
+ *
+ * A chunk that has not been updated since the tracking started has version kBaseVersion,
+ * each update gives the touched chunks a new version from a per-server counter.
+ * kNoVersion is never used by the server, workers send it for the chunks they don't hold.
+ * Tracking starts with the first versioned pull, so kvstores that never use it pay nothing.
+ */
+class ChunkVersions {
+   public:
+    enum : uint32_t { kNoVersion = 0, kBaseVersion = 1 };
+
+    bool enabled() const { return enabled_; }
+    void Enable() { enabled_ = true; }
+
+    void Bump(size_t chunk_id) {
+        if (enabled_)
+            versions_[chunk_id] = ++ counter_;
+    }
+    // Bump the chunks of sorted keys, each chunk once
+    void BumpKeys(int kv_id, const husky::constants::Key* keys, size_t n) {
+        if (!enabled_ || n == 0)
+            return;
+        size_t chunk_size = RangeManager::Get().GetChunkSize(kv_id);
+        size_t last = keys[0] / chunk_size;
+        Bump(last);
+        for (size_t i = 1; i < n; ++ i) {
+            size_t chunk_id = keys[i] / chunk_size;
+            if (chunk_id != last) {
+                Bump(chunk_id);
+                last = chunk_id;
+            }
+        }
+    }
+    uint32_t Get(size_t chunk_id) {
+        uint32_t* v = versions_.find(chunk_id);
+        return v ? *v : kBaseVersion;
+    }
+
+   private:
+    bool enabled_ = false;
+    uint32_t counter_ = kBaseVersion;
+    FlatMap<uint32_t> versions_;  // {chunk_id, version}, only the updated chunks
+};
+
+}  // namespace kvstore
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cassert>
+#include <utility>
+#include <vector>
+
+namespace kvstore {
+
+/*
+ * ClockWindow: one slot per clock from base_clock() on, kept in a ring buffer
+ *
+ * SSP only needs the clocks from min_clock to the progress of the fastest worker,
+ * i.e. staleness + 1 clocks in the steady state, so the memory stays bounded
+ * however many clocks the job runs. The ring grows (to a power of 2) only if a worker
+ * gets further ahead, e.g. several Push without waiting.
+ */
+template <typename T>
+class ClockWindow {
+   public:
+    explicit ClockWindow(size_t capacity = 1) { Reset(0, capacity); }
+
+    /*
+     * Drop all the slots and start the window at base_clock
+     */
+    void Reset(int base_clock, size_t capacity) {
+        size_t n = 1;
+        while (n < capacity)
+            n <<= 1;
+        slots_.clear();
+        slots_.resize(n);
+        head_ = 0;
+        base_clock_ = base_clock;
+    }
+
+    int base_clock() const { return base_clock_; }
+    size_t capacity() const { return slots_.size(); }
+
+    // clock must not be older than base_clock()
+    T& operator[](int clock) {
+        assert(clock >= base_clock_);
+        size_t offset = clock - base_clock_;
+        if (offset >= slots_.size())
+            grow(offset + 1);
+        return slots_[(head_ + offset) & (slots_.size() - 1)];
+    }
+
+    /*
+     * Clear the slot of base_clock() and move the window to the next clock
+     */
+    void PopFront() {
+        slots_[head_] = T();
+        head_ = (head_ + 1) & (slots_.size() - 1);
+        base_clock_ += 1;
+    }
+
+   private:
+    void grow(size_t min_capacity) {
+        size_t n = slots_.size();
+        while (n < min_capacity)
+            n <<= 1;
+        std::vector<T> slots(n);
+        for (size_t i = 0; i < slots_.size(); ++ i)
+            slots[i] = std::move(slots_[(head_ + i) & (slots_.size() - 1)]);
+        slots_.swap(slots);
+        head_ = 0;
+    }
+
+    std::vector<T> slots_;
+    size_t head_ = 0;
+    int base_clock_ = 0;
+};
+
+}  // namespace kvstore
@@ -0,0 +1,54 @@
+#include "gtest/gtest.h"
+
+#include <vector>
+
+#include "kvstore/clock_window.hpp"
+
+namespace husky {
+namespace {
+
+class TestClockWindow: public testing::Test {
+   public:
+    TestClockWindow() {}
+    ~TestClockWindow() {}
+
+   protected:
+    void SetUp() {}
+    void TearDown() {}
+};
+
+TEST_F(TestClockWindow, Slide) {
+    // staleness 2, 3 clocks in the window
+    kvstore::ClockWindow<int> window(3);
+    EXPECT_EQ(window.capacity(), 4);
+    for (int clock = 0; clock < 1000; ++ clock) {
+        EXPECT_EQ(window.base_clock(), clock);
+        window[clock + 2] = clock + 2;
+        EXPECT_EQ(window[clock], clock < 2 ? 0 : clock);
+        window.PopFront();
+    }
+    // the memory does not grow with the number of clocks
+    EXPECT_EQ(window.capacity(), 4);
+}
+
+TEST_F(TestClockWindow, Grow) {
+    kvstore::ClockWindow<std::vector<int>> window(2);
+    window.PopFront();
+    window.PopFront();
+    for (int clock = 2; clock < 12; ++ clock)
+        window[clock].push_back(clock);
+    EXPECT_EQ(window.capacity(), 16);
+    for (int clock = 2; clock < 12; ++ clock) {
+        ASSERT_EQ(window[clock].size(), 1);
+        EXPECT_EQ(window[clock][0], clock);
+        window.PopFront();
+    }
+    EXPECT_TRUE(window[12].empty());
+
+    window.Reset(5, 2);
+    EXPECT_EQ(window.base_clock(), 5);
+    EXPECT_TRUE(window[5].empty());
+}
+
+}  // namespace
+}  // namespace husky
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "core/constants.hpp"
+#include "husky/base/exception.hpp"
+#include "husky/base/serialization.hpp"
+#include "husky/core/mailbox.hpp"
+#include "kvstore/ps_lite/sarray.h"
+#include "kvstore/sarray_io.hpp"
+
+namespace kvstore {
+
+/*
+ * Collective: the collective operations among a group of workers, without the servers
+ *
+ * The workers talk to each other directly through their kvworker mailboxes, on collective_channel_id,
+ * so that the dense synchronous jobs are not limited by the bandwidth of the servers.
+ *   AllReduce: ring allreduce (ReduceScatter then AllGather), each worker sends 2*(n-1)/n of the vector
+ *   ReduceScatter: rank i ends up with the sum of Segment(i)
+ *   AllGather: rank i contributes Segment(i)
+ *   Broadcast: binomial tree from root, log(n) rounds
+ *
+ * Every worker of the group must call the same operations in the same order: the messages are
+ * matched by a sequence number advanced identically in all of them.
+ * One Collective per worker thread, the calls block until the operation is done on this worker.
+ * Several Collectives may share a mailbox (e.g. two AllReduce tables in one task) if their tags
+ * differ: the messages carry the tag, and those which arrive before they are waited for are kept
+ * per mailbox by (tag, seq), so any Collective on the mailbox can receive them later.
+ */
+class Collective {
+   public:
+    /*
+     * @param mailbox the kvworker mailbox of this worker, see KVStore::get_kvworker_mailbox
+     * @param tids the mailbox thread ids of the group in rank order, see KVStore::get_kvworker_tid
+     * @param rank the position of this worker in tids
+     * @param tag to tell apart the Collectives on the same mailbox, e.g. the kv_id
+     */
+    Collective(husky::LocalMailbox& mailbox, const std::vector<int>& tids, int rank, int tag = 0)
+        : mailbox_(mailbox), tids_(tids), rank_(rank), tag_(tag), early_(EarlyMessagesOf_(&mailbox)) {
+        assert(rank_ >= 0 && rank_ < tids_.size());
+    }
+
+    int rank() const { return rank_; }
+    int size() const { return tids_.size(); }
+
+    /*
+     * The range [first, second) of a vector of size num_vals owned by rank i,
+     * the first num_vals % n ranks have one more val
+     */
+    std::pair<size_t, size_t> Segment(size_t num_vals, int i) const {
+        size_t n = tids_.size();
+        size_t pos = i;
+        size_t begin = num_vals / n * pos + std::min(pos, num_vals % n);
+        return {begin, begin + num_vals / n + (pos < num_vals % n ? 1 : 0)};
+    }
+
+    /*
+     * Sum vals element-wise over the group, all the workers must pass vals of the same size
+     */
+    template <typename Val>
+    void AllReduce(std::vector<Val>* vals) {
+        ReduceScatter(vals);
+        AllGather(vals);
+    }
+
+    /*
+     * Sum Segment(rank) of vals over the group, the other segments are left partially reduced
+     *
+     * Ring: in step s, send segment (rank-s-1) to the right, add segment (rank-s-2) from the left
+     */
+    template <typename Val>
+    void ReduceScatter(std::vector<Val>* vals) {
+        int n = tids_.size();
+        int seq = seq_;
+        seq_ += n - 1;
+        for (int s = 0; s < n - 1; ++ s) {
+            auto send_seg = Segment(vals->size(), (rank_ - s - 1 + 2 * n) % n);
+            auto recv_seg = Segment(vals->size(), (rank_ - s - 2 + 2 * n) % n);
+            Send_(Right_(), seq + s, vals->data() + send_seg.first, send_seg.second - send_seg.first);
+            husky::base::BinStream bin = Recv_(seq + s);
+            pslite::SArray<Val> recv_vals;
+            ViewSArray(bin, &recv_vals);
+            assert(recv_vals.size() == recv_seg.second - recv_seg.first);
+            for (size_t i = 0; i < recv_vals.size(); ++ i)
+                (*vals)[recv_seg.first + i] += recv_vals[i];
+        }
+    }
+
+    /*
+     * Copy Segment(i) of vals on rank i to all the workers
+     *
+     * Ring: in step s, send segment (rank-s) to the right, take segment (rank-s-1) from the left
+     */
+    template <typename Val>
+    void AllGather(std::vector<Val>* vals) {
+        int n = tids_.size();
+        int seq = seq_;
+        seq_ += n - 1;
+        for (int s = 0; s < n - 1; ++ s) {
+            auto send_seg = Segment(vals->size(), (rank_ - s + n) % n);
+            auto recv_seg = Segment(vals->size(), (rank_ - s - 1 + 2 * n) % n);
+            Send_(Right_(), seq + s, vals->data() + send_seg.first, send_seg.second - send_seg.first);
+            husky::base::BinStream bin = Recv_(seq + s);
+            pslite::SArray<Val> recv_vals;
+            ViewSArray(bin, &recv_vals);
+            assert(recv_vals.size() == recv_seg.second - recv_seg.first);
+            std::copy(recv_vals.begin(), recv_vals.end(), vals->begin() + recv_seg.first);
+        }
+    }
+
+    /*
+     * Copy vals of root to all the workers, vals of the other workers are resized
+     *
+     * Binomial tree on the ranks relative to root: in round k, the ranks below 2^k send to rank + 2^k
+     */
+    template <typename Val>
+    void Broadcast(std::vector<Val>* vals, int root = 0) {
+        int n = tids_.size();
+        int rel = (rank_ - root + n) % n;
+        int seq = seq_;
+        int round = 0;
+        for (int mask = 1; mask < n; mask <<= 1, ++ round) {
+            if (rel < mask) {
+                if (rel + mask < n)
+                    Send_((rel + mask + root) % n, seq + round, vals->data(), vals->size());
+            } else if (rel < 2 * mask) {
+                husky::base::BinStream bin = Recv_(seq + round);
+                pslite::SArray<Val> recv_vals;
+                ViewSArray(bin, &recv_vals);
+                vals->assign(recv_vals.begin(), recv_vals.end());
+            }
+        }
+        seq_ += round;
+    }
+
+   private:
+    int Right_() const { return (rank_ + 1) % tids_.size(); }
+
+    // Format: tag, seq, vals (see WriteSArray)
+    template <typename Val>
+    void Send_(int dst, int seq, const Val* vals, size_t num_vals) {
+        husky::base::BinStream bin;
+        bin << tag_ << seq;
+        WriteSArray(bin, pslite::SArray<Val>(const_cast<Val*>(vals), num_vals));
+        mailbox_.send(tids_[dst], husky::constants::collective_channel_id, 0, bin);
+    }
+
+    // the message of seq, those of the later operations or the other Collectives arriving earlier are kept aside
+    husky::base::BinStream Recv_(int seq) {
+        auto it = early_.find({tag_, seq});
+        if (it != early_.end()) {
+            husky::base::BinStream bin = std::move(it->second);
+            early_.erase(it);
+            return bin;
+        }
+        while (mailbox_.poll(husky::constants::collective_channel_id, 0)) {
+            husky::base::BinStream bin = mailbox_.recv(husky::constants::collective_channel_id, 0);
+            int recv_tag, recv_seq;
+            bin >> recv_tag >> recv_seq;
+            if (recv_tag == tag_ && recv_seq == seq)
+                return bin;
+            early_.emplace(std::make_pair(recv_tag, recv_seq), std::move(bin));
+        }
+        throw husky::base::HuskyException("[Collective] mailbox closed while waiting for tag " + std::to_string(tag_) +
+                                          " seq " + std::to_string(seq));
+    }
+
+    using EarlyMessages = std::map<std::pair<int, int>, husky::base::BinStream>;  // {(tag, seq), message}
+
+    // the messages kept aside for the Collectives on mailbox, the mailbox is used by one thread at a time
+    static EarlyMessages& EarlyMessagesOf_(husky::LocalMailbox* mailbox) {
+        static std::mutex mu;
+        static std::unordered_map<husky::LocalMailbox*, EarlyMessages> early;
+        std::lock_guard<std::mutex> lk(mu);
+        return early[mailbox];
+    }
+
+    husky::LocalMailbox& mailbox_;
+    std::vector<int> tids_;
+    int rank_;
+    int tag_;
+    int seq_ = 0;
+    EarlyMessages& early_;
+};
+
+}  // namespace kvstore
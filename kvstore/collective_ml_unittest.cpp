@@ -0,0 +1,122 @@
+#include "gtest/gtest.h"
+
+#include <functional>
+#include <thread>
+
+#include "kvstore/kvstore.hpp"
+
+namespace husky {
+namespace {
+
+class TestCollective: public testing::Test {
+   public:
+    TestCollective() {}
+    ~TestCollective() {}
+
+   protected:
+    void SetUp() {
+        // 1. Create WorkerInfo
+        for (int i = 0; i < kNumWorkers; ++ i)
+            worker_info.add_worker(0, i, i);
+        worker_info.set_process_id(0);
+
+        // 2. Create Mailbox
+        el = new MailboxEventLoop(&zmq_context);
+        el->set_process_id(0);
+        recver = new CentralRecver(&zmq_context, "inproc://test");
+    }
+    void TearDown() {
+        delete el;
+        delete recver;
+    }
+
+    // run f on every worker with its own Collective
+    void Run(const std::function<void(kvstore::Collective&)>& f) {
+        kvstore::KVStore::Get().Start(worker_info, el, &zmq_context);
+        std::vector<int> tids;
+        for (int i = 0; i < kNumWorkers; ++ i)
+            tids.push_back(kvstore::KVStore::Get().get_kvworker_tid(i));
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kNumWorkers; ++ i) {
+            threads.emplace_back([&, i]() {
+                kvstore::Collective collective(*kvstore::KVStore::Get().get_kvworker_mailbox(i), tids, i);
+                f(collective);
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        kvstore::KVStore::Get().Stop();
+    }
+
+    static const int kNumWorkers = 5;
+    WorkerInfo worker_info;
+    zmq::context_t zmq_context;
+    MailboxEventLoop* el;
+    CentralRecver * recver;
+};
+
+TEST_F(TestCollective, AllReduce) {
+    Run([](kvstore::Collective& collective) {
+        // sizes not divisible by the group, or smaller than it
+        for (size_t size : {0, 3, 17, 1000}) {
+            std::vector<float> vals(size);
+            for (size_t i = 0; i < size; ++ i)
+                vals[i] = collective.rank() * 1000 + i;
+            collective.AllReduce(&vals);
+            for (size_t i = 0; i < size; ++ i)
+                EXPECT_EQ(vals[i], 10000 + 5 * i);  // (0+1+2+3+4)*1000 + 5*i
+        }
+    });
+}
+
+TEST_F(TestCollective, ReduceScatter) {
+    Run([](kvstore::Collective& collective) {
+        std::vector<int> vals(11, collective.rank() + 1);
+        collective.ReduceScatter(&vals);
+        auto seg = collective.Segment(vals.size(), collective.rank());
+        for (size_t i = seg.first; i < seg.second; ++ i)
+            EXPECT_EQ(vals[i], 15);
+    });
+}
+
+TEST_F(TestCollective, Broadcast) {
+    Run([](kvstore::Collective& collective) {
+        for (int root = 0; root < collective.size(); ++ root) {
+            std::vector<int> vals;
+            if (collective.rank() == root)
+                vals = {root, 1, 2, 3};
+            collective.Broadcast(&vals, root);
+            EXPECT_EQ(vals, std::vector<int>({root, 1, 2, 3}));
+        }
+    });
+}
+
+TEST_F(TestCollective, SharedMailbox) {
+    // two Collectives with their own tags on the same mailboxes, like two AllReduce tables in one task
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context);
+    std::vector<int> tids;
+    for (int i = 0; i < kNumWorkers; ++ i)
+        tids.push_back(kvstore::KVStore::Get().get_kvworker_tid(i));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kNumWorkers; ++ i) {
+        threads.emplace_back([&, i]() {
+            auto* mailbox = kvstore::KVStore::Get().get_kvworker_mailbox(i);
+            kvstore::Collective collective0(*mailbox, tids, i, 0);
+            kvstore::Collective collective1(*mailbox, tids, i, 1);
+            for (int iter = 0; iter < 20; ++ iter) {
+                std::vector<float> vals0(7, i);
+                std::vector<float> vals1(13, i * 10);
+                collective0.AllReduce(&vals0);
+                collective1.AllReduce(&vals1);
+                EXPECT_EQ(vals0, std::vector<float>(7, 10));
+                EXPECT_EQ(vals1, std::vector<float>(13, 100));
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    kvstore::KVStore::Get().Stop();
+}
+
+}  // namespace
+}  // namespace husky
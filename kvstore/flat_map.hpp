@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "core/constants.hpp"
+
+namespace kvstore {
+
+/*
+ * FlatMap: an open-addressing hash map from Key to Val used as the storage of the *_map kvstores
+ *
+ * Keys and values are stored in two flat arrays (SoA) and collisions are resolved by linear probing,
+ * so a lookup touches one or two cache lines instead of chasing the node pointers of std::unordered_map.
+ * Only the operations needed by the kvstore are provided: entries are never erased one by one.
+ *
+ * The max Key is used to mark the empty slots, so it is kept outside of the arrays.
+ *
+ * Not thread-safe, it is owned by one server.
+ */
+template <typename Val>
+class FlatMap {
+   public:
+    using Key = husky::constants::Key;
+
+    explicit FlatMap(size_t capacity = kMinCapacity) {
+        size_t cap = kMinCapacity;
+        while (cap < capacity)
+            cap <<= 1;
+        Reset(cap);
+    }
+
+    /*
+     * Return the reference to the value of key, a default value is inserted if key does not exist
+     *
+     * The reference is invalidated by the next insertion
+     */
+    Val& operator[](Key key) {
+        if (key == kEmptyKey) {
+            if (!has_empty_key_) {
+                has_empty_key_ = true;
+                empty_key_val_ = Val();
+            }
+            return empty_key_val_;
+        }
+        size_t pos = Probe(key);
+        if (keys_[pos] == key)
+            return vals_[pos];
+        if ((num_slots_used_ + 1) * kMaxLoadDen > capacity_ * kMaxLoadNum) {
+            Rehash(capacity_ * 2);
+            pos = Probe(key);
+        }
+        keys_[pos] = key;
+        vals_[pos] = Val();
+        num_slots_used_ += 1;
+        return vals_[pos];
+    }
+
+    /*
+     * Return the pointer to the value of key, nullptr if key does not exist
+     */
+    Val* find(Key key) {
+        if (key == kEmptyKey)
+            return has_empty_key_ ? &empty_key_val_ : nullptr;
+        size_t pos = Probe(key);
+        return keys_[pos] == key ? &vals_[pos] : nullptr;
+    }
+
+    /*
+     * Prefetch the home slot of key, used to overlap the cache misses of a batch of lookups
+     */
+    void prefetch(Key key) const {
+        size_t pos = Hash(key) & mask_;
+        __builtin_prefetch(keys_.data() + pos);
+        __builtin_prefetch(vals_.data() + pos);
+    }
+
+    /*
+     * Reserve space for n entries without rehashing
+     */
+    void reserve(size_t n) {
+        size_t cap = capacity_;
+        while (n * kMaxLoadDen > cap * kMaxLoadNum)
+            cap <<= 1;
+        if (cap != capacity_)
+            Rehash(cap);
+    }
+
+    /*
+     * Apply func(key, val) to each entry
+     */
+    template <typename FuncT>
+    void for_each(FuncT func) {
+        for (size_t i = 0; i < capacity_; ++ i) {
+            if (keys_[i] != kEmptyKey)
+                func(keys_[i], vals_[i]);
+        }
+        if (has_empty_key_)
+            func(kEmptyKey, empty_key_val_);
+    }
+
+    /*
+     * Remove all the entries, the capacity is kept for reuse
+     */
+    void clear() {
+        Reset(capacity_);
+        has_empty_key_ = false;
+    }
+
+    size_t size() const { return num_slots_used_ + (has_empty_key_ ? 1 : 0); }
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return capacity_; }
+
+   private:
+    static constexpr Key kEmptyKey = std::numeric_limits<Key>::max();
+    static constexpr size_t kMinCapacity = 16;
+    // max load factor: kMaxLoadNum / kMaxLoadDen
+    static constexpr size_t kMaxLoadNum = 7;
+    static constexpr size_t kMaxLoadDen = 10;
+
+    /*
+     * The finalizer of splitmix64, it spreads the consecutive keys which are common in kvstore
+     */
+    static size_t Hash(Key key) {
+        key ^= key >> 30;
+        key *= 0xbf58476d1ce4e5b9ULL;
+        key ^= key >> 27;
+        key *= 0x94d049bb133111ebULL;
+        key ^= key >> 31;
+        return static_cast<size_t>(key);
+    }
+
+    /*
+     * Return the slot of key, or the first empty slot if key does not exist
+     */
+    size_t Probe(Key key) const {
+        size_t pos = Hash(key) & mask_;
+        while (keys_[pos] != key && keys_[pos] != kEmptyKey)
+            pos = (pos + 1) & mask_;
+        return pos;
+    }
+
+    void Reset(size_t capacity) {
+        assert((capacity & (capacity - 1)) == 0);
+        capacity_ = capacity;
+        mask_ = capacity - 1;
+        keys_.assign(capacity, kEmptyKey);
+        vals_.assign(capacity, Val());
+        num_slots_used_ = 0;
+    }
+
+    void Rehash(size_t capacity) {
+        std::vector<Key> old_keys;
+        std::vector<Val> old_vals;
+        old_keys.swap(keys_);
+        old_vals.swap(vals_);
+        Reset(capacity);
+        for (size_t i = 0; i < old_keys.size(); ++ i) {
+            if (old_keys[i] != kEmptyKey) {
+                size_t pos = Probe(old_keys[i]);
+                keys_[pos] = old_keys[i];
+                vals_[pos] = std::move(old_vals[i]);
+                num_slots_used_ += 1;
+            }
+        }
+    }
+
+    std::vector<Key> keys_;
+    std::vector<Val> vals_;
+    size_t capacity_ = 0;
+    size_t mask_ = 0;
+    size_t num_slots_used_ = 0;
+
+    bool has_empty_key_ = false;
+    Val empty_key_val_ = Val();
+};
+
+template <typename Val>
+constexpr typename FlatMap<Val>::Key FlatMap<Val>::kEmptyKey;
+template <typename Val>
+constexpr size_t FlatMap<Val>::kMinCapacity;
+
+}  // namespace kvstore
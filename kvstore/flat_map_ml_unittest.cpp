@@ -0,0 +1,102 @@
+#include "gtest/gtest.h"
+
+#include <limits>
+#include <random>
+#include <unordered_map>
+
+#include "kvstore/flat_map.hpp"
+
+namespace husky {
+namespace {
+
+using Key = husky::constants::Key;
+
+class TestFlatMap: public testing::Test {
+   public:
+    TestFlatMap() {}
+    ~TestFlatMap() {}
+
+   protected:
+    void SetUp() {}
+    void TearDown() {}
+};
+
+TEST_F(TestFlatMap, InsertAndFind) {
+    kvstore::FlatMap<float> map;
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(map.find(1), nullptr);
+    map[1] = 0.1;
+    map[3] += 0.3;
+    map[3] += 0.3;
+    EXPECT_EQ(map.size(), 2);
+    EXPECT_EQ(*map.find(1), float(0.1));
+    EXPECT_EQ(map[3], float(0.3) + float(0.3));
+    EXPECT_EQ(map[2], 0.0);  // default value is inserted
+    EXPECT_EQ(map.size(), 3);
+}
+
+TEST_F(TestFlatMap, MaxKey) {
+    kvstore::FlatMap<float> map;
+    auto max = std::numeric_limits<Key>::max();
+    EXPECT_EQ(map.find(max), nullptr);
+    map[max] = 1.0;
+    map[0] = 2.0;
+    EXPECT_EQ(map.size(), 2);
+    EXPECT_EQ(*map.find(max), 1.0);
+    float sum = 0;
+    map.for_each([&sum](Key key, float val) { sum += val; });
+    EXPECT_EQ(sum, 3.0);
+}
+
+TEST_F(TestFlatMap, Grow) {
+    kvstore::FlatMap<int> map;
+    std::unordered_map<Key, int> expected;
+    std::mt19937_64 gen(0);
+    for (int i = 0; i < 10000; ++ i) {
+        Key key = i % 2 == 0 ? i : gen() % 100000;  // consecutive keys and random keys
+        map[key] += i;
+        expected[key] += i;
+    }
+    EXPECT_EQ(map.size(), expected.size());
+    EXPECT_GE(map.capacity(), map.size());
+    for (auto& kv : expected) {
+        ASSERT_NE(map.find(kv.first), nullptr);
+        EXPECT_EQ(*map.find(kv.first), kv.second);
+    }
+    size_t count = 0;
+    map.for_each([&](Key key, int val) {
+        EXPECT_EQ(expected[key], val);
+        count += 1;
+    });
+    EXPECT_EQ(count, expected.size());
+}
+
+TEST_F(TestFlatMap, Reserve) {
+    kvstore::FlatMap<float> map;
+    map[7] = 0.7;
+    map.reserve(1000);
+    size_t capacity = map.capacity();
+    EXPECT_GE(capacity, 1000);
+    for (int i = 0; i < 1000; ++ i) {
+        map[i] += 1.0;
+    }
+    EXPECT_EQ(map.capacity(), capacity);
+    EXPECT_EQ(map[7], float(0.7) + float(1.0));
+}
+
+TEST_F(TestFlatMap, Clear) {
+    kvstore::FlatMap<float> map;
+    for (int i = 0; i < 100; ++ i) {
+        map[i] = 1.0;
+    }
+    map[std::numeric_limits<husky::constants::Key>::max()] = 2.0;
+    size_t capacity = map.capacity();
+    map.clear();
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(map.capacity(), capacity);
+    EXPECT_EQ(map.find(7), nullptr);
+    EXPECT_EQ(map.find(std::numeric_limits<husky::constants::Key>::max()), nullptr);
+}
+
+}  // namespace
+}  // namespace husky
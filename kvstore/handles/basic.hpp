@@ -1,32 +1,178 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
 #include <unordered_map>
+#include <vector>
 #include "core/constants.hpp"
 #include "husky/base/serialization.hpp"
 #include "husky/base/exception.hpp"
+#include "kvstore/chunk_versions.hpp"
+#include "kvstore/flat_map.hpp"
+#include "kvstore/handles/optimizer_storage.hpp"
+#include "kvstore/key_codec.hpp"
+#include "kvstore/val_codec.hpp"
 #include "kvstore/kvpairs.hpp"
 #include "kvstore/range_manager.hpp"
+#include "kvstore/sarray_io.hpp"
 #include "core/color.hpp"
 
 namespace kvstore {
 namespace {
 
-// update function for push
+/*
+ * Storage helpers
+ *
+ * The generic versions work on any StorageT providing operator[] (e.g. FlatMap, std::unordered_map).
+ * The std::vector versions treat contiguous keys as spans: pushes become a bulk copy
+ * (assign) or a tight add loop the compiler can vectorize, and pulls become a bulk copy.
+ */
 template <typename Val, typename StorageT>
-void update(int kv_id, int server_id, husky::base::BinStream& bin, StorageT& store, int cmd, bool is_vector, bool is_assign) {
-    if (cmd == 0) {
-        KVPairs<Val> recv;
-        bin >> recv.keys >> recv.vals;
-        int interval = is_vector ? RangeManager::Get().GetServerInterval(kv_id, server_id) : 0;
+void update_range(StorageT& store, size_t start, const Val* vals, size_t n, bool is_assign) {
+    if (is_assign) {
+        for (size_t i = 0; i < n; ++ i) {
+            store[start + i] = vals[i];
+        }
+    } else {
+        for (size_t i = 0; i < n; ++ i) {
+            store[start + i] += vals[i];
+        }
+    }
+}
+
+template <typename Val>
+void update_range(std::vector<Val>& store, size_t start, const Val* vals, size_t n, bool is_assign) {
+    Val* dst = store.data() + start;
+    if (is_assign) {
+        std::copy(vals, vals + n, dst);
+    } else {
+        for (size_t i = 0; i < n; ++ i) {
+            dst[i] += vals[i];
+        }
+    }
+}
+
+template <typename Val, typename StorageT>
+void retrieve_range(StorageT& store, size_t start, Val* vals, size_t n) {
+    for (size_t i = 0; i < n; ++ i) {
+        vals[i] = store[start + i];
+    }
+}
+
+template <typename Val>
+void retrieve_range(std::vector<Val>& store, size_t start, Val* vals, size_t n) {
+    std::copy(store.data() + start, store.data() + start + n, vals);
+}
+
+/*
+ * Return the length of the run of consecutive keys starting at keys[i]
+ */
+inline size_t contiguous_run(const husky::constants::Key* keys, size_t i, size_t n) {
+    size_t j = i + 1;
+    while (j < n && keys[j] == keys[j - 1] + 1)
+        ++ j;
+    return j - i;
+}
+
+template <typename Val, typename StorageT>
+void update_keys(StorageT& store, const husky::constants::Key* keys, const Val* vals, size_t n, int interval, bool is_assign) {
+    if (is_assign) {
+        for (size_t i = 0; i < n; ++ i) {
+            store[keys[i] - interval] = vals[i];
+        }
+    } else {
+        for (size_t i = 0; i < n; ++ i) {
+            store[keys[i] - interval] += vals[i];
+        }
+    }
+}
+
+template <typename Val>
+void update_keys(std::vector<Val>& store, const husky::constants::Key* keys, const Val* vals, size_t n, int interval, bool is_assign) {
+    for (size_t i = 0; i < n;) {
+        size_t len = contiguous_run(keys, i, n);
+        update_range(store, keys[i] - interval, vals + i, len, is_assign);
+        i += len;
+    }
+}
+
+template <typename Val, typename StorageT>
+void retrieve_keys(StorageT& store, const husky::constants::Key* keys, Val* vals, size_t n, int interval) {
+    for (size_t i = 0; i < n; ++ i) {
+        vals[i] = store[keys[i] - interval];
+    }
+}
+
+template <typename Val>
+void retrieve_keys(std::vector<Val>& store, const husky::constants::Key* keys, Val* vals, size_t n, int interval) {
+    for (size_t i = 0; i < n;) {
+        size_t len = contiguous_run(keys, i, n);
+        retrieve_range(store, keys[i] - interval, vals + i, len);
+        i += len;
+    }
+}
+
+/*
+ * FlatMap lookups are random accesses, so the slot of the key kPrefetchDistance ahead
+ * is prefetched to overlap the cache misses
+ */
+const size_t kPrefetchDistance = 8;
+
+template <typename Val>
+void update_keys(FlatMap<Val>& store, const husky::constants::Key* keys, const Val* vals, size_t n, int interval, bool is_assign) {
+    for (size_t i = 0; i < n; ++ i) {
+        if (i + kPrefetchDistance < n)
+            store.prefetch(keys[i + kPrefetchDistance] - interval);
         if (is_assign) {
-            for (size_t i = 0; i < recv.keys.size(); ++ i) {
-                store[recv.keys[i] - interval] = recv.vals[i];
-            }
+            store[keys[i] - interval] = vals[i];
         } else {
-            for (size_t i = 0; i < recv.keys.size(); ++ i) {
-                store[recv.keys[i] - interval] += recv.vals[i];
-            }
+            store[keys[i] - interval] += vals[i];
+        }
+    }
+}
+
+template <typename Val>
+void retrieve_keys(FlatMap<Val>& store, const husky::constants::Key* keys, Val* vals, size_t n, int interval) {
+    for (size_t i = 0; i < n; ++ i) {
+        if (i + kPrefetchDistance < n)
+            store.prefetch(keys[i + kPrefetchDistance] - interval);
+        vals[i] = store[keys[i] - interval];
+    }
+}
+
+/*
+ * Return the total number of values in the given chunks
+ */
+inline size_t chunks_total_size(int kv_id, const std::vector<size_t>& chunk_ids) {
+    size_t chunk_size = RangeManager::Get().GetChunkSize(kv_id);
+    size_t chunk_num = RangeManager::Get().GetChunkNum(kv_id);
+    size_t total = 0;
+    for (auto chunk_id : chunk_ids) {
+        total += (chunk_id == chunk_num - 1) ? RangeManager::Get().GetLastChunkSize(kv_id) : chunk_size;
+    }
+    return total;
+}
+
+// update function for push
+template <typename Val, typename StorageT>
+void update(int kv_id, int server_id, husky::base::BinStream& bin, StorageT& store, int cmd, bool is_vector, bool is_assign,
+            ChunkVersions* versions = nullptr) {
+    if (!is_assign && buffers_round(store))  // the weights change in commit_round, which bumps the versions
+        versions = nullptr;
+    if (cmd == 0 || cmd == 5) {  // 5: keys are encoded by EncodeKeys and vals by EncodeVals
+        KVPairs<Val> recv;
+        if (cmd == 5) {
+            DecodeKeys(bin, &recv.keys);
+            DecodeVals(bin, &recv.vals);
+        } else {  // used in place, see WriteSArray
+            ViewSArray(bin, &recv.keys);
+            ViewSArray(bin, &recv.vals);
         }
+        int interval = is_vector ? RangeManager::Get().GetServerInterval(kv_id, server_id) : 0;
+        update_keys(store, recv.keys.data(), recv.vals.data(), recv.keys.size(), interval, is_assign);
+        if (versions)
+            versions->BumpKeys(kv_id, recv.keys.data(), recv.keys.size());
     } else if (cmd == 1) {
         size_t chunk_size = RangeManager::Get().GetChunkSize(kv_id);
         std::vector<size_t> chunk_ids;
@@ -36,15 +182,9 @@ void update(int kv_id, int server_id, husky::base::BinStream& bin, StorageT& sto
             size_t start_id = chunk_id * chunk_size;
             std::vector<Val> chunk;
             bin >> chunk;
-            if (is_assign) {
-                for (size_t i = 0; i < chunk.size(); ++i) {
-                    store[start_id + i - interval] = chunk[i];
-                }
-            } else {
-                for (size_t i = 0; i < chunk.size(); ++i) {
-                    store[start_id + i - interval] += chunk[i];
-                }
-            }
+            update_range(store, start_id - interval, chunk.data(), chunk.size(), is_assign);
+            if (versions)
+                versions->Bump(chunk_id);
         }
         // husky::LOG_I << RED("Done");
     } else if (cmd == 2) {  // enable zero-copy
@@ -53,16 +193,10 @@ void update(int kv_id, int server_id, husky::base::BinStream& bin, StorageT& sto
         auto* p_recv = reinterpret_cast<KVPairs<Val>*>(ptr);
         
         int interval = is_vector ? RangeManager::Get().GetServerInterval(kv_id, server_id) : 0;
-        if (is_assign) {
-            for (size_t i = 0; i < p_recv->keys.size(); ++ i) {
-                store[p_recv->keys[i] - interval] = p_recv->vals[i];
-            }
-        } else {
-            for (size_t i = 0; i < p_recv->keys.size(); ++ i) {
-                store[p_recv->keys[i] - interval] += p_recv->vals[i];
-            }
-        }
-        
+        update_keys(store, p_recv->keys.data(), p_recv->vals.data(), p_recv->keys.size(), interval, is_assign);
+        if (versions)
+            versions->BumpKeys(kv_id, p_recv->keys.data(), p_recv->keys.size());
+
         delete p_recv;
     } else if (cmd == 3) {  // zero-copy chunks
         size_t chunk_size = RangeManager::Get().GetChunkSize(kv_id);
@@ -74,15 +208,9 @@ void update(int kv_id, int server_id, husky::base::BinStream& bin, StorageT& sto
         int interval = is_vector ? RangeManager::Get().GetServerInterval(kv_id, server_id) : 0;
         for (size_t i = 0; i < chunk_ids.size(); ++ i) {
             size_t start_id = chunk_ids[i] * chunk_size;
-            if (is_assign) {
-                for (size_t j = 0; j < chunks[i].size(); ++j) {
-                    store[start_id + j - interval] = chunks[i][j];
-                }
-            } else {
-                for (size_t j = 0; j < chunks[i].size(); ++j) {
-                    store[start_id + j - interval] += chunks[i][j];
-                }
-            }
+            update_range(store, start_id - interval, chunks[i].data(), chunks[i].size(), is_assign);
+            if (versions)
+                versions->Bump(chunk_ids[i]);
         }
         delete p_recv;
     } else {
@@ -92,17 +220,19 @@ void update(int kv_id, int server_id, husky::base::BinStream& bin, StorageT& sto
 
 // retrieve function to retrieve the valued indexed by key
 template<typename Val, typename StorageT>
-KVPairs<Val> retrieve(int kv_id, int server_id, husky::base::BinStream& bin, StorageT& store, int cmd, bool is_vector) {
-    if (cmd == 0) {
+KVPairs<Val> retrieve(int kv_id, int server_id, husky::base::BinStream& bin, StorageT& store, int cmd, bool is_vector,
+                      ChunkVersions* versions = nullptr) {
+    if (cmd == 0 || cmd == 5) {  // 5: keys are encoded by EncodeKeys
         KVPairs<Val> recv;
         KVPairs<Val> send;
-        bin >> recv.keys;
+        if (cmd == 5)
+            DecodeKeys(bin, &recv.keys);
+        else
+            ViewSArray(bin, &recv.keys);  // so the keys of the result alias bin
         send.keys = recv.keys;
         send.vals.resize(recv.keys.size());
         int interval = is_vector ? RangeManager::Get().GetServerInterval(kv_id, server_id) : 0;
-        for (size_t i = 0; i < send.keys.size(); ++i) {
-            send.vals[i] = store[send.keys[i] - interval];
-        }
+        retrieve_keys(store, send.keys.data(), send.vals.data(), send.keys.size(), interval);
         return send;
     } else if (cmd == 1) {
         size_t chunk_size = RangeManager::Get().GetChunkSize(kv_id);
@@ -110,19 +240,20 @@ KVPairs<Val> retrieve(int kv_id, int server_id, husky::base::BinStream& bin, Sto
         std::vector<size_t> chunk_ids;
         bin >> chunk_ids;
         KVPairs<Val> send;
-        send.keys.reserve(chunk_ids.size());
-        send.vals.reserve(chunk_ids.size()*chunk_size);
+        send.keys.resize(chunk_ids.size());
+        send.vals.resize(chunks_total_size(kv_id, chunk_ids));
         int interval = is_vector ? RangeManager::Get().GetServerInterval(kv_id, server_id) : 0;
-        for (auto chunk_id : chunk_ids) {
-            send.keys.push_back(chunk_id);
+        size_t offset = 0;
+        for (size_t i = 0; i < chunk_ids.size(); ++ i) {
+            size_t chunk_id = chunk_ids[i];
+            send.keys[i] = chunk_id;
             // husky::LOG_I << RED("retrieve chunk_id " + std::to_string(chunk_id));
             size_t start_id = chunk_id * chunk_size;
-            int real_chunk_size = chunk_size;
+            size_t real_chunk_size = chunk_size;
             if (chunk_id == chunk_num-1) 
                 real_chunk_size = RangeManager::Get().GetLastChunkSize(kv_id);
-            for (int i = 0; i < real_chunk_size; ++ i) {
-                send.vals.push_back(store[start_id + i - interval]);
-            }
+            retrieve_range(store, start_id - interval, send.vals.data() + offset, real_chunk_size);
+            offset += real_chunk_size;
         }
         return send;
     } else if (cmd == 2) {  // enable zero-copy
@@ -133,9 +264,7 @@ KVPairs<Val> retrieve(int kv_id, int server_id, husky::base::BinStream& bin, Sto
         send.keys = p_recv->keys;
         send.vals.resize(p_recv->keys.size());
         int interval = is_vector ? RangeManager::Get().GetServerInterval(kv_id, server_id) : 0;
-        for (size_t i = 0; i < send.keys.size(); ++ i) {
-            send.vals[i] = store[send.keys[i] - interval];
-        }
+        retrieve_keys(store, send.keys.data(), send.vals.data(), send.keys.size(), interval);
         delete p_recv;
         return send;
     } else if (cmd == 3) {
@@ -146,19 +275,48 @@ KVPairs<Val> retrieve(int kv_id, int server_id, husky::base::BinStream& bin, Sto
         auto* p_recv = reinterpret_cast<std::pair<std::vector<size_t>, std::vector<std::vector<Val>>>*>(ptr);
         auto& chunk_ids = p_recv->first;
         KVPairs<Val> send;
-        send.keys.reserve(chunk_ids.size());
-        send.vals.reserve(chunk_ids.size()*chunk_size);
+        send.keys.resize(chunk_ids.size());
+        send.vals.resize(chunks_total_size(kv_id, chunk_ids));
         int interval = is_vector ? RangeManager::Get().GetServerInterval(kv_id, server_id) : 0;
-        for (auto chunk_id : chunk_ids) {
-            send.keys.push_back(chunk_id);
+        size_t offset = 0;
+        for (size_t i = 0; i < chunk_ids.size(); ++ i) {
+            size_t chunk_id = chunk_ids[i];
+            send.keys[i] = chunk_id;
             // husky::LOG_I << RED("retrieve chunk_id " + std::to_string(chunk_id));
             size_t start_id = chunk_id * chunk_size;
-            int real_chunk_size = chunk_size;
+            size_t real_chunk_size = chunk_size;
             if (chunk_id == chunk_num-1) 
                 real_chunk_size = RangeManager::Get().GetLastChunkSize(kv_id);
-            for (int i = 0; i < real_chunk_size; ++ i) {
-                send.vals.push_back(store[start_id + i - interval]);
-            }
+            retrieve_range(store, start_id - interval, send.vals.data() + offset, real_chunk_size);
+            offset += real_chunk_size;
+        }
+        return send;
+    } else if (cmd == 6) {  // versioned chunks: only the chunks newer than the versions held by the worker
+        if (!versions)
+            throw husky::base::HuskyException("Versioned PullChunks is not supported by this server");
+        versions->Enable();
+        size_t chunk_size = RangeManager::Get().GetChunkSize(kv_id);
+        size_t chunk_num = RangeManager::Get().GetChunkNum(kv_id);
+        std::vector<size_t> chunk_ids;
+        std::vector<uint32_t> held;
+        bin >> chunk_ids >> held;
+        assert(chunk_ids.size() == held.size());
+        std::vector<size_t> modified;
+        for (size_t i = 0; i < chunk_ids.size(); ++ i) {
+            if (held[i] == ChunkVersions::kNoVersion || held[i] != versions->Get(chunk_ids[i]))
+                modified.push_back(chunk_ids[i]);
+        }
+        KVPairs<Val> send;  // the versions are appended by ServerBase::Response
+        send.keys.resize(modified.size());
+        send.vals.resize(chunks_total_size(kv_id, modified));
+        int interval = is_vector ? RangeManager::Get().GetServerInterval(kv_id, server_id) : 0;
+        size_t offset = 0;
+        for (size_t i = 0; i < modified.size(); ++ i) {
+            size_t chunk_id = modified[i];
+            send.keys[i] = chunk_id;
+            size_t real_chunk_size = chunk_id == chunk_num - 1 ? RangeManager::Get().GetLastChunkSize(kv_id) : chunk_size;
+            retrieve_range(store, chunk_id * chunk_size - interval, send.vals.data() + offset, real_chunk_size);
+            offset += real_chunk_size;
         }
         return send;
     } else {
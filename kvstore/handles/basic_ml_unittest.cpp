@@ -0,0 +1,132 @@
+#include "gtest/gtest.h"
+
+#include <unordered_map>
+#include <vector>
+
+#include "kvstore/handles/basic.hpp"
+
+namespace husky {
+namespace {
+
+class TestBasic: public testing::Test {
+   public:
+    TestBasic() {}
+    ~TestBasic() {}
+
+   protected:
+    void SetUp() {
+        // 1 server, max_key: 10, chunk_size: 3
+        // chunks: {3, 3, 3, 1}
+        kvstore::RangeManager::Get().SetNumServers(1);
+        kvstore::RangeManager::Get().SetMaxKeyAndChunkSize(0, 10, 3);
+    }
+    void TearDown() {
+        kvstore::RangeManager::Get().Clear();
+    }
+};
+
+template <typename StorageT>
+void PushKVs(StorageT& store, const std::vector<husky::constants::Key>& keys, const std::vector<float>& vals, bool is_assign) {
+    base::BinStream bin;
+    kvstore::WriteSArray(bin, kvstore::pslite::SArray<husky::constants::Key>(keys));
+    kvstore::WriteSArray(bin, kvstore::pslite::SArray<float>(vals));
+    kvstore::update<float, StorageT>(0, 0, bin, store, 0, true, is_assign);
+}
+
+template <typename StorageT>
+std::vector<float> PullKVs(StorageT& store, const std::vector<husky::constants::Key>& keys) {
+    base::BinStream bin;
+    kvstore::WriteSArray(bin, kvstore::pslite::SArray<husky::constants::Key>(keys));
+    auto res = kvstore::retrieve<float, StorageT>(0, 0, bin, store, 0, true);
+    return std::vector<float>(res.vals.begin(), res.vals.end());
+}
+
+TEST_F(TestBasic, ContiguousRuns) {
+    std::vector<float> vec_store(10);
+    std::unordered_map<husky::constants::Key, float> map_store;
+    kvstore::FlatMap<float> flat_store;
+    // runs: [0, 3), [5, 7), [9, 10)
+    std::vector<husky::constants::Key> keys{0, 1, 2, 5, 6, 9};
+    std::vector<float> vals{0.1, 0.2, 0.3, 0.4, 0.5, 0.6};
+
+    PushKVs(vec_store, keys, vals, false);
+    PushKVs(vec_store, keys, vals, false);
+    PushKVs(map_store, keys, vals, false);
+    PushKVs(map_store, keys, vals, false);
+    PushKVs(flat_store, keys, vals, false);
+    PushKVs(flat_store, keys, vals, false);
+    std::vector<float> expected{0.2, 0.4, 0.6, 0.8, 1.0, 1.2};
+    EXPECT_EQ(PullKVs(vec_store, keys), expected);
+    EXPECT_EQ(PullKVs(map_store, keys), expected);
+    EXPECT_EQ(PullKVs(flat_store, keys), expected);
+    EXPECT_EQ(vec_store[3], 0.0);
+    EXPECT_EQ(vec_store[8], 0.0);
+
+    PushKVs(vec_store, keys, vals, true);
+    PushKVs(map_store, keys, vals, true);
+    PushKVs(flat_store, keys, vals, true);
+    EXPECT_EQ(PullKVs(vec_store, keys), vals);
+    EXPECT_EQ(PullKVs(map_store, keys), vals);
+    EXPECT_EQ(PullKVs(flat_store, keys), vals);
+
+    // non-increasing keys are still handled one by one
+    std::vector<husky::constants::Key> keys2{9, 2, 1, 1};
+    EXPECT_EQ(PullKVs(vec_store, keys2), std::vector<float>({0.6, 0.3, 0.2, 0.2}));
+    EXPECT_EQ(PullKVs(map_store, keys2), std::vector<float>({0.6, 0.3, 0.2, 0.2}));
+    EXPECT_EQ(PullKVs(flat_store, keys2), std::vector<float>({0.6, 0.3, 0.2, 0.2}));
+}
+
+TEST_F(TestBasic, Chunks) {
+    std::vector<float> store(10);
+    std::vector<size_t> chunk_ids{1, 3};
+    for (int k = 0; k < 2; ++ k) {
+        base::BinStream bin;
+        bin << chunk_ids << std::vector<float>{1.0, 2.0, 3.0} << std::vector<float>{4.0};
+        kvstore::update<float, std::vector<float>>(0, 0, bin, store, 1, true, false);
+    }
+    EXPECT_EQ(store, std::vector<float>({0.0, 0.0, 0.0, 2.0, 4.0, 6.0, 0.0, 0.0, 0.0, 8.0}));
+
+    base::BinStream bin;
+    bin << std::vector<size_t>{3, 0, 1};
+    auto res = kvstore::retrieve<float, std::vector<float>>(0, 0, bin, store, 1, true);
+    EXPECT_EQ(std::vector<husky::constants::Key>(res.keys.begin(), res.keys.end()),
+              std::vector<husky::constants::Key>({3, 0, 1}));
+    EXPECT_EQ(std::vector<float>(res.vals.begin(), res.vals.end()),
+              std::vector<float>({8.0, 0.0, 0.0, 0.0, 2.0, 4.0, 6.0}));
+}
+
+TEST_F(TestBasic, VersionedChunks) {
+    std::vector<float> store(10);
+    kvstore::ChunkVersions versions;
+    auto pull = [&](const std::vector<size_t>& chunk_ids, const std::vector<uint32_t>& held) {
+        base::BinStream bin;
+        bin << chunk_ids << held;
+        return kvstore::retrieve<float, std::vector<float>>(0, 0, bin, store, 6, true, &versions);
+    };
+    // nothing is held, all chunks are modified
+    auto res = pull({0, 1, 2, 3}, std::vector<uint32_t>(4, kvstore::ChunkVersions::kNoVersion));
+    EXPECT_EQ(res.keys.size(), 4);
+    EXPECT_EQ(res.vals.size(), 10);
+    EXPECT_TRUE(versions.enabled());
+    std::vector<uint32_t> held{versions.Get(0), versions.Get(1), versions.Get(2), versions.Get(3)};
+    EXPECT_EQ(pull({0, 1, 2, 3}, held).keys.size(), 0);
+
+    // keys 4 and 5 are in chunk 1, key 9 is in chunk 3
+    base::BinStream bin;
+    kvstore::WriteSArray(bin, kvstore::pslite::SArray<husky::constants::Key>(std::vector<husky::constants::Key>{4, 5, 9}));
+    kvstore::WriteSArray(bin, kvstore::pslite::SArray<float>(std::vector<float>{0.1, 0.2, 0.3}));
+    kvstore::update<float, std::vector<float>>(0, 0, bin, store, 0, true, false, &versions);
+    res = pull({0, 1, 2, 3}, held);
+    ASSERT_EQ(res.keys.size(), 2);
+    EXPECT_EQ(res.keys[0], 1);
+    EXPECT_EQ(res.keys[1], 3);
+    ASSERT_EQ(res.vals.size(), 4);
+    EXPECT_FLOAT_EQ(res.vals[1], 0.1);
+    EXPECT_FLOAT_EQ(res.vals[2], 0.2);
+    EXPECT_FLOAT_EQ(res.vals[3], 0.3);
+    EXPECT_NE(versions.Get(1), held[1]);
+    EXPECT_EQ(versions.Get(2), held[2]);
+}
+
+}  // namespace
+}  // namespace husky
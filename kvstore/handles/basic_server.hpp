@@ -1,9 +1,11 @@
 #pragma once
 
+#include <mutex>
 #include <unordered_map>
 
 #include "husky/base/serialization.hpp"
 #include "kvstore/handles/basic.hpp"
+#include "kvstore/handles/direct_access.hpp"
 #include "kvstore/kvmanager.hpp"
 #include "kvstore/ps_lite/sarray.h"
 
@@ -16,6 +18,10 @@ namespace kvstore {
 class ServerBase {
    public:
     virtual void Process(int kv_id, int ts, husky::base::BinStream& bin, ServerCustomer* customer) = 0;
+    /*
+     * whether the server handles Subscribe (cmd 7), i.e. Eager SSP
+     */
+    virtual bool AcceptSubscribe() const { return false; }
     /*
      * response to the push/pull request
      * The whole callback process is:
@@ -31,8 +37,17 @@ class ServerBase {
             p->keys = res.keys;
             p->vals = res.vals;
             bin << reinterpret_cast<std::uintptr_t>(p);
-        } else {
-            bin << res.keys << res.vals;
+        } else if (cmd == 5) {  // keys are encoded in the request, so encode them in the reply as well
+            EncodeKeys(KeyCodec::kDeltaVarintRuns, res.keys, bin);
+            WriteSArray(bin, res.vals);
+        } else if (cmd % with_min_clock_magic_ == 6 && push == false) {  // versioned chunks, append the new versions
+            std::vector<uint32_t> versions(res.keys.size());
+            for (size_t i = 0; i < res.keys.size(); ++ i)
+                versions[i] = versions_.Get(res.keys[i]);
+            bin << res.keys << res.vals << versions;
+        } else {  // aligned, the worker reads them in place
+            WriteSArray(bin, res.keys);
+            WriteSArray(bin, res.vals);
         }
         if (min_clock != -1)  // For PullChunksWithMinClock in SSP
             bin << min_clock;
@@ -40,13 +55,17 @@ class ServerBase {
     }
     static const int consistency_control_off_magic_ = 100;
     static const int with_min_clock_magic_ = 10;
+    static const int server_push_ts_ = -1;  // ts of the messages initiated by the server, see WorkerCustomer
+
+   protected:
+    ChunkVersions versions_;  // for the versioned PullChunks
 };
 
 /*
  * The default functor for assign operation
  */
 template <typename Val, typename StorageT>
-class DefaultUpdateServer : public ServerBase {
+class DefaultUpdateServer : public ServerBase, public DirectAccess<Val> {
    public:
     DefaultUpdateServer() = delete;
     DefaultUpdateServer(int kv_id, int server_id, StorageT&& store, bool is_vector, bool is_assign) : server_id_(server_id), kv_id_(kv_id), store_(std::move(store)), is_vector_(is_vector), is_assign_(is_assign) {}
@@ -58,20 +77,55 @@ class DefaultUpdateServer : public ServerBase {
         bin >> cmd >> push >> src;
         cmd %= consistency_control_off_magic_;  // disregard the consistency_control_off_magic_
         assert(cmd != 4);  // no InitForConsistencyControl
+        std::lock_guard<std::mutex> lk(mu_);  // against the direct access of the local kvworkers
         if (push == true) {  // if is push
             if (bin.size()) {  // if bin is empty, don't reply
-                update<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_, is_assign_);
+                update<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_, is_assign_, &versions_);
                 Response<Val>(kv_id, ts, cmd, push, src, KVPairs<Val>(), customer);
             }
         } else {  // if is pull
             if (bin.size()) {  // if bin is empty, don't reply
                 KVPairs<Val> res;
-                res = retrieve<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_); 
+                res = retrieve<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_, &versions_); 
                 Response<Val>(kv_id, ts, cmd, push, src, res, customer);
             }
         }
     }
+
+    virtual void DirectUpdate(const husky::constants::Key* keys, const Val* vals, size_t n) override {
+        std::lock_guard<std::mutex> lk(mu_);
+        update_keys(store_, keys, vals, n, interval(), is_assign_);
+        versions_.BumpKeys(kv_id_, keys, n);
+    }
+
+    virtual void DirectRetrieve(const husky::constants::Key* keys, Val* vals, size_t n) override {
+        std::lock_guard<std::mutex> lk(mu_);
+        retrieve_keys(store_, keys, vals, n, interval());
+    }
+
+    virtual void DirectUpdateChunks(const size_t* chunk_ids, const std::vector<Val>* const* chunks, size_t n) override {
+        size_t chunk_size = RangeManager::Get().GetChunkSize(kv_id_);
+        std::lock_guard<std::mutex> lk(mu_);
+        for (size_t i = 0; i < n; ++ i) {
+            update_range(store_, chunk_ids[i] * chunk_size - interval(), chunks[i]->data(), chunks[i]->size(), is_assign_);
+            versions_.Bump(chunk_ids[i]);
+        }
+    }
+
+    virtual void DirectRetrieveChunks(const size_t* chunk_ids, std::vector<Val>* const* chunks, size_t n) override {
+        size_t chunk_size = RangeManager::Get().GetChunkSize(kv_id_);
+        size_t chunk_num = RangeManager::Get().GetChunkNum(kv_id_);
+        std::lock_guard<std::mutex> lk(mu_);
+        for (size_t i = 0; i < n; ++ i) {
+            chunks[i]->resize(chunk_ids[i] == chunk_num - 1 ? RangeManager::Get().GetLastChunkSize(kv_id_) : chunk_size);
+            retrieve_range(store_, chunk_ids[i] * chunk_size - interval(), chunks[i]->data(), chunks[i]->size());
+        }
+    }
+
    private:
+    int interval() { return is_vector_ ? RangeManager::Get().GetServerInterval(kv_id_, server_id_) : 0; }
+
+    std::mutex mu_;
     int kv_id_;
     int server_id_;
     // The real storeage
@@ -1,13 +1,17 @@
 #pragma once
 
+#include <cstring>
 #include <iostream>
 #include <sstream>
+#include <string>
 #include <tuple>
 #include <unordered_map>
 #include <vector>
 
+#include "core/tracer.hpp"
 #include "husky/base/serialization.hpp"
 #include "kvstore/handles/basic.hpp"
+#include "kvstore/handles/optimizer_storage.hpp"
 #include "kvstore/kvmanager.hpp"
 
 #include "kvstore/handles/basic_server.hpp"
@@ -49,6 +53,15 @@ namespace kvstore {
  *     handle and response
  *     if receive all push in this iter
  *       release all buffered pull in pull_iter
+ *
+ * With share_results (hints bsp_add_map_shared, bsp_add_vector_shared), the store doesn't change
+ * in a reply phase, so the identical Pull of a round (e.g. the whole model in dense jobs) are
+ * retrieved once and share the result. The local zero-copy replies then point to the same buffers.
+ *
+ * The optimizer storages apply the gradients of a push round in one step when it is collected
+ * (see OptimizerStorage).
+ *
+ * The end of each push and pull round is traced, the blocked time shows up in the Wait of the workers.
  */
 template <typename Val, typename StorageT>
 class BSPServer : public ServerBase {
@@ -73,6 +86,7 @@ class BSPServer : public ServerBase {
                 pull_progress_.clear();
                 blocked_pulls_.clear();
                 blocked_pushes_.clear();
+                round_results_.clear();
                 reply_phase_ = init_reply_phase_;
                 if (next_num_workers != -1) {
                     num_workers_ = next_num_workers;
@@ -89,13 +103,17 @@ class BSPServer : public ServerBase {
             cmd %= consistency_control_off_magic_;
             if (push == true) {  // if is push
                 if (bin.size()) {  // if bin is empty, don't reply
-                    update<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_, is_assign_);
+                    // no round without consistency control, apply this push at once
+                    bool round_updates = set_round_updates(store_, false);
+                    update<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_, is_assign_, &versions_);
+                    set_round_updates(store_, round_updates);
                     Response<Val>(kv_id, ts, cmd, push, src, KVPairs<Val>(), customer);
+                    round_results_.clear();  // the store is modified
                 }
             } else {  // if is pull
                 if (bin.size()) {  // if bin is empty, don't reply
                     KVPairs<Val> res;
-                    res = retrieve<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_); 
+                    res = retrieve<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_, &versions_); 
                     Response<Val>(kv_id, ts, cmd, push, src, res, customer);
                 }
             }
@@ -120,15 +138,16 @@ class BSPServer : public ServerBase {
             } else {  // first src in push_iter_, reply
                 // update
                 if (bin.size()) {  // if bin is empty, don't reply
-                    update<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_, is_assign_);
+                    update<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_, is_assign_, &versions_);
                     Response<Val>(kv_id, ts, cmd, push, src, KVPairs<Val>(), customer);
                 }
                 if (push_count_[push_iter_] == num_workers_) {  // if collect all
+                    commit_round(kv_id, server_id_, store_, is_vector_, &versions_);
                     // release the blocked pull
                     if (blocked_pulls_.size() > pull_iter_) {
                         for (auto& pull_pair : blocked_pulls_[pull_iter_]) {
                             if (std::get<3>(pull_pair).size()) {
-                                KVPairs<Val> res = retrieve<Val, StorageT>(kv_id, server_id_, std::get<3>(pull_pair), store_, std::get<0>(pull_pair), is_vector_);
+                                KVPairs<Val> res = RetrieveShared_(kv_id, std::get<3>(pull_pair), std::get<0>(pull_pair));
                                 Response<Val>(kv_id, std::get<2>(pull_pair), std::get<0>(pull_pair), 0, std::get<1>(pull_pair), res, customer);
                             }
                         }
@@ -136,6 +155,8 @@ class BSPServer : public ServerBase {
                     } else {
                     }
                     reply_phase_ = true;
+                    if (husky::Tracer::Enabled())
+                        husky::Tracer::Get().Instant("bsp push round done", "kvserver", "iter", push_iter_);
                     push_iter_ += 1;
                 }
             }
@@ -153,7 +174,7 @@ class BSPServer : public ServerBase {
                 blocked_pulls_[progress].emplace_back(cmd, src, ts, std::move(bin));
             } else { // first src in pull_iter_, reply
                 if (bin.size()) {
-                    KVPairs<Val> res = retrieve<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_);
+                    KVPairs<Val> res = RetrieveShared_(kv_id, bin, cmd);
                     Response<Val>(kv_id, ts, cmd, push, src, res, customer);
                 }
                 if (pull_count_[pull_iter_] == num_workers_) {
@@ -161,14 +182,17 @@ class BSPServer : public ServerBase {
                     if (blocked_pushes_.size() > push_iter_) {
                         for (auto& push_pair : blocked_pushes_[push_iter_]) {
                             if (std::get<3>(push_pair).size()) {
-                                update<Val, StorageT>(kv_id, server_id_, std::get<3>(push_pair), store_, std::get<0>(push_pair), is_vector_, is_assign_);
+                                update<Val, StorageT>(kv_id, server_id_, std::get<3>(push_pair), store_, std::get<0>(push_pair), is_vector_, is_assign_, &versions_);
                                 Response<Val>(kv_id, std::get<2>(push_pair), std::get<0>(push_pair), 1, std::get<1>(push_pair), KVPairs<Val>(), customer);
                             }
                         }
                         std::vector<std::tuple<int, int, int, husky::base::BinStream>>().swap(blocked_pushes_[push_iter_]);
                     }
                     reply_phase_ = false;
+                    if (husky::Tracer::Enabled())
+                        husky::Tracer::Get().Instant("bsp pull round done", "kvserver", "iter", pull_iter_);
                     pull_iter_ += 1;
+                    round_results_.clear();
                 }
             }
         }
@@ -177,10 +201,113 @@ class BSPServer : public ServerBase {
     BSPServer() = delete;
     BSPServer(int server_id, int num_workers, StorageT&& store, bool is_vector) : 
         server_id_(server_id), num_workers_(num_workers), store_(std::move(store)), is_vector_(is_vector) {}
-    BSPServer(int server_id, int num_workers, StorageT&& store, bool is_vector, bool is_assign, bool init_reply_phase = true) : 
-        server_id_(server_id), num_workers_(num_workers), store_(std::move(store)), is_vector_(is_vector), is_assign_(is_assign), init_reply_phase_(init_reply_phase) {}
+    BSPServer(int server_id, int num_workers, StorageT&& store, bool is_vector, bool is_assign, bool init_reply_phase = true,
+              bool share_results = false) : 
+        server_id_(server_id), num_workers_(num_workers), store_(std::move(store)), is_vector_(is_vector), is_assign_(is_assign),
+        init_reply_phase_(init_reply_phase), share_results_(share_results) {}
 
    private:
+    /*
+     * retrieve, but the identical Pull of the reply phase share one result if share_results_
+     */
+    KVPairs<Val> RetrieveShared_(int kv_id, husky::base::BinStream& bin, int cmd) {
+        PullSignature_ signature;
+        if (!share_results_ || !Signature_(bin, cmd, &signature))
+            return retrieve<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_, &versions_);
+        for (const auto& result : round_results_) {
+            if (result.Matches(signature)) {
+                std::uintptr_t ptr;
+                if (cmd == 2) {  // the request is not handed to retrieve, release it here
+                    bin >> ptr;
+                    delete reinterpret_cast<KVPairs<Val>*>(ptr);
+                } else if (cmd == 3) {
+                    bin >> ptr;
+                    delete reinterpret_cast<std::pair<std::vector<size_t>, std::vector<std::vector<Val>>>*>(ptr);
+                }
+                return result.res;
+            }
+        }
+        // the ids are copied before retrieve, which consumes the zero-copy requests
+        SharedResult_ result;
+        result.kind = signature.kind;
+        result.hash = signature.hash;
+        result.ids.assign(signature.ids, signature.ids + signature.size);
+        result.res = retrieve<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_, &versions_);
+        if (cmd == 0) {  // the keys alias the request, own them
+            pslite::SArray<husky::constants::Key> keys;
+            keys.CopyFrom(result.res.keys.data(), result.res.keys.size());
+            result.res.keys = keys;
+        }
+        round_results_.push_back(std::move(result));
+        return round_results_.back().res;
+    }
+
+    /*
+     * The keys (cmd 0, 2) or chunk_ids (cmd 1, 3) of a Pull, pointing into the request, and their hash
+     */
+    struct PullSignature_ {
+        char kind;  // 'k' for keys, 'c' for chunk_ids
+        const char* ids;
+        size_t size;  // in bytes
+        uint64_t hash;
+    };
+    struct SharedResult_ {
+        // only the Pull with the same hash are compared in full
+        bool Matches(const PullSignature_& sig) const {
+            return kind == sig.kind && hash == sig.hash && ids.size() == sig.size && memcmp(ids.data(), sig.ids, sig.size) == 0;
+        }
+        char kind;
+        uint64_t hash;
+        std::string ids;
+        KVPairs<Val> res;
+    };
+
+    /*
+     * Read the signature of a Pull without consuming bin, nothing is copied
+     *
+     * Return false for the Pull which are not shared, e.g. encoded or versioned
+     */
+    bool Signature_(husky::base::BinStream& bin, int cmd, PullSignature_* signature) {
+        const char* p = bin.get_remained_buffer();
+        std::uintptr_t ptr;
+        size_t size;
+        if (cmd == 0) {  // see WriteSArray
+            uint8_t pad;
+            memcpy(&size, p, sizeof(size));
+            memcpy(&pad, p + sizeof(size), sizeof(pad));
+            signature->kind = 'k';
+            signature->ids = p + sizeof(size) + sizeof(pad) + pad;
+            signature->size = size * sizeof(husky::constants::Key);
+        } else if (cmd == 2) {
+            memcpy(&ptr, p, sizeof(ptr));
+            const auto& keys = reinterpret_cast<KVPairs<Val>*>(ptr)->keys;
+            signature->kind = 'k';
+            signature->ids = reinterpret_cast<const char*>(keys.data());
+            signature->size = keys.size() * sizeof(husky::constants::Key);
+        } else if (cmd == 1) {  // see KVWorker::SendChunks_
+            memcpy(&size, p, sizeof(size));
+            signature->kind = 'c';
+            signature->ids = p + sizeof(size);
+            signature->size = size * sizeof(size_t);
+        } else if (cmd == 3) {
+            memcpy(&ptr, p, sizeof(ptr));
+            const auto& chunk_ids = reinterpret_cast<std::pair<std::vector<size_t>, std::vector<std::vector<Val>>>*>(ptr)->first;
+            signature->kind = 'c';
+            signature->ids = reinterpret_cast<const char*>(chunk_ids.data());
+            signature->size = chunk_ids.size() * sizeof(size_t);
+        } else {
+            return false;
+        }
+        // FNV-1a over the 8-byte ids
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i + sizeof(uint64_t) <= signature->size; i += sizeof(uint64_t)) {
+            uint64_t id;
+            memcpy(&id, signature->ids + i, sizeof(id));
+            hash = (hash ^ id) * 1099511628211ULL;
+        }
+        signature->hash = hash;
+        return true;
+    }
 
     void print_debug(bool push) {
         // debug
@@ -224,6 +351,9 @@ class BSPServer : public ServerBase {
 
     bool init_reply_phase_ = true;
     bool reply_phase_ = true;
+    // the results of the Pull in this reply phase, at most one per distinct request
+    bool share_results_ = false;
+    std::vector<SharedResult_> round_results_;
     // default storage method is unordered_map
     bool is_vector_ = false;
     // default update method is assign
@@ -73,5 +73,32 @@ TEST_F(TestBSPServer, Consistency) {
     kvstore::KVStore::Get().Stop();
 }
 
+TEST_F(TestBSPServer, SharedResults) {
+    // Start KVStore with 3 servers on each process
+    kvstore::KVStore::Get().Start(worker_info, el, zmq_context, 3);
+
+    int kv = kvstore::KVStore::Get().CreateKVStore<float>("bsp_add_vector_shared", 2, -1, 9, 2);
+    // both workers pull the whole model, each round is retrieved once per server
+    // and must reflect the pushes of the previous round
+    auto worker = [kv](int tid) {
+        auto* kvworker = kvstore::KVStore::Get().get_kvworker(tid);
+        std::vector<husky::constants::Key> keys{0, 1, 2, 3, 4, 5, 6, 7, 8};
+        std::vector<float> vals(keys.size(), 1.0);
+        std::vector<float> res;
+        for (int i = 0; i < 50; ++ i) {
+            kvworker->Wait(kv, kvworker->Pull(kv, keys, &res));
+            ASSERT_EQ(res.size(), keys.size());
+            for (auto v : res)
+                EXPECT_EQ(v, 2.0 * i);
+            kvworker->Wait(kv, kvworker->Push(kv, keys, vals));
+        }
+    };
+    std::thread th1(worker, 0);
+    std::thread th2(worker, 1);
+    th1.join();
+    th2.join();
+    kvstore::KVStore::Get().Stop();
+}
+
 }  // namespace
 }  // namespace husky
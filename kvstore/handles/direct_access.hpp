@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+#include "core/constants.hpp"
+
+namespace kvstore {
+
+/*
+ * Direct access to the storage of a server by the kvworkers in the same process
+ *
+ * The kvworkers read and update the storage in their own threads instead of sending
+ * a message, so the server must synchronize these calls with its Process.
+ * Only servers without consistency control provide it, SSP/BSP need the request
+ * order of the mailbox.
+ */
+class DirectAccessBase {
+   public:
+    virtual ~DirectAccessBase() {}
+};
+
+template <typename Val>
+class DirectAccess : public DirectAccessBase {
+   public:
+    virtual void DirectUpdate(const husky::constants::Key* keys, const Val* vals, size_t n) = 0;
+    virtual void DirectRetrieve(const husky::constants::Key* keys, Val* vals, size_t n) = 0;
+    // chunks[i] is the chunk of chunk_ids[i], resized by DirectRetrieveChunks
+    virtual void DirectUpdateChunks(const size_t* chunk_ids, const std::vector<Val>* const* chunks, size_t n) = 0;
+    virtual void DirectRetrieveChunks(const size_t* chunk_ids, std::vector<Val>* const* chunks, size_t n) = 0;
+};
+
+}  // namespace kvstore
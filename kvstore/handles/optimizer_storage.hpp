@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/constants.hpp"
+#include "husky/base/exception.hpp"
+#include "kvstore/chunk_versions.hpp"
+#include "kvstore/flat_map.hpp"
+#include "kvstore/range_manager.hpp"
+
+namespace kvstore {
+
+/*
+ * The hyper-parameters of the server-side optimizers
+ *
+ * AdaGrad: alpha, epsilon
+ * Adam: alpha, beta1, beta2, epsilon
+ * FTRL-Proximal: alpha, beta, l1, l2
+ */
+struct ServerOptimizerConfig {
+    float alpha = 0.1;
+    float beta = 1.0;
+    float beta1 = 0.9;
+    float beta2 = 0.999;
+    float epsilon = 1e-8;
+    float l1 = 0.0;
+    float l2 = 0.0;
+};
+
+/*
+ * Update rules of the server-side optimizers
+ *
+ * Each rule defines an Entry that keeps the weight and the optimizer state of one key,
+ * and Update(entry, grad) which applies one raw gradient to the entry.
+ */
+template <typename Val>
+struct AdaGradRule {
+    struct Entry {
+        Val weight = Val();
+        Val sum_sq_grad = Val();
+    };
+    explicit AdaGradRule(const ServerOptimizerConfig& config) : config_(config) {}
+    void Update(Entry& e, Val grad) const {
+        e.sum_sq_grad += grad * grad;
+        e.weight -= config_.alpha * grad / (std::sqrt(e.sum_sq_grad) + config_.epsilon);
+    }
+    ServerOptimizerConfig config_;
+};
+
+template <typename Val>
+struct AdamRule {
+    struct Entry {
+        Val weight = Val();
+        Val m = Val();
+        Val v = Val();
+        int t = 0;  // number of updates on this key
+    };
+    explicit AdamRule(const ServerOptimizerConfig& config) : config_(config) {}
+    void Update(Entry& e, Val grad) const {
+        e.t += 1;
+        e.m = config_.beta1 * e.m + (1 - config_.beta1) * grad;
+        e.v = config_.beta2 * e.v + (1 - config_.beta2) * grad * grad;
+        Val m_hat = e.m / (1 - std::pow(config_.beta1, e.t));
+        Val v_hat = e.v / (1 - std::pow(config_.beta2, e.t));
+        e.weight -= config_.alpha * m_hat / (std::sqrt(v_hat) + config_.epsilon);
+    }
+    ServerOptimizerConfig config_;
+};
+
+template <typename Val>
+struct FTRLRule {
+    struct Entry {
+        Val weight = Val();
+        Val z = Val();
+        Val n = Val();
+    };
+    explicit FTRLRule(const ServerOptimizerConfig& config) : config_(config) {}
+    void Update(Entry& e, Val grad) const {
+        Val sigma = (std::sqrt(e.n + grad * grad) - std::sqrt(e.n)) / config_.alpha;
+        e.z += grad - sigma * e.weight;
+        e.n += grad * grad;
+        if (std::abs(e.z) <= config_.l1) {
+            e.weight = 0;
+        } else {
+            Val sign = e.z < 0 ? -1 : 1;
+            e.weight = -(e.z - sign * config_.l1) / ((config_.beta + std::sqrt(e.n)) / config_.alpha + config_.l2);
+        }
+    }
+    ServerOptimizerConfig config_;
+};
+
+/*
+ * OptimizerStorage: a StorageT that keeps the optimizer state next to each weight
+ *
+ * It can be used by DefaultUpdateServer/BSPServer/SSPServer with add update,
+ * so all the push/pull commands work unchanged:
+ *   store[key] += grad: apply the raw gradient with RuleT
+ *   store[key] = weight: overwrite the weight, the state is untouched
+ *   Val w = store[key]: read the weight
+ *
+ * EntryStorageT is std::vector<Entry> or FlatMap<Entry>
+ *
+ * With round updates (for BSPServer/SSPServer), += only sums the gradients of the round per key,
+ * and the server calls commit_round when the round completes, which applies one step per key with
+ * the sum. So an optimizer takes one step per round, not one per worker push, and the t of Adam
+ * counts the rounds. Only += touches the round, reads leave no gradient behind. The versions of
+ * the buffered keys are bumped when the round is committed, as that is when their weights change.
+ */
+template <typename Val, typename RuleT, typename EntryStorageT>
+class OptimizerStorage {
+   public:
+    using Entry = typename RuleT::Entry;
+
+    class Ref {
+       public:
+        Ref(Entry& entry, OptimizerStorage& storage, husky::constants::Key key) : entry_(entry), storage_(storage), key_(key) {}
+        operator Val() const { return entry_.weight; }
+        Ref& operator=(Val weight) {
+            entry_.weight = weight;
+            return *this;
+        }
+        Ref& operator+=(Val grad) {
+            if (storage_.round_updates_)
+                storage_.round_grads_[key_] += grad;
+            else
+                storage_.rule_.Update(entry_, grad);
+            return *this;
+        }
+
+       private:
+        Entry& entry_;
+        OptimizerStorage& storage_;
+        husky::constants::Key key_;
+    };
+
+    OptimizerStorage(EntryStorageT&& store, const ServerOptimizerConfig& config)
+        : store_(std::move(store)), rule_(config) {}
+
+    Ref operator[](husky::constants::Key key) {
+        return Ref(store_[key], *this, key);
+    }
+
+    bool RoundUpdates() const { return round_updates_; }
+    void SetRoundUpdates(bool round_updates) { round_updates_ = round_updates; }
+
+    /*
+     * Apply the summed gradients of the round, one step per key, and bump the versions of their chunks
+     *
+     * The keys of the store are offset by interval from the kvstore keys, as in update
+     */
+    void CommitRound(int kv_id, int interval, ChunkVersions* versions) {
+        if (round_grads_.empty())
+            return;
+        std::vector<husky::constants::Key> keys;
+        bool bump = versions && versions->enabled();
+        round_grads_.for_each([this, bump, interval, &keys](husky::constants::Key key, Val& grad) {
+            rule_.Update(store_[key], grad);
+            if (bump)
+                keys.push_back(key + interval);
+        });
+        round_grads_.clear();
+        if (bump) {
+            std::sort(keys.begin(), keys.end());
+            versions->BumpKeys(kv_id, keys.data(), keys.size());
+        }
+    }
+
+   private:
+    EntryStorageT store_;
+    RuleT rule_;
+    bool round_updates_ = false;
+    FlatMap<Val> round_grads_;  // the gradients of the round, if round_updates_
+};
+
+/*
+ * Called by BSPServer/SSPServer when a round completes, only OptimizerStorage buffers the round
+ */
+template <typename StorageT>
+void commit_round(int kv_id, int server_id, StorageT& store, bool is_vector, ChunkVersions* versions = nullptr) {}
+
+template <typename Val, typename RuleT, typename EntryStorageT>
+void commit_round(int kv_id, int server_id, OptimizerStorage<Val, RuleT, EntryStorageT>& store, bool is_vector,
+                  ChunkVersions* versions = nullptr) {
+    int interval = is_vector ? RangeManager::Get().GetServerInterval(kv_id, server_id) : 0;
+    store.CommitRound(kv_id, interval, versions);
+}
+
+/*
+ * Whether the pushes to store are buffered until commit_round, update doesn't bump their versions then
+ */
+template <typename StorageT>
+bool buffers_round(const StorageT& store) {
+    return false;
+}
+
+template <typename Val, typename RuleT, typename EntryStorageT>
+bool buffers_round(const OptimizerStorage<Val, RuleT, EntryStorageT>& store) {
+    return store.RoundUpdates();
+}
+
+/*
+ * Turn the round buffering of store on or off and return the previous setting,
+ * the pushes without consistency control are applied at once and leave the round alone
+ */
+template <typename StorageT>
+bool set_round_updates(StorageT& store, bool round_updates) {
+    return false;
+}
+
+template <typename Val, typename RuleT, typename EntryStorageT>
+bool set_round_updates(OptimizerStorage<Val, RuleT, EntryStorageT>& store, bool round_updates) {
+    bool prev = store.RoundUpdates();
+    store.SetRoundUpdates(round_updates);
+    return prev;
+}
+
+}  // namespace kvstore
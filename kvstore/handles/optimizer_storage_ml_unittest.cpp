@@ -0,0 +1,172 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <vector>
+
+#include "kvstore/handles/basic.hpp"
+#include "kvstore/handles/optimizer_storage.hpp"
+
+namespace husky {
+namespace {
+
+using Key = husky::constants::Key;
+
+class TestOptimizerStorage: public testing::Test {
+   public:
+    TestOptimizerStorage() {}
+    ~TestOptimizerStorage() {}
+
+   protected:
+    void SetUp() {
+        config.alpha = 0.5;
+        config.l1 = 0.1;
+        config.l2 = 0.01;
+    }
+    void TearDown() {}
+
+    kvstore::ServerOptimizerConfig config;
+};
+
+TEST_F(TestOptimizerStorage, AdaGrad) {
+    using Rule = kvstore::AdaGradRule<float>;
+    kvstore::OptimizerStorage<float, Rule, kvstore::FlatMap<Rule::Entry>> store(kvstore::FlatMap<Rule::Entry>(), config);
+    float w = 1.0, sum_sq_grad = 0.0;
+    store[3] = 1.0;
+    for (float grad : {0.2, -0.4, 0.1}) {
+        store[3] += grad;
+        sum_sq_grad += grad * grad;
+        w -= config.alpha * grad / (std::sqrt(sum_sq_grad) + config.epsilon);
+    }
+    EXPECT_FLOAT_EQ(store[3], w);
+    EXPECT_EQ(store[4], 0.0);  // untouched key
+}
+
+TEST_F(TestOptimizerStorage, Adam) {
+    using Rule = kvstore::AdamRule<float>;
+    kvstore::OptimizerStorage<float, Rule, std::vector<Rule::Entry>> store(std::vector<Rule::Entry>(2), config);
+    // the first step of Adam moves the weight by alpha * sign(grad)
+    store[0] += 0.3;
+    store[1] += -2.0;
+    EXPECT_NEAR(store[0], -config.alpha, 1e-5);
+    EXPECT_NEAR(store[1], config.alpha, 1e-5);
+}
+
+TEST_F(TestOptimizerStorage, RoundUpdates) {
+    using Rule = kvstore::AdamRule<float>;
+    kvstore::OptimizerStorage<float, Rule, std::vector<Rule::Entry>> store(std::vector<Rule::Entry>(2), config);
+    kvstore::OptimizerStorage<float, Rule, std::vector<Rule::Entry>> expected(std::vector<Rule::Entry>(2), config);
+    store.SetRoundUpdates(true);
+    for (int round = 0; round < 3; ++ round) {
+        // 3 workers push in a round, the weight changes only when the round is committed
+        store[0] += 0.3;
+        store[0] += 0.3;
+        store[0] += -0.1;
+        EXPECT_FLOAT_EQ(store[0], expected[0]);
+        kvstore::commit_round(0, 0, store, false);
+        expected[0] += 0.5;  // one step with the sum
+        EXPECT_FLOAT_EQ(store[0], expected[0]);
+    }
+    EXPECT_EQ(store[1], 0.0);  // untouched key
+}
+
+TEST_F(TestOptimizerStorage, RoundPullOnly) {
+    kvstore::RangeManager::Get().SetNumServers(1);
+    kvstore::RangeManager::Get().SetMaxKeyAndChunkSize(0, 10, 5);
+    using Rule = kvstore::AdamRule<float>;
+    using StorageT = kvstore::OptimizerStorage<float, Rule, kvstore::FlatMap<Rule::Entry>>;
+    StorageT store(kvstore::FlatMap<Rule::Entry>(), config);
+    store.SetRoundUpdates(true);
+    // key 0 gets momentum in the first round
+    store[0] += 0.3;
+    kvstore::commit_round(0, 0, store, false);
+    float w = store[0];
+    for (int round = 0; round < 3; ++ round) {
+        // afterwards it is only pulled, so it takes no more steps
+        base::BinStream pull_bin;
+        kvstore::WriteSArray(pull_bin, kvstore::pslite::SArray<Key>(std::vector<Key>{0, 1}));
+        auto res = kvstore::retrieve<float, StorageT>(0, 0, pull_bin, store, 0, false);
+        EXPECT_FLOAT_EQ(res.vals[0], w);
+        store[1] += 0.1;
+        kvstore::commit_round(0, 0, store, false);
+        EXPECT_FLOAT_EQ(store[0], w);
+    }
+    kvstore::RangeManager::Get().Clear();
+}
+
+TEST_F(TestOptimizerStorage, RoundVersions) {
+    kvstore::RangeManager::Get().SetNumServers(1);
+    kvstore::RangeManager::Get().SetMaxKeyAndChunkSize(0, 10, 5);
+    using Rule = kvstore::AdamRule<float>;
+    using StorageT = kvstore::OptimizerStorage<float, Rule, std::vector<Rule::Entry>>;
+    StorageT store(std::vector<Rule::Entry>(10), config);
+    store.SetRoundUpdates(true);
+    kvstore::ChunkVersions versions;
+    versions.Enable();
+    auto push = [&store, &versions](Key key) {
+        base::BinStream push_bin;
+        kvstore::WriteSArray(push_bin, kvstore::pslite::SArray<Key>(std::vector<Key>{key}));
+        kvstore::WriteSArray(push_bin, kvstore::pslite::SArray<float>(std::vector<float>{1.0}));
+        kvstore::update<float, StorageT>(0, 0, push_bin, store, 0, true, false, &versions);
+    };
+    // a buffered push doesn't change the weights, nor the versions
+    push(7);
+    EXPECT_EQ(versions.Get(1), kvstore::ChunkVersions::kBaseVersion);
+    // the round changes them
+    kvstore::commit_round(0, 0, store, true, &versions);
+    uint32_t committed = versions.Get(1);
+    EXPECT_GT(committed, kvstore::ChunkVersions::kBaseVersion);
+    EXPECT_EQ(versions.Get(0), kvstore::ChunkVersions::kBaseVersion);
+    // a push without the round is applied at once and bumps the version itself
+    push(2);
+    bool round_updates = kvstore::set_round_updates(store, false);
+    push(8);
+    kvstore::set_round_updates(store, round_updates);
+    EXPECT_EQ(versions.Get(0), kvstore::ChunkVersions::kBaseVersion);
+    EXPECT_GT(versions.Get(1), committed);
+    EXPECT_NEAR(store[8], -config.alpha, 1e-5);
+    EXPECT_EQ(store[2], 0.0);  // still buffered in the round
+    kvstore::RangeManager::Get().Clear();
+}
+
+TEST_F(TestOptimizerStorage, FTRL) {
+    using Rule = kvstore::FTRLRule<float>;
+    kvstore::OptimizerStorage<float, Rule, kvstore::FlatMap<Rule::Entry>> store(kvstore::FlatMap<Rule::Entry>(), config);
+    // |z| <= l1, the weight stays zero
+    store[0] += 0.05;
+    EXPECT_EQ(store[0], 0.0);
+    // z = 0.05 + 0.45 = 0.5, n = 0.0025 + 0.2025 = 0.205
+    store[0] += 0.45;
+    float expected = -(0.5 - config.l1) / ((config.beta + std::sqrt(0.205f)) / config.alpha + config.l2);
+    EXPECT_FLOAT_EQ(store[0], expected);
+}
+
+TEST_F(TestOptimizerStorage, PushPull) {
+    // push gradients and pull weights through the kvstore handles
+    kvstore::RangeManager::Get().SetNumServers(1);
+    kvstore::RangeManager::Get().SetMaxKeyAndChunkSize(0, 10, 5);
+    using Rule = kvstore::AdaGradRule<float>;
+    using StorageT = kvstore::OptimizerStorage<float, Rule, std::vector<Rule::Entry>>;
+    StorageT store(std::vector<Rule::Entry>(10), config);
+
+    base::BinStream push_bin;
+    kvstore::WriteSArray(push_bin, kvstore::pslite::SArray<Key>(std::vector<Key>{1, 2, 7}));
+    kvstore::WriteSArray(push_bin, kvstore::pslite::SArray<float>(std::vector<float>{1.0, -1.0, 2.0}));
+    kvstore::update<float, StorageT>(0, 0, push_bin, store, 0, true, false);
+
+    base::BinStream pull_bin;
+    pull_bin << std::vector<size_t>{0, 1};
+    auto res = kvstore::retrieve<float, StorageT>(0, 0, pull_bin, store, 1, true);
+    // the first step of AdaGrad moves the weight by alpha * -sign(grad)
+    std::vector<float> expected(10, 0.0);
+    expected[1] = -config.alpha;
+    expected[2] = config.alpha;
+    expected[7] = -config.alpha;
+    ASSERT_EQ(res.vals.size(), 10);
+    for (int i = 0; i < 10; ++ i) {
+        EXPECT_NEAR(res.vals[i], expected[i], 1e-5);
+    }
+    kvstore::RangeManager::Get().Clear();
+}
+
+}  // namespace
+}  // namespace husky
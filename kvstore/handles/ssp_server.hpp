@@ -1,14 +1,21 @@
 #pragma once
 
+#include <chrono>
+#include <deque>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <tuple>
 #include <unordered_map>
 #include <vector>
 
+#include "core/tracer.hpp"
 #include "husky/base/serialization.hpp"
+#include "kvstore/clock_window.hpp"
 #include "kvstore/handles/basic.hpp"
+#include "kvstore/handles/optimizer_storage.hpp"
 #include "kvstore/kvmanager.hpp"
+#include "kvstore/metrics.hpp"
 
 #include "kvstore/handles/basic_server.hpp"
 
@@ -46,6 +53,11 @@ namespace kvstore {
  *     response
  *   else
  *     block
+ *
+ * Eager SSP: workers may subscribe to chunks (cmd 7), then each time min_clock advances
+ * the subscribed chunks modified since the last push are pushed to the subscribers
+ *
+ * The time the requests stay blocked is recorded in kvstore_ssp_blocked_{pull,push}_ns (see Metrics) and traced
  */
 template <typename Val, typename StorageT>
 class SSPServer : public ServerBase {
@@ -58,13 +70,17 @@ class SSPServer : public ServerBase {
         bin >> cmd;
         bin >> push;
         bin >> src;
+        if (!blocked_pull_ns_) {
+            blocked_pull_ns_ = Metrics::Get().GetHistogram("kvstore_ssp_blocked_pull_ns", kv_id, server_id_);
+            blocked_push_ns_ = Metrics::Get().GetHistogram("kvstore_ssp_blocked_push_ns", kv_id, server_id_);
+        }
         if (cmd == 4) {  // InitForConsistencyControl
             int next_num_workers;
             if (init_count_ == 0) {  // reset the buffer when the first init message comes
                 bin >> next_num_workers;  // get next num workers
                 min_clock_ = 0;
                 worker_progress_.clear();
-                clock_count_.clear();
+                clock_count_.Reset(0, staleness_ + 1);
                 blocked_pulls_.clear();
                 blocked_pushes_.clear();
                 if (next_num_workers != -1) {
@@ -78,17 +94,34 @@ class SSPServer : public ServerBase {
             Response<Val>(kv_id, ts, cmd, push, src, KVPairs<Val>(), customer);  // Reply directly
             return;
         }
+        if (cmd == 7) {  // Subscribe, replace the subscription of src
+            std::vector<size_t> chunk_ids;
+            bin >> chunk_ids;
+            if (chunk_ids.empty()) {
+                subscriptions_.erase(src);
+            } else {
+                versions_.Enable();
+                auto& sub = subscriptions_[src];
+                sub.second.assign(chunk_ids.size(), ChunkVersions::kNoVersion);  // nothing is sent yet
+                sub.first = std::move(chunk_ids);
+            }
+            Response<Val>(kv_id, ts, cmd, push, src, KVPairs<Val>(), customer);  // Reply directly
+            return;
+        }
         if (cmd >= consistency_control_off_magic_) {  // Without consistency_control
             cmd %= consistency_control_off_magic_;
             if (push == true) {  // if is push
                 if (bin.size()) {  // if bin is empty, don't reply
-                    update<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_, false);
+                    // no round without consistency control, apply this push at once
+                    bool round_updates = set_round_updates(store_, false);
+                    update<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_, false, &versions_);
+                    set_round_updates(store_, round_updates);
                     Response<Val>(kv_id, ts, cmd, push, src, KVPairs<Val>(), customer);
                 }
             } else {  // if is pull
                 if (bin.size()) {  // if bin is empty, don't reply
                     KVPairs<Val> res;
-                    res = retrieve<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_); 
+                    res = retrieve<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_, &versions_); 
                     Response<Val>(kv_id, ts, cmd, push, src, res, customer);
                 }
             }
@@ -99,78 +132,135 @@ class SSPServer : public ServerBase {
             worker_progress_.resize(src + 1);
         if (push) {  // if is push
             int progress = worker_progress_[src];
-            if (progress >= clock_count_.size())
-                clock_count_.resize(progress + 1);
             clock_count_[progress] += 1;  // add clock_count_
             worker_progress_[src] += 1;  // advance progress
             int expected_min_clock = progress - staleness_;
             if (expected_min_clock <= min_clock_) {  // acceptable staleness so process it
                 process_push(kv_id, ts, cmd, src, bin, customer);
             } else {  // blocked to expected_min_clock
-                if (blocked_pushes_.size() <= expected_min_clock)
-                    blocked_pushes_.resize(expected_min_clock+1);
-                blocked_pushes_[expected_min_clock].emplace_back(cmd, src, ts, std::move(bin));
+                blocked_pushes_.emplace_back(expected_min_clock, cmd, src, ts, std::move(bin));
             }
         } else {  // if is pull
             int expected_min_clock = worker_progress_[src] - staleness_;
             if (expected_min_clock <= min_clock_) {  // acceptable staleness so reply it
                 if (bin.size()) {  // if bin is empty, don't reply
-                    KVPairs<Val> res = retrieve<Val, StorageT>(kv_id, server_id_, bin, store_, cmd>with_min_clock_magic_?cmd-with_min_clock_magic_:cmd, is_vector_);
+                    KVPairs<Val> res = retrieve<Val, StorageT>(kv_id, server_id_, bin, store_, cmd>with_min_clock_magic_?cmd-with_min_clock_magic_:cmd, is_vector_, &versions_);
                     if (cmd > with_min_clock_magic_)
                         Response<Val>(kv_id, ts, cmd, push, src, res, customer, min_clock_);
                     else
                         Response<Val>(kv_id, ts, cmd, push, src, res, customer);
                 }
             } else {  // block it to expected_min_clock(i.e. worker_progress_[src] - staleness_)
-                if (blocked_pulls_.size() <= expected_min_clock)
-                    blocked_pulls_.resize(expected_min_clock + 1);
-                blocked_pulls_[expected_min_clock].emplace_back(cmd, src, ts, std::move(bin));
+                blocked_pulls_.emplace_back(expected_min_clock, cmd, src, ts, std::move(bin));
             }
         }
     }
     SSPServer() = delete;
     SSPServer(int server_id, int num_workers, StorageT&& store, bool is_vector, int staleness)
-        : server_id_(server_id), num_workers_(num_workers), worker_progress_(num_workers), store_(std::move(store)), is_vector_(is_vector), staleness_(staleness) {
+        : server_id_(server_id), num_workers_(num_workers), worker_progress_(num_workers), store_(std::move(store)), is_vector_(is_vector), staleness_(staleness),
+          clock_count_(staleness + 1) {
         assert(staleness_ >= 0);
-        assert(staleness_ <= 10);
     }
+    virtual bool AcceptSubscribe() const override { return true; }
 
    private:
+    struct BlockedRequest {
+        BlockedRequest(int clock, int cmd, int src, int ts, husky::base::BinStream&& bin)
+            : clock(clock), cmd(cmd), src(src), ts(ts), bin(std::move(bin)), since(std::chrono::steady_clock::now()) {}
+        int clock;  // released when min_clock_ reaches it
+        int cmd;
+        int src;
+        int ts;
+        husky::base::BinStream bin;
+        std::chrono::steady_clock::time_point since;  // blocked since
+    };
+
     /*
      * Function to process_push
      */
     void process_push(int kv_id, int ts, int cmd, int src, husky::base::BinStream& bin, ServerCustomer* customer) {
         if (bin.size()) {  // if bin is empty, don't reply
-            update<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_, false);
+            update<Val, StorageT>(kv_id, server_id_, bin, store_, cmd, is_vector_, false, &versions_);
             Response<Val>(kv_id, ts, cmd, true, src, KVPairs<Val>(), customer);
         }
         if (clock_count_[min_clock_] == num_workers_) {
+            clock_count_.PopFront();
             min_clock_ += 1;
+            commit_round(kv_id, server_id_, store_, is_vector_, &versions_);  // the optimizer storages take one step per min_clock
             // release all push blocked at min_clock_
-            if (blocked_pushes_.size() <= min_clock_)
-                blocked_pushes_.resize(min_clock_ + 1);
-            for (auto& push_pair : blocked_pushes_[min_clock_]) {
-                if (std::get<3>(push_pair).size()) {
-                    int push_cmd = std::get<0>(push_pair);
-                    update<Val, StorageT>(kv_id, server_id_, std::get<3>(push_pair), store_, push_cmd, is_vector_, false);
-                    Response<Val>(kv_id, std::get<2>(push_pair), push_cmd, true, std::get<1>(push_pair), KVPairs<Val>(), customer);
+            for (auto& req : release(blocked_pushes_, blocked_push_ns_, "blocked push", kv_id)) {
+                if (req.bin.size()) {
+                    update<Val, StorageT>(kv_id, server_id_, req.bin, store_, req.cmd, is_vector_, false, &versions_);
+                    Response<Val>(kv_id, req.ts, req.cmd, true, req.src, KVPairs<Val>(), customer);
                 }
             }
-            std::vector<std::tuple<int, int, int, husky::base::BinStream>>().swap(blocked_pushes_[min_clock_]);
             // release all pull blocked at min_clock_
-            if (blocked_pulls_.size() <= min_clock_)
-                blocked_pulls_.resize(min_clock_ + 1);
-            for (auto& pull_pair : blocked_pulls_[min_clock_]) {
-                if (std::get<3>(pull_pair).size()) {  // if bin is empty, don't reply
-                    int pull_cmd = std::get<0>(pull_pair);
-                    KVPairs<Val> res = retrieve<Val, StorageT>(kv_id, server_id_, std::get<3>(pull_pair), store_, pull_cmd>with_min_clock_magic_?pull_cmd-with_min_clock_magic_:pull_cmd, is_vector_);
-                    if (pull_cmd > with_min_clock_magic_)  // PullChunksWithMinClock
-                        Response<Val>(kv_id, std::get<2>(pull_pair), std::get<0>(pull_pair), false, std::get<1>(pull_pair), res, customer, min_clock_);
+            for (auto& req : release(blocked_pulls_, blocked_pull_ns_, "blocked pull", kv_id)) {
+                if (req.bin.size()) {  // if bin is empty, don't reply
+                    KVPairs<Val> res = retrieve<Val, StorageT>(kv_id, server_id_, req.bin, store_, req.cmd>with_min_clock_magic_?req.cmd-with_min_clock_magic_:req.cmd, is_vector_, &versions_);
+                    if (req.cmd > with_min_clock_magic_)  // PullChunksWithMinClock
+                        Response<Val>(kv_id, req.ts, req.cmd, false, req.src, res, customer, min_clock_);
                     else
-                        Response<Val>(kv_id, std::get<2>(pull_pair), std::get<0>(pull_pair), false, std::get<1>(pull_pair), res, customer);
+                        Response<Val>(kv_id, req.ts, req.cmd, false, req.src, res, customer);
                 }
             }
-            std::vector<std::tuple<int, int, int, husky::base::BinStream>>().swap(blocked_pulls_[min_clock_]);
+            // push to the subscribers
+            push_to_subscribers(kv_id, customer);
+        }
+    }
+
+    /*
+     * Function to take the requests blocked at min_clock_ out of queue, in arrival order
+     *
+     * The time they were blocked is recorded in blocked_ns, and traced as trace_name
+     */
+    std::vector<BlockedRequest> release(std::deque<BlockedRequest>& queue, Metrics::Histogram* blocked_ns, const char* trace_name, int kv_id) {
+        std::vector<BlockedRequest> released;
+        std::deque<BlockedRequest> kept;
+        auto now = std::chrono::steady_clock::now();
+        for (auto& req : queue) {
+            if (req.clock <= min_clock_) {
+                if (Metrics::Enabled())
+                    blocked_ns->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - req.since).count());
+                if (husky::Tracer::Enabled() && husky::Tracer::Get().Sample())
+                    husky::Tracer::Get().Complete(trace_name, "kvserver", husky::Tracer::ToNs(req.since),
+                                                  husky::Tracer::ToNs(now), "kv_id", kv_id);
+                released.push_back(std::move(req));
+            } else
+                kept.push_back(std::move(req));
+        }
+        queue.swap(kept);
+        return released;
+    }
+
+    /*
+     * Function to push the modified subscribed chunks with min_clock_ to each subscriber
+     */
+    void push_to_subscribers(int kv_id, ServerCustomer* customer) {
+        for (auto& kv : subscriptions_) {
+            auto& chunk_ids = kv.second.first;
+            auto& sent_versions = kv.second.second;
+            husky::base::BinStream req;
+            req << chunk_ids << sent_versions;
+            KVPairs<Val> res = retrieve<Val, StorageT>(kv_id, server_id_, req, store_, 6, is_vector_, &versions_);
+            std::vector<uint32_t> versions(res.keys.size());
+            std::vector<size_t> unmodified;
+            size_t j = 0;
+            for (size_t i = 0; i < chunk_ids.size(); ++ i) {
+                if (j < res.keys.size() && res.keys[j] == chunk_ids[i]) {
+                    versions[j] = sent_versions[i] = versions_.Get(chunk_ids[i]);
+                    j += 1;
+                } else {
+                    unmodified.push_back(chunk_ids[i]);
+                }
+            }
+            int ts = server_push_ts_;
+            int cmd = 7;
+            bool push = false;
+            husky::base::BinStream bin;
+            bin << kv_id << ts << cmd << push << kv.first;
+            bin << res.keys << res.vals << versions << unmodified << min_clock_;
+            customer->send(kv.first, bin);
         }
     }
 
@@ -179,10 +269,12 @@ class SSPServer : public ServerBase {
     int staleness_ = 0;
 
     int min_clock_ = 0;
-    std::vector<int> clock_count_;  // TODO: may use round array to reduce the space
+    ClockWindow<int> clock_count_;  // the clocks from min_clock_ on, staleness_ + 1 in the steady state
     std::vector<int> worker_progress_;
-    std::vector<std::vector<std::tuple<int, int, int, husky::base::BinStream>>> blocked_pushes_;   // cmd, src, ts, bin
-    std::vector<std::vector<std::tuple<int, int, int, husky::base::BinStream>>> blocked_pulls_;   // cmd, src, ts, bin
+    // the blocked requests are few (at most about one per worker), so they are kept in a queue
+    std::deque<BlockedRequest> blocked_pushes_;
+    std::deque<BlockedRequest> blocked_pulls_;
+    std::map<int, std::pair<std::vector<size_t>, std::vector<uint32_t>>> subscriptions_;  // {src, (chunk_ids, sent versions)}
     // default storage method is unordered_map
     bool is_vector_ = false;
     // The real storeage
@@ -191,6 +283,10 @@ class SSPServer : public ServerBase {
 
     // For init
     int init_count_ = 0;
+
+    // metrics, set by the first request
+    Metrics::Histogram* blocked_pull_ns_ = nullptr;
+    Metrics::Histogram* blocked_push_ns_ = nullptr;
 };
 
 }  // namespace kvstore
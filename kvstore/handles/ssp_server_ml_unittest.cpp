@@ -1,5 +1,9 @@
 #include "gtest/gtest.h"
 
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "kvstore/kvstore.hpp"
 
 namespace husky {
@@ -108,5 +112,84 @@ TEST_F(TestSSPServer, PullChunksWithMinClock) {
     kvstore::KVStore::Get().Stop();
 }
 
+TEST_F(TestSSPServer, LargeStaleness) {
+    // Start KVStore with 3 servers on each process
+    kvstore::KVStore::Get().Start(worker_info, el, zmq_context, 3);
+
+    int staleness = 20;
+    int kv = kvstore::KVStore::Get().CreateKVStore<float>("ssp_add_map", 2, staleness, 9, 4);
+
+    auto run = [kv, staleness](int local_id) {
+        auto* kvworker = kvstore::KVStore::Get().get_kvworker(local_id);
+        std::vector<size_t> chunk_ids{0,1};
+        std::vector<std::vector<float>> params(2);
+        std::vector<std::vector<float>*> vals{&params[0], &params[1]};
+        for (int i = 0; i < 100; ++ i) {
+            int min_clock;
+            kvworker->Wait(kv, kvworker->PullChunksWithMinClock(kv, chunk_ids, vals, &min_clock));
+            EXPECT_GE(min_clock, i - staleness);
+            kvworker->Wait(kv, kvworker->PushChunks(kv, chunk_ids, vals));
+        }
+    };
+    std::thread th1(run, 0);
+    std::thread th2(run, 1);
+    th1.join();
+    th2.join();
+    kvstore::KVStore::Get().Stop();
+}
+
+TEST_F(TestSSPServer, EagerSSP) {
+    // Start KVStore with 3 servers on each process
+    kvstore::KVStore::Get().Start(worker_info, el, zmq_context, 3);
+
+    int kv = kvstore::KVStore::Get().CreateKVStore<float>("ssp_add_vector", 2, 1, 9, 4);
+    // chunks: {[0, 4), [4, 8), [8, 9)}, one on each server
+
+    // worker 0 subscribes to all the chunks
+    auto* kvworker0 = kvstore::KVStore::Get().get_kvworker(0);
+    std::mutex mu;
+    std::vector<float> chunk0;
+    std::vector<int> min_clocks(3, -1);  // the latest min_clock pushed for each chunk
+    kvworker0->Wait(kv, kvworker0->Subscribe<float>(kv, {0, 1, 2}, [&](kvstore::EagerChunks<float>& chunks) {
+        std::lock_guard<std::mutex> lk(mu);
+        for (size_t i = 0; i < chunks.kvs.keys.size(); ++ i) {
+            min_clocks[chunks.kvs.keys[i]] = chunks.min_clock;
+            if (chunks.kvs.keys[i] == 0)
+                chunk0.assign(chunks.kvs.vals.begin(), chunks.kvs.vals.begin() + 4);
+        }
+        for (auto chunk_id : chunks.unmodified)
+            min_clocks[chunk_id] = chunks.min_clock;
+    }));
+
+    auto push = [kv](int local_id) {
+        auto* kvworker = kvstore::KVStore::Get().get_kvworker(local_id);
+        std::vector<float> chunk(4, 1.0);
+        std::vector<std::vector<float>*> vals{&chunk};
+        for (int i = 0; i < 3; ++ i) {
+            kvworker->Wait(kv, kvworker->PushChunks(kv, {0}, vals));
+        }
+    };
+    std::thread th1(push, 0);
+    std::thread th2(push, 1);
+    th1.join();
+    th2.join();
+    // unsubscribe, the chunks pushed before are all handled once it returns
+    kvworker0->Wait(kv, kvworker0->Subscribe<float>(kv, {}, nullptr));
+
+    EXPECT_EQ(chunk0, std::vector<float>(4, 6.0));
+    EXPECT_EQ(min_clocks, std::vector<int>(3, 3));
+    kvstore::KVStore::Get().Stop();
+}
+
+TEST_F(TestSSPServer, SubscribeNotSSP) {
+    kvstore::KVStore::Get().Start(worker_info, el, zmq_context, 3);
+    int kv = kvstore::KVStore::Get().CreateKVStore<float>("bsp_add_vector", 2, -1, 9, 4);
+    auto* kvworker0 = kvstore::KVStore::Get().get_kvworker(0);
+    // rejected in the kvworker, nothing is sent to the BSP servers
+    EXPECT_THROW(kvworker0->Subscribe<float>(kv, {0, 1, 2}, [](kvstore::EagerChunks<float>&) {}),
+                 husky::base::HuskyException);
+    kvstore::KVStore::Get().Stop();
+}
+
 }  // namespace
 }  // namespace husky
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "core/constants.hpp"
+#include "husky/base/exception.hpp"
+#include "husky/base/serialization.hpp"
+#include "kvstore/ps_lite/sarray.h"
+
+namespace kvstore {
+
+/*
+ * The wire encoding of the keys in Push/Pull
+ *
+ * kRaw: 8-byte keys, the same as serializing the SArray directly
+ * kDeltaVarint: each key is encoded as the zigzag varint of the difference to the previous key
+ * kDeltaVarintRuns: consecutive keys are grouped into runs, each run is encoded as
+ *     (zigzag varint of the gap to the end of the previous run, varint of the run length)
+ *
+ * Keys in Push/Pull are sorted, so the deltas are small and usually take 1 or 2 bytes.
+ * Dense ranges only cost a couple of bytes per run with kDeltaVarintRuns.
+ */
+enum class KeyCodec : uint8_t {
+    kRaw = 0,
+    kDeltaVarint = 1,
+    kDeltaVarintRuns = 2
+};
+
+namespace key_codec {
+
+inline void PutVarint(std::string* buf, uint64_t v) {
+    while (v >= 0x80) {
+        buf->push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    buf->push_back(static_cast<char>(v));
+}
+
+inline uint64_t GetVarint(const uint8_t** p) {
+    uint64_t v = 0;
+    int shift = 0;
+    while (**p & 0x80) {
+        v |= static_cast<uint64_t>(**p & 0x7f) << shift;
+        shift += 7;
+        ++ *p;
+    }
+    v |= static_cast<uint64_t>(**p) << shift;
+    ++ *p;
+    return v;
+}
+
+// zigzag so that the rare non-increasing keys are still encoded correctly
+inline uint64_t ZigZag(uint64_t delta) { return (delta << 1) ^ -(delta >> 63); }
+inline uint64_t UnZigZag(uint64_t v) { return (v >> 1) ^ -(v & 1); }
+
+}  // namespace key_codec
+
+/*
+ * Encode keys into bin with codec
+ *
+ * Format: codec, num_keys, num_bytes, bytes (kRaw: codec, keys)
+ */
+inline void EncodeKeys(KeyCodec codec, const pslite::SArray<husky::constants::Key>& keys, husky::base::BinStream& bin) {
+    using namespace key_codec;
+    bin << static_cast<uint8_t>(codec);
+    if (codec == KeyCodec::kRaw) {
+        bin << keys;
+        return;
+    }
+    std::string buf;
+    buf.reserve(keys.size() * 2);
+    uint64_t prev = 0;
+    if (codec == KeyCodec::kDeltaVarint) {
+        for (size_t i = 0; i < keys.size(); ++ i) {
+            PutVarint(&buf, ZigZag(keys[i] - prev));
+            prev = keys[i];
+        }
+    } else if (codec == KeyCodec::kDeltaVarintRuns) {
+        size_t i = 0;
+        while (i < keys.size()) {
+            size_t j = i + 1;
+            while (j < keys.size() && keys[j] == keys[j - 1] + 1)
+                ++ j;
+            PutVarint(&buf, ZigZag(keys[i] - prev));
+            PutVarint(&buf, j - i);
+            prev = keys[j - 1] + 1;
+            i = j;
+        }
+    } else {
+        throw husky::base::HuskyException("Unknown key codec " + std::to_string(static_cast<int>(codec)));
+    }
+    bin << keys.size() << buf.size();
+    bin.push_back_bytes(buf.data(), buf.size());
+}
+
+/*
+ * Decode the keys encoded by EncodeKeys from bin
+ */
+inline void DecodeKeys(husky::base::BinStream& bin, pslite::SArray<husky::constants::Key>* keys) {
+    using namespace key_codec;
+    uint8_t codec;
+    bin >> codec;
+    if (static_cast<KeyCodec>(codec) == KeyCodec::kRaw) {
+        bin >> *keys;
+        return;
+    }
+    size_t num_keys, num_bytes;
+    bin >> num_keys >> num_bytes;
+    keys->resize(num_keys);
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(bin.pop_front_bytes(num_bytes));
+    husky::constants::Key* out = keys->data();
+    uint64_t prev = 0;
+    if (static_cast<KeyCodec>(codec) == KeyCodec::kDeltaVarint) {
+        for (size_t i = 0; i < num_keys; ++ i) {
+            prev += UnZigZag(GetVarint(&p));
+            out[i] = prev;
+        }
+    } else if (static_cast<KeyCodec>(codec) == KeyCodec::kDeltaVarintRuns) {
+        size_t i = 0;
+        while (i < num_keys) {
+            uint64_t start = prev + UnZigZag(GetVarint(&p));
+            uint64_t len = GetVarint(&p);
+            for (uint64_t j = 0; j < len; ++ j) {
+                out[i ++] = start + j;
+            }
+            prev = start + len;
+        }
+    } else {
+        throw husky::base::HuskyException("Unknown key codec " + std::to_string(static_cast<int>(codec)));
+    }
+}
+
+}  // namespace kvstore
@@ -0,0 +1,69 @@
+#include "gtest/gtest.h"
+
+#include <limits>
+#include <vector>
+
+#include "kvstore/key_codec.hpp"
+
+namespace husky {
+namespace {
+
+using Key = husky::constants::Key;
+
+class TestKeyCodec: public testing::Test {
+   public:
+    TestKeyCodec() {}
+    ~TestKeyCodec() {}
+
+   protected:
+    void SetUp() {}
+    void TearDown() {}
+};
+
+void TestRoundTrip(kvstore::KeyCodec codec, const std::vector<Key>& keys) {
+    base::BinStream bin;
+    kvstore::EncodeKeys(codec, kvstore::pslite::SArray<Key>(keys), bin);
+    int tail = 7;
+    bin << tail;
+    kvstore::pslite::SArray<Key> res;
+    kvstore::DecodeKeys(bin, &res);
+    EXPECT_EQ(std::vector<Key>(res.begin(), res.end()), keys);
+    bin >> tail;
+    EXPECT_EQ(tail, 7);
+    EXPECT_EQ(bin.size(), 0);
+}
+
+TEST_F(TestKeyCodec, RoundTrip) {
+    auto max = std::numeric_limits<Key>::max();
+    std::vector<std::vector<Key>> cases{
+        {},
+        {0},
+        {1, 2, 3, 10, 11, 300, 100000, 100001},
+        {5, 5, 3, 9},  // non-increasing keys
+        {0, max - 1, max},
+    };
+    for (auto codec : {kvstore::KeyCodec::kRaw, kvstore::KeyCodec::kDeltaVarint, kvstore::KeyCodec::kDeltaVarintRuns}) {
+        for (auto& keys : cases) {
+            TestRoundTrip(codec, keys);
+        }
+    }
+}
+
+TEST_F(TestKeyCodec, Size) {
+    std::vector<Key> dense(1000), sparse(1000);
+    for (int i = 0; i < 1000; ++ i) {
+        dense[i] = 5000 + i;
+        sparse[i] = i * 100;
+    }
+    auto encoded_size = [](kvstore::KeyCodec codec, const std::vector<Key>& keys) {
+        base::BinStream bin;
+        kvstore::EncodeKeys(codec, kvstore::pslite::SArray<Key>(keys), bin);
+        return bin.size();
+    };
+    EXPECT_LT(encoded_size(kvstore::KeyCodec::kDeltaVarint, sparse), 2 * 1000 + 32);
+    EXPECT_LT(encoded_size(kvstore::KeyCodec::kDeltaVarintRuns, dense), 32);
+    EXPECT_GT(encoded_size(kvstore::KeyCodec::kRaw, dense), 8 * 1000);
+}
+
+}  // namespace
+}  // namespace husky
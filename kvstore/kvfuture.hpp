@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace kvstore {
+
+/*
+ * KVFuture: the handle of an asynchronous request, see KVWorker::PullAsync
+ *
+ * The request completes once the replies of all the servers are written into the
+ * destination of the caller. Copies of a KVFuture share the same state.
+ */
+class KVFuture {
+   public:
+    using Callback = std::function<void()>;
+
+    KVFuture() = default;
+
+    /*
+     * Create a future which is completed by Complete()
+     */
+    static KVFuture Make() {
+        KVFuture future;
+        future.state_ = std::make_shared<State>();
+        return future;
+    }
+
+    /*
+     * A future which completes when all the futures complete
+     */
+    static KVFuture WhenAll(const std::vector<KVFuture>& futures) {
+        KVFuture all = Make();
+        auto pending = std::make_shared<std::atomic<size_t>>(futures.size() + 1);
+        auto state = all.state_;
+        auto done = [pending, state]() {
+            if (pending->fetch_sub(1) == 1)
+                Complete(state);
+        };
+        for (const auto& future : futures)
+            future.Then(done);
+        done();  // for the empty list
+        return all;
+    }
+
+    bool Valid() const { return state_ != nullptr; }
+
+    bool Ready() const {
+        std::lock_guard<std::mutex> lk(state_->mu);
+        return state_->done;
+    }
+
+    /*
+     * Block until the request completes
+     */
+    void Wait() const {
+        std::unique_lock<std::mutex> lk(state_->mu);
+        state_->cond.wait(lk, [this] { return state_->done; });
+    }
+
+    /*
+     * Run cb once the request completes
+     *
+     * cb runs immediately if the request has completed, otherwise in the thread receiving
+     * the last reply, so keep it short.
+     */
+    const KVFuture& Then(const Callback& cb) const {
+        std::unique_lock<std::mutex> lk(state_->mu);
+        if (!state_->done) {
+            state_->thens.push_back(cb);
+            return *this;
+        }
+        lk.unlock();
+        cb();
+        return *this;
+    }
+
+    void Complete() const { Complete(state_); }
+
+   private:
+    struct State {
+        std::mutex mu;
+        std::condition_variable cond;
+        bool done = false;
+        std::vector<Callback> thens;
+    };
+
+    static void Complete(const std::shared_ptr<State>& state) {
+        std::vector<Callback> thens;
+        {
+            std::lock_guard<std::mutex> lk(state->mu);
+            assert(!state->done);
+            state->done = true;
+            thens.swap(state->thens);
+        }
+        state->cond.notify_all();
+        for (auto& cb : thens)
+            cb();
+    }
+
+    std::shared_ptr<State> state_;
+};
+
+}  // namespace kvstore
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <thread>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 
+#include "core/tracer.hpp"
 #include "core/utility.hpp"
 
 #include "kvpairs.hpp"
@@ -39,8 +44,12 @@ template <typename Val>
 class KVServer : public KVServerBase {
    public:
     KVServer() = delete;
-    KVServer(int kv_id, std::unique_ptr<ServerBase>&& server) 
-        : server_base_(std::move(server)) {}
+    KVServer(int kv_id, int server_id, std::unique_ptr<ServerBase>&& server) 
+        : server_base_(std::move(server)),
+          requests_(Metrics::Get().GetCounter("kvstore_server_requests_total", kv_id, server_id)),
+          bytes_in_(Metrics::Get().GetCounter("kvstore_server_bytes_in_total", kv_id, server_id)),
+          bytes_out_(Metrics::Get().GetCounter("kvstore_server_bytes_out_total", kv_id, server_id)),
+          handle_ns_(Metrics::Get().GetHistogram("kvstore_server_handle_ns", kv_id, server_id)) {}
     /*
     KVServer(int kv_id, int server_id, const std::map<std::string, std::string>& hint) {
         try {
@@ -141,27 +150,85 @@ class KVServer : public KVServerBase {
      * Handle the BinStream and then reply
      */
     virtual void HandleAndReply(int kv_id, int ts, husky::base::BinStream& bin, ServerCustomer* customer) override {
-        server_base_->Process(kv_id, ts, bin, customer);
+        husky::TraceScope scope("Process", "kvserver", "kv_id", kv_id, true);
+        if (!Metrics::Enabled()) {
+            server_base_->Process(kv_id, ts, bin, customer);
+            return;
+        }
+        requests_->Add();
+        bytes_in_->Add(bin.size());
+        ServerCustomer::SetBytesOutCounter(bytes_out_);
+        {
+            ScopedTimer timer(handle_ns_);
+            server_base_->Process(kv_id, ts, bin, customer);
+        }
+        ServerCustomer::SetBytesOutCounter(nullptr);
     }
 
    private:
     std::unique_ptr<ServerBase> server_base_;
+    // metrics
+    Metrics::Counter* requests_;
+    Metrics::Counter* bytes_in_;
+    Metrics::Counter* bytes_out_;
+    Metrics::Histogram* handle_ns_;
 };
 
 /*
  * KVManager manages many KVServer, so different types of data can be stored
+ *
+ * A KVManager owns one mailbox and serves one or more server_ids behind it.
+ * With a single server_id, requests are handled directly in the receiving thread.
+ * With more than one server_id, each server_id becomes a shard with its own thread
+ * and FIFO queue, so requests to the same shard keep their order (required by SSP/BSP)
+ * while different shards are processed in parallel.
  */
 class KVManager {
+    /*
+     * A shard serves the key ranges of one server_id
+     */
+    struct ServerShard {
+        std::unordered_map<int, std::unique_ptr<KVServerBase>> kv_store;
+        std::unique_ptr<std::thread> thread;
+        std::mutex mu;
+        std::condition_variable cond;
+        std::deque<std::tuple<int, int, husky::base::BinStream>> queue;  // kv_id, ts, bin
+        bool stopped = false;
+        Metrics::Gauge* queue_depth = nullptr;  // the requests received but not handled yet
+    };
+
    public:
-    KVManager(husky::LocalMailbox& mailbox, int channel_id)
+    KVManager(husky::LocalMailbox& mailbox, int channel_id, const std::vector<int>& server_ids)
         : customer_(new ServerCustomer(
               mailbox, [this](int kv_id, int ts, husky::base::BinStream& bin) { Process(kv_id, ts, bin); },
-              channel_id)) {
+              channel_id)),
+          server_ids_(server_ids),
+          shards_(server_ids.size()) {
+        for (int i = 0; i < server_ids_.size(); ++ i) {
+            shard_pos_.insert({server_ids_[i], i});
+            shards_[i].queue_depth = Metrics::Get().GetGauge("kvstore_server_queue_depth", -1, server_ids_[i]);
+        }
+        if (shards_.size() > 1) {
+            for (int i = 0; i < shards_.size(); ++ i) {
+                shards_[i].thread.reset(new std::thread(&KVManager::ShardLoop, this, i));
+            }
+        }
         customer_->Start();
     }
     ~KVManager() {
         // stop the customer
         customer_->Stop();
+        // stop the shard threads after all the received requests are handled
+        if (shards_.size() > 1) {
+            for (auto& shard : shards_) {
+                {
+                    std::lock_guard<std::mutex> lk(shard.mu);
+                    shard.stopped = true;
+                }
+                shard.cond.notify_one();
+                shard.thread->join();
+            }
+        }
         // kv_store_ will be automatically deleted
     }
 
@@ -170,24 +237,107 @@ class KVManager {
      * make sure all the kvstore is set up before the actual workload
      */
     template <typename Val>
-    void CreateKVManager(int kv_id, std::unique_ptr<ServerBase>&& server) {
-        kv_store_.insert(std::make_pair(kv_id, std::unique_ptr<KVServer<Val>>(new KVServer<Val>(kv_id, std::move(server)))));
+    void CreateKVManager(int kv_id, int server_id, std::unique_ptr<ServerBase>&& server) {
+        auto& kv_store = shards_[GetShardPos(server_id)].kv_store;
+        kv_store.insert(std::make_pair(kv_id, std::unique_ptr<KVServer<Val>>(new KVServer<Val>(kv_id, server_id, std::move(server)))));
     }
 
+    /*
+     * The server_ids served by this KVManager
+     */
+    const std::vector<int>& GetServerIds() const { return server_ids_; }
+
    private:
+    int GetShardPos(int server_id) const {
+        if (shards_.size() == 1)
+            return 0;
+        auto it = shard_pos_.find(server_id);
+        if (it == shard_pos_.end())
+            throw husky::base::HuskyException("[KVManager] server_id " + std::to_string(server_id) + " is not served here");
+        return it->second;
+    }
+
     /*
      * Internal receive handle to dispatch the request
      *
+     * Format: kv_id, ts, server_id, cmd, push, src, data
+     * kv_id and ts are consumed by ServerCustomer
      */
     void Process(int kv_id, int ts, husky::base::BinStream& bin) {
-        assert(kv_store_.find(kv_id) != kv_store_.end());
-        kv_store_[kv_id]->HandleAndReply(kv_id, ts, bin, customer_.get());
+        if (kv_id == batch_kv_id_) {
+            ProcessBatch(bin);
+            return;
+        }
+        int server_id;
+        bin >> server_id;
+        int pos = GetShardPos(server_id);
+        if (shards_.size() == 1) {
+            Handle(shards_[pos], kv_id, ts, bin);
+        } else {
+            auto& shard = shards_[pos];
+            {
+                std::lock_guard<std::mutex> lk(shard.mu);
+                shard.queue.emplace_back(kv_id, ts, std::move(bin));
+            }
+            shard.queue_depth->Add(1);
+            shard.cond.notify_one();
+        }
+    }
+
+    /*
+     * Dispatch the requests of a KVWorker::Batch in order
+     *
+     * Format: server_id, n, then n (size, request)
+     * The requests are all for server_id, so they land in the same shard and keep their order.
+     */
+    void ProcessBatch(husky::base::BinStream& bin) {
+        int server_id;
+        size_t n;
+        bin >> server_id >> n;
+        for (size_t i = 0; i < n; ++ i) {
+            size_t size;
+            bin >> size;
+            husky::base::BinStream request;
+            request.push_back_bytes(static_cast<char*>(bin.pop_front_bytes(size)), size);
+            int kv_id, ts;
+            request >> kv_id >> ts;
+            Process(kv_id, ts, request);
+        }
+    }
+
+    void Handle(ServerShard& shard, int kv_id, int ts, husky::base::BinStream& bin) {
+        assert(shard.kv_store.find(kv_id) != shard.kv_store.end());
+        shard.kv_store[kv_id]->HandleAndReply(kv_id, ts, bin, customer_.get());
+    }
+
+    /*
+     * The loop for each shard thread, the requests are handled in FIFO order
+     */
+    void ShardLoop(int pos) {
+        auto& shard = shards_[pos];
+        while (true) {
+            std::deque<std::tuple<int, int, husky::base::BinStream>> requests;
+            {
+                std::unique_lock<std::mutex> lk(shard.mu);
+                shard.cond.wait(lk, [&shard] { return shard.stopped || !shard.queue.empty(); });
+                if (shard.queue.empty())  // stopped and drained
+                    break;
+                requests.swap(shard.queue);
+            }
+            for (auto& request : requests) {
+                Handle(shard, std::get<0>(request), std::get<1>(request), std::get<2>(request));
+                shard.queue_depth->Add(-1);
+            }
+        }
     }
 
     // customer for communication
     std::unique_ptr<ServerCustomer> customer_;
-    std::unordered_map<int, std::unique_ptr<KVServerBase>> kv_store_;
+    std::vector<int> server_ids_;
+    std::unordered_map<int, int> shard_pos_;  // {server_id, pos in shards_}
+    std::vector<ServerShard> shards_;
 
+    static const int batch_kv_id_ = -1;  // see KVWorker::Batch
 };
 
 }  // namespace kvstore
@@ -2,10 +2,12 @@
 
 namespace kvstore {
 
-void KVStore::Start(const husky::WorkerInfo& worker_info, husky::MailboxEventLoop* const el, zmq::context_t* zmq_context, int num_servers_per_process) {
+void KVStore::Start(const husky::WorkerInfo& worker_info, husky::MailboxEventLoop* const el, zmq::context_t* zmq_context,
+                    int num_servers_per_process, bool share_server_mailbox) {
     is_started_ = true;
     int num_workers = worker_info.get_num_workers();
     num_processes_ = worker_info.get_num_processes();
+    num_workers_ = num_workers;
     // The following mailboxes [num_workers, 2*num_workers) are for kvworkers
     for (int i = 0; i < num_workers; i++) {
         if (worker_info.get_process_id(i) != worker_info.get_process_id()) {
@@ -18,9 +20,11 @@ void KVStore::Start(const husky::WorkerInfo& worker_info, husky::MailboxEventLoo
         }
     }
 
-    // The following mailboxes [2*num_workers, 2*num_workers + num_processes_*num_servers_per_process) are for kvservers
+    // The following mailboxes [2*num_workers, 2*num_workers + num_processes_*num_mailboxes_per_process) are for kvservers
+    // Server j in process i has server_id j * num_processes_ + i
+    int num_mailboxes_per_process = share_server_mailbox ? 1 : num_servers_per_process;
     for (int i = 0; i < num_processes_; ++ i) {
-        for (int j = 0; j < num_servers_per_process; ++ j) {
+        for (int j = 0; j < num_mailboxes_per_process; ++ j) {
             int tid = 2 * num_workers + j * num_processes_ + i;
             if (i != worker_info.get_process_id()) {
                 el->register_peer_thread(i, tid);
@@ -34,17 +38,25 @@ void KVStore::Start(const husky::WorkerInfo& worker_info, husky::MailboxEventLoo
     }
 
     // Create Servers
-    for (int i = 0; i < num_servers_per_process; ++ i) {
-        int server_id = i * num_processes_ + worker_info.get_process_id();
-        kvservers.push_back(new kvstore::KVManager(*kvserver_mailboxes[i].get(), husky::constants::kv_channel_id));
-        server_ids.push_back(server_id);
+    if (share_server_mailbox) {
+        std::vector<int> server_ids;
+        for (int i = 0; i < num_servers_per_process; ++ i) {
+            server_ids.push_back(i * num_processes_ + worker_info.get_process_id());
+        }
+        kvservers.push_back(new kvstore::KVManager(*kvserver_mailboxes[0].get(), husky::constants::kv_channel_id, server_ids));
+    } else {
+        for (int i = 0; i < num_servers_per_process; ++ i) {
+            int server_id = i * num_processes_ + worker_info.get_process_id();
+            kvservers.push_back(new kvstore::KVManager(*kvserver_mailboxes[i].get(), husky::constants::kv_channel_id, {server_id}));
+        }
     }
 
     // Create kvworkers
     std::unordered_map<int, int> server2global;  // Generate the server id to global id map
     for (int i = 0; i < num_processes_; ++ i) {
         for (int j = 0; j < num_servers_per_process; ++ j) {
-            server2global.insert({i + j * num_processes_, 2*num_workers + j * num_processes_ + i});
+            int mailbox_pos = share_server_mailbox ? 0 : j;
+            server2global.insert({i + j * num_processes_, 2*num_workers + mailbox_pos * num_processes_ + i});
         }
     }
     int k = 0;
@@ -63,7 +75,7 @@ void KVStore::Start(const husky::WorkerInfo& worker_info, husky::MailboxEventLoo
         }
     }
     // Set the Rangemanager's NumServers, so RangeManager is ready
-    RangeManager::Get().SetNumServers(kvservers.size()*num_processes_);
+    RangeManager::Get().SetNumServers(num_servers_per_process*num_processes_);
 }
 /*
  * \brief kvstore stop function
@@ -72,6 +84,9 @@ void KVStore::Stop() {
     is_started_ = false;
     kv_id = 0;
     num_processes_ = -1;
+    num_workers_ = -1;
+    pull_combiners_.clear();
+    push_combiners_.clear();
     // 1. delete the kvworkers
     for (auto* p : kvworkers) {
         delete p;
@@ -84,7 +99,6 @@ void KVStore::Stop() {
     }
     kvservers.clear();
     kvserver_mailboxes.clear();
-    server_ids.clear();
     // Clear the RangeManager
     RangeManager::Get().Clear();
 }
@@ -1,16 +1,24 @@
 #pragma once
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 #include "core/constants.hpp"
 #include "husky/core/mailbox.hpp"
 #include "husky/core/worker_info.hpp"
+#include "collective.hpp"
+#include "flat_map.hpp"
 #include "kvmanager.hpp"
 #include "kvworker.hpp"
+#include "pull_combiner.hpp"
+#include "push_combiner.hpp"
 #include "range_manager.hpp"
 
 #include "handles/basic_server.hpp"
 #include "handles/bsp_server.hpp"
+#include "handles/optimizer_storage.hpp"
 #include "handles/ssp_server.hpp"
 
 namespace kvstore {
@@ -36,35 +44,69 @@ class KVStore {
      * \brief kvstore start function
      *
      * Create new mailboxes and add them to el
-     * The last parameter is to set the number of server threads in each process
+     * num_servers_per_process is to set the number of server threads in each process
+     *
+     * If share_server_mailbox is false, each server has its own mailbox.
+     * If share_server_mailbox is true, the servers in one process are shard threads behind one mailbox,
+     * requests are dispatched by server_id and each shard keeps its own request order.
      */
-    void Start(const husky::WorkerInfo& worker_info, husky::MailboxEventLoop* const el, zmq::context_t* zmq_context, int num_servers_per_process = 1);
+    void Start(const husky::WorkerInfo& worker_info, husky::MailboxEventLoop* const el, zmq::context_t* zmq_context,
+               int num_servers_per_process = 1, bool share_server_mailbox = false);
 
     /*
      * \brief kvstore stop function
      */
     void Stop();
 
+    /*
+     * \brief create the server for one kvstore on server_id according to hint
+     *
+     * The *_shared variants of the bsp_add hints retrieve the identical Pull of a round once,
+     * see BSPServer.
+     *
+     * Besides the assign/add hints, the optimizer hints "<consistency>_<optimizer>_<storage>"
+     * keep the optimizer state in the server and apply the pushed raw gradients,
+     * with bsp/ssp the gradients of a round (min clock for ssp) are summed and applied in one step,
+     * consistency: default, bsp, ssp
+     * optimizer: adagrad, adam, ftrl
+     * storage: map, vector
+     * e.g. "ssp_adagrad_map"
+     */
     template <typename Val>
-    std::unique_ptr<ServerBase> ServerFactory(int id, const std::string& hint, int num_workers, int staleness, int server_id) {
+    std::unique_ptr<ServerBase> ServerFactory(int id, const std::string& hint, int num_workers, int staleness, int server_id,
+            const ServerOptimizerConfig& optimizer_config = ServerOptimizerConfig()) {
         using Key = husky::constants::Key;
         std::unique_ptr<ServerBase> server;
-        if (hint == "default_assign_map") {
-            std::unordered_map<Key, Val> store;
+        std::string consistency, optimizer, storage;
+        if (ParseOptimizerHint(hint, &consistency, &optimizer, &storage)) {
+            bool is_vector = storage == "vector";
+            if (optimizer == "adagrad") {
+                server = OptimizerServerFactory<Val, AdaGradRule<Val>>(id, consistency, is_vector, num_workers, staleness, server_id, optimizer_config);
+            } else if (optimizer == "adam") {
+                server = OptimizerServerFactory<Val, AdamRule<Val>>(id, consistency, is_vector, num_workers, staleness, server_id, optimizer_config);
+            } else {
+                server = OptimizerServerFactory<Val, FTRLRule<Val>>(id, consistency, is_vector, num_workers, staleness, server_id, optimizer_config);
+            }
+        } else if (hint == "default_assign_map") {
+            FlatMap<Val> store;
             server.reset(new DefaultUpdateServer<Val,
-                std::unordered_map<Key, Val>>(id, server_id, std::move(store), false, true));  // unordered_map, assign
+                FlatMap<Val>>(id, server_id, std::move(store), false, true));  // flat_map, assign
         } else if (hint == "default_add_map") {
-            std::unordered_map<Key, Val> store;
+            FlatMap<Val> store;
             server.reset(new DefaultUpdateServer<Val,
-                std::unordered_map<Key, Val>>(id, server_id, std::move(store), false, true));  // unordered_map, assign
+                FlatMap<Val>>(id, server_id, std::move(store), false, true));  // flat_map, assign
         } else if (hint == "bsp_add_map") {
-            std::unordered_map<Key, Val> store;
+            FlatMap<Val> store;
+            server.reset(new BSPServer<Val, 
+                FlatMap<Val>>(server_id, num_workers, std::move(store), false, false));  // flat_map, bsp
+        } else if (hint == "bsp_add_map_shared") {
+            FlatMap<Val> store;
             server.reset(new BSPServer<Val, 
-                std::unordered_map<Key, Val>>(server_id, num_workers, std::move(store), false, false));  // unordered_map, bsp
+                FlatMap<Val>>(server_id, num_workers, std::move(store), false, false, true, true));  // flat_map, bsp, shared results
         } else if (hint == "ssp_add_map") {
-            std::unordered_map<Key, Val> store;
+            FlatMap<Val> store;
             server.reset(new SSPServer<Val, 
-                std::unordered_map<Key, Val>>(server_id, num_workers, std::move(store), false, staleness));  // unordered_map, ssp
+                FlatMap<Val>>(server_id, num_workers, std::move(store), false, staleness));  // flat_map, ssp
         } else if (hint == "default_assign_vector") {
             assert(RangeManager::Get().GetMaxKey(id) != std::numeric_limits<Key>::max());
             std::vector<Val> store;
@@ -83,6 +125,12 @@ class KVStore {
             store.resize(RangeManager::Get().GetServerSize(id, server_id));
             server.reset(new BSPServer<Val, 
                 std::vector<Val>>(server_id, num_workers, std::move(store), true, false));  // vector, bsp
+        } else if (hint == "bsp_add_vector_shared") {
+            assert(RangeManager::Get().GetMaxKey(id) != std::numeric_limits<Key>::max());
+            std::vector<Val> store;
+            store.resize(RangeManager::Get().GetServerSize(id, server_id));
+            server.reset(new 
+                BSPServer<Val, std::vector<Val>>(server_id, num_workers, std::move(store), true, false, true, true));  // vector, bsp, shared results
         } else if (hint == "ssp_add_vector") {
             assert(RangeManager::Get().GetMaxKey(id) != std::numeric_limits<Key>::max());
             std::vector<Val> store;
@@ -101,20 +149,33 @@ class KVStore {
      *
      * @param max_key max key of hte kvstore
      * @param chunk_size the chunk_size
+     * @param optimizer_config the hyper-parameters for the optimizer hints
      * @return kvstore id created
      */
     template <typename Val>
     int CreateKVStore(const std::string& hint, int num_workers, int staleness,
             husky::constants::Key max_key = std::numeric_limits<husky::constants::Key>::max(),
-            int chunk_size = RangeManager::GetDefaultChunkSize()) {
+            int chunk_size = RangeManager::GetDefaultChunkSize(),
+            const ServerOptimizerConfig& optimizer_config = ServerOptimizerConfig()) {
         assert(is_started_);
         // set the default max key and chunk size
         RangeManager::Get().SetMaxKeyAndChunkSize(kv_id, max_key, chunk_size);  
-        for (int i = 0; i < kvservers.size(); ++ i) {
-            assert(i < server_ids.size());
-            int server_id = server_ids[i];
-            std::unique_ptr<ServerBase> server = ServerFactory<Val>(kv_id, hint, num_workers, staleness, server_id);
-            kvservers[i]->CreateKVManager<Val>(kv_id, std::move(server));
+        for (auto* kvserver : kvservers) {
+            for (int server_id : kvserver->GetServerIds()) {
+                std::unique_ptr<ServerBase> server = ServerFactory<Val>(kv_id, hint, num_workers, staleness, server_id, optimizer_config);
+                auto* direct = dynamic_cast<DirectAccess<Val>*>(server.get());
+                if (server->AcceptSubscribe()) {  // the same type of server in all the processes
+                    for (auto* kvworker : kvworkers) {
+                        kvworker->AllowSubscribe(kv_id);
+                    }
+                }
+                kvserver->CreateKVManager<Val>(kv_id, server_id, std::move(server));
+                if (direct) {  // the kvworkers of this process access it without messages
+                    for (auto* kvworker : kvworkers) {
+                        kvworker->AddDirectServer(kv_id, server_id, direct);
+                    }
+                }
+            }
         }
         for (auto* kvworker : kvworkers) {
             kvworker->AddProcessFunc<Val>(kv_id);
@@ -132,18 +193,81 @@ class KVStore {
         return kv_id++;
     }
     template<typename Val>
-    void SetupKVStore(int id, const std::string& hint, int num_workers, int staleness) {
-        for (int i = 0; i < kvservers.size(); ++ i) {
-            assert(i < server_ids.size());
-            int server_id = server_ids[i];
-            std::unique_ptr<ServerBase> server = ServerFactory<Val>(id, hint, num_workers, staleness, server_id);
-            kvservers[i]->CreateKVManager<Val>(id, std::move(server));
+    void SetupKVStore(int id, const std::string& hint, int num_workers, int staleness,
+            const ServerOptimizerConfig& optimizer_config = ServerOptimizerConfig()) {
+        for (auto* kvserver : kvservers) {
+            for (int server_id : kvserver->GetServerIds()) {
+                std::unique_ptr<ServerBase> server = ServerFactory<Val>(id, hint, num_workers, staleness, server_id, optimizer_config);
+                auto* direct = dynamic_cast<DirectAccess<Val>*>(server.get());
+                if (server->AcceptSubscribe()) {  // the same type of server in all the processes
+                    for (auto* kvworker : kvworkers) {
+                        kvworker->AllowSubscribe(id);
+                    }
+                }
+                kvserver->CreateKVManager<Val>(id, server_id, std::move(server));
+                if (direct) {  // the kvworkers of this process access it without messages
+                    for (auto* kvworker : kvworkers) {
+                        kvworker->AddDirectServer(id, server_id, direct);
+                    }
+                }
+            }
         }
         for (auto* kvworker : kvworkers) {
             kvworker->AddProcessFunc<Val>(id);
         }
     }
 
+    /*
+     * \brief set the wire encoding of the keys for kv_id in the kvworkers of this process
+     *
+     * The servers follow the encoding of each request, so only the sending side needs to be set.
+     * Should be called before the kvstore is used
+     */
+    void SetKeyCodec(int id, KeyCodec codec) {
+        for (auto* kvworker : kvworkers) {
+            kvworker->SetKeyCodec(id, codec);
+        }
+    }
+
+    /*
+     * \brief set the lossy compression of Push for kv_id in the kvworkers of this process
+     *
+     * Should be called before the kvstore is used
+     */
+    void SetPushCompression(int id, const PushCompression& compression) {
+        for (auto* kvworker : kvworkers) {
+            kvworker->SetPushCompression(id, compression);
+        }
+    }
+
+    /*
+     * \brief return the PullCombiner of kv_id, shared by the kvworkers of this process
+     *
+     * A batch is sent as soon as max_batch threads have joined it, i.e. the local threads of the task
+     */
+    template <typename Val>
+    PullCombiner<Val>* GetPullCombiner(int id, size_t max_batch) {
+        std::lock_guard<std::mutex> lk(pull_combiners_mu_);
+        auto& combiner = pull_combiners_[id];
+        if (!combiner)
+            combiner.reset(new PullCombiner<Val>(id, max_batch));
+        auto* pull_combiner = static_cast<PullCombiner<Val>*>(combiner.get());
+        pull_combiner->SetMaxBatch(max_batch);  // a later task may run with another number of threads
+        return pull_combiner;
+    }
+
+    /*
+     * \brief return the PushCombiner of kv_id, shared by the kvworkers of this process
+     */
+    template <typename Val>
+    PushCombiner<Val>* GetPushCombiner(int id) {
+        std::lock_guard<std::mutex> lk(push_combiners_mu_);
+        auto& combiner = push_combiners_[id];
+        if (!combiner)
+            combiner.reset(new PushCombiner<Val>(id));
+        return static_cast<PushCombiner<Val>*>(combiner.get());
+    }
+
     /*
      * \brief function to return kvworker
      */
@@ -152,9 +276,70 @@ class KVStore {
         return kvworkers[i];
     }
 
+    /*
+     * \brief the mailbox of kvworker i, and the mailbox thread id of the kvworker of the worker global_id
+     *
+     * For the messages among the workers on their own channel, see Collective
+     */
+    husky::LocalMailbox* get_kvworker_mailbox(int i) {
+        assert(i >= 0 && i < kvworker_mailboxes.size());
+        return kvworker_mailboxes[i].get();
+    }
+    int get_kvworker_tid(int global_id) const {
+        assert(global_id >= 0 && global_id < num_workers_);
+        return num_workers_ + global_id;
+    }
+
    private:
     KVStore() = default;
 
+    /*
+     * Split the optimizer hint "<consistency>_<optimizer>_<storage>", return false if hint is not an optimizer hint
+     */
+    static bool ParseOptimizerHint(const std::string& hint, std::string* consistency, std::string* optimizer, std::string* storage) {
+        size_t first = hint.find('_');
+        size_t last = hint.rfind('_');
+        if (first == std::string::npos || first == last)
+            return false;
+        *consistency = hint.substr(0, first);
+        *optimizer = hint.substr(first + 1, last - first - 1);
+        *storage = hint.substr(last + 1);
+        return (*consistency == "default" || *consistency == "bsp" || *consistency == "ssp")
+            && (*optimizer == "adagrad" || *optimizer == "adam" || *optimizer == "ftrl")
+            && (*storage == "map" || *storage == "vector");
+    }
+
+    template <typename Val, typename RuleT>
+    std::unique_ptr<ServerBase> OptimizerServerFactory(int id, const std::string& consistency, bool is_vector,
+            int num_workers, int staleness, int server_id, const ServerOptimizerConfig& optimizer_config) {
+        using Entry = typename RuleT::Entry;
+        if (is_vector) {
+            assert(RangeManager::Get().GetMaxKey(id) != std::numeric_limits<husky::constants::Key>::max());
+            std::vector<Entry> entries(RangeManager::Get().GetServerSize(id, server_id));
+            OptimizerStorage<Val, RuleT, std::vector<Entry>> store(std::move(entries), optimizer_config);
+            return MakeAddServer<Val>(id, consistency, true, num_workers, staleness, server_id, std::move(store));
+        } else {
+            OptimizerStorage<Val, RuleT, FlatMap<Entry>> store(FlatMap<Entry>(), optimizer_config);
+            return MakeAddServer<Val>(id, consistency, false, num_workers, staleness, server_id, std::move(store));
+        }
+    }
+
+    template <typename Val, typename StorageT>
+    std::unique_ptr<ServerBase> MakeAddServer(int id, const std::string& consistency, bool is_vector,
+            int num_workers, int staleness, int server_id, StorageT&& store) {
+        std::unique_ptr<ServerBase> server;
+        if (consistency == "default") {
+            server.reset(new DefaultUpdateServer<Val, StorageT>(id, server_id, std::move(store), is_vector, false));
+        } else if (consistency == "bsp") {
+            store.SetRoundUpdates(true);  // one step per round, see OptimizerStorage
+            server.reset(new BSPServer<Val, StorageT>(server_id, num_workers, std::move(store), is_vector, false));
+        } else {
+            store.SetRoundUpdates(true);
+            server.reset(new SSPServer<Val, StorageT>(server_id, num_workers, std::move(store), is_vector, staleness));
+        }
+        return server;
+    }
+
     // kv_id counter
     int kv_id = 0;
     // mailboxes for kvworker
@@ -163,9 +348,15 @@ class KVStore {
     // mailbox for kvserver
     std::vector<std::unique_ptr<husky::LocalMailbox>> kvserver_mailboxes;
     std::vector<KVManager*> kvservers;
-    std::vector<int> server_ids;
+    // pull combiners
+    std::unordered_map<int, std::unique_ptr<PullCombinerBase>> pull_combiners_;  // {kv_id, combiner}
+    std::mutex pull_combiners_mu_;
+    // push combiners
+    std::unordered_map<int, std::unique_ptr<PushCombinerBase>> push_combiners_;  // {kv_id, combiner}
+    std::mutex push_combiners_mu_;
 
     int num_processes_ = -1;
+    int num_workers_ = -1;
 
     bool is_started_ = false;
 };
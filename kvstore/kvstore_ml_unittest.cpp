@@ -186,5 +186,318 @@ TEST_F(TestKVStore, PushPullChunks) {
     kvstore::KVStore::Get().Stop();
 }
 
+TEST_F(TestKVStore, PushPullSharedMailbox) {
+    // Start KVStore with 3 servers on each process sharing one mailbox
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context, 3, true);
+    EXPECT_EQ(kvstore::RangeManager::Get().GetNumServers(), 3);
+
+    auto* kvworker = kvstore::KVStore::Get().get_kvworker(0);
+    int kv1 = kvstore::KVStore::Get().CreateKVStore<float>("default_assign_map", -1, -1, 10, 2);
+    int kv2 = kvstore::KVStore::Get().CreateKVStore<float>("default_assign_vector", -1, -1, 10, 2);
+
+    for (auto kv : {kv1, kv2}) {
+        for (auto send_all : {true, false}) {
+            for (auto local_zero_copy : {true, false}) {
+                TestPushPull(kv, kvworker, {1,2},{0.1,0.2}, send_all, local_zero_copy);
+                TestPushPull(kv, kvworker, {0,4,8},{0.1,0.2,0.3}, send_all, local_zero_copy);
+                TestPushPullChunks(kv, kvworker, {0,1}, 2, 0.1, send_all, local_zero_copy);
+                TestPushPullChunks(kv, kvworker, {1,2,4}, 2, 0.4, send_all, local_zero_copy);
+            }
+        }
+    }
+
+    // Stop KVStore
+    kvstore::KVStore::Get().Stop();
+}
+
+TEST_F(TestKVStore, PushPullOptimizer) {
+    // Start KVStore with 3 servers on each process
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context, 3);
+
+    auto* kvworker = kvstore::KVStore::Get().get_kvworker(0);
+    kvstore::ServerOptimizerConfig config;
+    config.alpha = 0.5;
+    int kv1 = kvstore::KVStore::Get().CreateKVStore<float>("default_adagrad_map", -1, -1, 10, 2, config);
+    int kv2 = kvstore::KVStore::Get().CreateKVStore<float>("default_adagrad_vector", -1, -1, 10, 2, config);
+
+    for (auto kv : {kv1, kv2}) {
+        // push raw gradients, the first step of AdaGrad moves the weight by alpha * -sign(grad)
+        std::vector<husky::constants::Key> keys{1, 5, 9};
+        int ts = kvworker->Push(kv, keys, std::vector<float>{2.0, -1.0, 0.1});
+        kvworker->Wait(kv, ts);
+        std::vector<float> res;
+        ts = kvworker->Pull(kv, keys, &res);
+        kvworker->Wait(kv, ts);
+        ASSERT_EQ(res.size(), 3);
+        EXPECT_NEAR(res[0], -0.5, 1e-5);
+        EXPECT_NEAR(res[1], 0.5, 1e-5);
+        EXPECT_NEAR(res[2], -0.5, 1e-5);
+    }
+
+    // Stop KVStore
+    kvstore::KVStore::Get().Stop();
+}
+
+TEST_F(TestKVStore, PushPullOptimizerBSP) {
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context);
+
+    auto* kvworker0 = kvstore::KVStore::Get().get_kvworker(0);
+    auto* kvworker1 = kvstore::KVStore::Get().get_kvworker(1);
+    kvstore::ServerOptimizerConfig config;
+    config.alpha = 0.5;
+    int kv = kvstore::KVStore::Get().CreateKVStore<float>("bsp_adam_vector", 2, -1, 10, 2, config);
+
+    std::vector<husky::constants::Key> keys{1, 5};
+    std::vector<float> res;
+    for (int iter = 0; iter < 2; ++ iter) {
+        kvworker0->Wait(kv, kvworker0->Pull(kv, keys, &res));
+        kvworker1->Wait(kv, kvworker1->Pull(kv, keys, &res));
+        kvworker0->Wait(kv, kvworker0->Push(kv, keys, std::vector<float>{0.3, -1.0}));
+        kvworker1->Wait(kv, kvworker1->Push(kv, keys, std::vector<float>{0.2, -1.0}));
+    }
+    kvworker0->Wait(kv, kvworker0->Pull(kv, keys, &res));
+    // Adam moves the weight by about alpha * sign(grad) per step, one step per round
+    ASSERT_EQ(res.size(), 2);
+    EXPECT_NEAR(res[0], -1.0, 1e-4);
+    EXPECT_NEAR(res[1], 1.0, 1e-4);
+
+    kvstore::KVStore::Get().Stop();
+}
+
+TEST_F(TestKVStore, PushPullKeyCodec) {
+    // Start KVStore with 3 servers on each process
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context, 3);
+
+    auto* kvworker = kvstore::KVStore::Get().get_kvworker(0);
+    int kv1 = kvstore::KVStore::Get().CreateKVStore<float>("default_assign_map", -1, -1, 9, 2);
+    int kv2 = kvstore::KVStore::Get().CreateKVStore<float>("default_assign_vector", -1, -1, 9, 2);
+    kvstore::KVStore::Get().SetKeyCodec(kv1, kvstore::KeyCodec::kDeltaVarint);
+    kvstore::KVStore::Get().SetKeyCodec(kv2, kvstore::KeyCodec::kDeltaVarintRuns);
+
+    for (auto kv : {kv1, kv2}) {
+        for (auto send_all : {true, false}) {
+            for (auto local_zero_copy : {true, false}) {
+                TestPushPull(kv, kvworker, {1,2},{0.1,0.2}, send_all, local_zero_copy);
+                TestPushPull(kv, kvworker, {0,4,5,8},{0.1,0.2,0.3,0.4}, send_all, local_zero_copy);
+            }
+        }
+    }
+
+    // Stop KVStore
+    kvstore::KVStore::Get().Stop();
+}
+
+TEST_F(TestKVStore, PushCompression) {
+    // Start KVStore with 3 servers on each process
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context, 3);
+
+    auto* kvworker = kvstore::KVStore::Get().get_kvworker(0);
+    int kv = kvstore::KVStore::Get().CreateKVStore<float>("default_add_vector", -1, -1, 9, 2);
+    kvstore::PushCompression compression;
+    compression.codec = kvstore::ValCodec::kFP16;
+    kvstore::KVStore::Get().SetPushCompression(kv, compression);
+
+    // only the remote Push is compressed, so disable local_zero_copy
+    std::vector<husky::constants::Key> keys{0, 4, 8};
+    int ts = kvworker->Push(kv, keys, std::vector<float>{0.1, 0.2, 0.3}, true, false);
+    kvworker->Wait(kv, ts);
+    std::vector<float> res;
+    ts = kvworker->Pull(kv, keys, &res, true, false);
+    kvworker->Wait(kv, ts);
+    ASSERT_EQ(res.size(), 3);
+    EXPECT_NEAR(res[0], 0.1, 1e-3);
+    EXPECT_NEAR(res[1], 0.2, 1e-3);
+    EXPECT_NEAR(res[2], 0.3, 1e-3);
+    EXPECT_EQ(kvworker->GetPushCompressionStats(kv).raw_bytes, 3 * (sizeof(husky::constants::Key) + sizeof(float)));
+
+    // Stop KVStore
+    kvstore::KVStore::Get().Stop();
+}
+
+TEST_F(TestKVStore, PullChunksIfModified) {
+    // Start KVStore with 3 servers on each process
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context, 3);
+
+    auto* kvworker = kvstore::KVStore::Get().get_kvworker(0);
+    int kv = kvstore::KVStore::Get().CreateKVStore<float>("default_assign_vector", -1, -1, 10, 2);
+    std::vector<size_t> chunk_ids{0, 1, 2, 3, 4};
+    std::vector<std::vector<float>> chunks(5, std::vector<float>(2, 0.5));
+    std::vector<std::vector<float>*> chunk_ptrs;
+    for (auto& chunk : chunks)
+        chunk_ptrs.push_back(&chunk);
+    int ts = kvworker->PushChunks(kv, chunk_ids, chunk_ptrs);
+    kvworker->Wait(kv, ts);
+
+    // nothing is held, so all the chunks are shipped
+    std::vector<std::vector<float>> res(5);
+    std::vector<std::vector<float>*> res_ptrs;
+    for (auto& chunk : res)
+        res_ptrs.push_back(&chunk);
+    std::vector<uint32_t> versions(5, kvstore::ChunkVersions::kNoVersion);
+    ts = kvworker->PullChunksIfModified(kv, chunk_ids, res_ptrs, &versions);
+    kvworker->Wait(kv, ts);
+    for (int i = 0; i < 5; ++ i) {
+        EXPECT_EQ(res[i], chunks[i]);
+        EXPECT_NE(versions[i], kvstore::ChunkVersions::kNoVersion);
+    }
+
+    // only chunk 3 is modified
+    std::vector<std::vector<float>> update{{1.0, 2.0}};
+    ts = kvworker->PushChunks(kv, {3}, std::vector<std::vector<float>*>{&update[0]});
+    kvworker->Wait(kv, ts);
+    for (auto& chunk : res)
+        chunk.clear();
+    std::vector<uint32_t> old_versions = versions;
+    ts = kvworker->PullChunksIfModified(kv, chunk_ids, res_ptrs, &versions);
+    kvworker->Wait(kv, ts);
+    for (int i = 0; i < 5; ++ i) {
+        if (i == 3) {
+            EXPECT_EQ(res[i], update[0]);
+            EXPECT_NE(versions[i], old_versions[i]);
+        } else {
+            EXPECT_TRUE(res[i].empty());  // not modified, untouched
+            EXPECT_EQ(versions[i], old_versions[i]);
+        }
+    }
+
+    // Stop KVStore
+    kvstore::KVStore::Get().Stop();
+}
+
+TEST_F(TestKVStore, ManyRequests) {
+    // Start KVStore with 3 servers on each process
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context, 3);
+
+    auto* kvworker = kvstore::KVStore::Get().get_kvworker(0);
+    int kv = kvstore::KVStore::Get().CreateKVStore<float>("default_add_vector", -1, -1, 9, 2);
+    // more requests in flight than the slots of the request tracker, the slots are recycled
+    std::vector<husky::constants::Key> keys{0, 4, 8};
+    std::vector<int> tss;
+    for (int i = 0; i < 3000; ++ i)
+        tss.push_back(kvworker->Push(kv, keys, std::vector<float>{1.0, 1.0, 1.0}));
+    for (auto ts : tss)
+        kvworker->Wait(kv, ts);
+    std::vector<float> res;
+    kvworker->Wait(kv, kvworker->Pull(kv, keys, &res));
+    EXPECT_EQ(res, std::vector<float>(3, 3000.0));
+
+    // Stop KVStore
+    kvstore::KVStore::Get().Stop();
+}
+
+TEST_F(TestKVStore, PullAsync) {
+    // Start KVStore with 3 servers on each process
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context, 3);
+
+    auto* kvworker = kvstore::KVStore::Get().get_kvworker(0);
+    int kv1 = kvstore::KVStore::Get().CreateKVStore<float>("default_assign_vector", -1, -1, 9, 2);
+    int kv2 = kvstore::KVStore::Get().CreateKVStore<float>("default_assign_map", -1, -1, 9, 2);
+    std::vector<husky::constants::Key> keys{0, 1, 4, 5, 8};
+    std::vector<float> vals{0.5, 1.5, 4.5, 5.5, 8.5};
+    kvworker->Wait(kv1, kvworker->Push(kv1, keys, vals));
+    kvworker->Wait(kv2, kvworker->Push(kv2, keys, vals));
+    std::vector<size_t> chunk_ids{0, 2, 4};
+    std::vector<std::vector<float>> chunks{{0.0, 1.0}, {4.0, 5.0}, {8.0}};
+    std::vector<std::vector<float>*> chunk_ptrs{&chunks[0], &chunks[1], &chunks[2]};
+    kvworker->Wait(kv1, kvworker->PushChunks(kv1, chunk_ids, chunk_ptrs));
+
+    // overlap the pulls of the two kvstores
+    std::vector<float> res1, res2;
+    std::vector<std::vector<float>> res_chunks(3);
+    std::vector<std::vector<float>*> res_ptrs{&res_chunks[0], &res_chunks[1], &res_chunks[2]};
+    std::vector<kvstore::KVFuture> futures{kvworker->PullAsync(kv1, keys, &res1), kvworker->PullAsync(kv2, keys, &res2)};
+    kvstore::KVFuture all = kvstore::KVFuture::WhenAll(futures);
+    std::atomic<int> num_thens(0);
+    all.Then([&num_thens]() { num_thens += 1; });
+    all.Wait();
+    EXPECT_TRUE(futures[0].Ready());
+    EXPECT_TRUE(futures[1].Ready());
+    EXPECT_EQ(res1, std::vector<float>({0.0, 1.0, 4.0, 5.0, 8.0}));
+    EXPECT_EQ(res2, vals);
+    all.Then([&num_thens]() { num_thens += 1; });  // already completed, runs directly
+    EXPECT_EQ(num_thens, 2);
+
+    kvworker->PullChunksAsync(kv1, chunk_ids, res_ptrs).Wait();
+    EXPECT_EQ(res_chunks, chunks);
+
+    // nothing to pull
+    std::vector<float> empty;
+    EXPECT_TRUE(kvworker->PullAsync(kv1, {}, &empty).Ready());
+
+    // Stop KVStore
+    kvstore::KVStore::Get().Stop();
+}
+
+TEST_F(TestKVStore, Batch) {
+    // Start KVStore with 3 servers on each process
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context, 3);
+
+    auto* kvworker = kvstore::KVStore::Get().get_kvworker(0);
+    int kv1 = kvstore::KVStore::Get().CreateKVStore<float>("default_add_vector", -1, -1, 9, 2);
+    int kv2 = kvstore::KVStore::Get().CreateKVStore<float>("default_assign_map", -1, -1, 9, 2);
+    std::vector<husky::constants::Key> keys{0, 1, 4, 8};
+    // through the mailbox, one message per server, handled in order
+    std::vector<float> res1, res2;
+    auto batch = kvworker->NewBatch();
+    batch.Push(kv1, keys, std::vector<float>{1.0, 2.0, 3.0, 4.0}, true, false)
+        .Push(kv2, keys, std::vector<float>{0.5, 1.5, 2.5, 3.5}, true, false)
+        .Push(kv1, keys, std::vector<float>{1.0, 1.0, 1.0, 1.0}, true, false)
+        .Pull(kv1, keys, &res1, true, false)
+        .Pull(kv2, {1, 8}, &res2, true, false);
+    kvworker->Wait(kv1, batch.Send());
+    EXPECT_EQ(res1, std::vector<float>({2.0, 3.0, 4.0, 5.0}));
+    EXPECT_EQ(res2, std::vector<float>({1.5, 3.5}));
+
+    // the batch can be reused, with the local servers accessed directly
+    res1.clear();
+    res2.clear();
+    batch.Push(kv1, {4}, std::vector<float>{1.0}).Pull(kv1, keys, &res1).Pull(kv2, keys, &res2);
+    kvworker->Wait(kv2, batch.Send());
+    EXPECT_EQ(res1, std::vector<float>({2.0, 3.0, 5.0, 5.0}));
+    EXPECT_EQ(res2, std::vector<float>({0.5, 1.5, 2.5, 3.5}));
+
+    // Stop KVStore
+    kvstore::KVStore::Get().Stop();
+}
+
+TEST_F(TestKVStore, DirectAccess) {
+    // Start KVStore with 3 servers on each process, all of them are local
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context, 3);
+
+    auto* kvworker = kvstore::KVStore::Get().get_kvworker(0);
+    int kv = kvstore::KVStore::Get().CreateKVStore<float>("default_add_vector", -1, -1, 9, 2);
+    std::vector<husky::constants::Key> keys{0, 4, 8};
+    // local_zero_copy: the local servers are updated directly
+    int ts = kvworker->Push(kv, keys, std::vector<float>{1.0, 2.0, 3.0});
+    kvworker->Wait(kv, ts);  // nothing to wait for
+    // through the mailbox, the direct updates are seen
+    std::vector<float> res;
+    kvworker->Wait(kv, kvworker->Pull(kv, keys, &res, true, false));
+    EXPECT_EQ(res, std::vector<float>({1.0, 2.0, 3.0}));
+    kvworker->Wait(kv, kvworker->Push(kv, keys, std::vector<float>{1.0, 1.0, 1.0}, true, false));
+    res.clear();
+    bool called = false;
+    kvworker->Wait(kv, kvworker->Pull(kv, keys, &res, true, true, true, [&called]() { called = true; }));
+    EXPECT_EQ(res, std::vector<float>({2.0, 3.0, 4.0}));
+    EXPECT_TRUE(called);
+
+    // chunks
+    std::vector<size_t> chunk_ids{0, 3, 4};
+    std::vector<std::vector<float>> chunks{{1.0, 1.0}, {2.0, 2.0}, {3.0}};
+    std::vector<std::vector<float>*> chunk_ptrs{&chunks[0], &chunks[1], &chunks[2]};
+    kvworker->Wait(kv, kvworker->PushChunks(kv, chunk_ids, chunk_ptrs));
+    std::vector<std::vector<float>> res_chunks(3);
+    std::vector<std::vector<float>*> res_ptrs{&res_chunks[0], &res_chunks[1], &res_chunks[2]};
+    kvworker->Wait(kv, kvworker->PullChunks(kv, chunk_ids, res_ptrs, true, false));
+    EXPECT_EQ(res_chunks, std::vector<std::vector<float>>({{3.0, 1.0}, {2.0, 2.0}, {7.0}}));
+    for (auto& chunk : res_chunks)
+        chunk.clear();
+    kvworker->Wait(kv, kvworker->PullChunks(kv, chunk_ids, res_ptrs));
+    EXPECT_EQ(res_chunks, std::vector<std::vector<float>>({{3.0, 1.0}, {2.0, 2.0}, {7.0}}));
+
+    // Stop KVStore
+    kvstore::KVStore::Get().Stop();
+}
+
 }  // namespace
 }  // namespace husky
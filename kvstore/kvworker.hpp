@@ -2,15 +2,28 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <functional>
 #include <limits>
+#include <memory>
+#include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "chunk_versions.hpp"
+#include "key_codec.hpp"
+#include "kvfuture.hpp"
 #include "kvpairs.hpp"
+#include "metrics.hpp"
+#include "val_codec.hpp"
 #include "workercustomer.hpp"
 #include "range_manager.hpp"
+#include "sarray_io.hpp"
+#include "handles/direct_access.hpp"
 
 #include "core/info.hpp"
+#include "core/tracer.hpp"
 #include "husky/base/serialization.hpp"
 #include "husky/core/mailbox.hpp"
 
@@ -34,6 +47,23 @@ struct RecvKVPairsWithMinClock : public RecvKVPairsBase {
     std::vector<std::pair<KVPairs<Val>, int>> recv_kvs;  // (kvpairs, min_clock)
 };
 
+template <typename Val>
+struct RecvKVPairsWithVersions : public RecvKVPairsBase {
+    virtual ~RecvKVPairsWithVersions() {}
+    std::vector<std::tuple<KVPairs<Val>, std::vector<uint32_t>, int>> recv_kvs;  // (kvpairs, versions, min_clock)
+};
+
+/*
+ * The chunks pushed by a server to a subscriber (Eager SSP), see KVWorker::Subscribe
+ */
+template <typename Val>
+struct EagerChunks {
+    KVPairs<Val> kvs;                // keys: the modified chunk_ids, vals: their data
+    std::vector<uint32_t> versions;  // the versions of the modified chunks
+    std::vector<size_t> unmodified;  // the other subscribed chunks, unchanged since the last push
+    int min_clock;                   // the min_clock of the server
+};
+
 /*
  * cmd:
  * 0: Push/Pull
@@ -41,25 +71,123 @@ struct RecvKVPairsWithMinClock : public RecvKVPairsBase {
  * 2: local zero-copy Push/Pull
  * 3: local zero-copy PushChunks/PullChunks
  * 4: InitForConsistencyControl
+ * 5: Push/Pull with encoded keys and vals (see SetKeyCodec and SetPushCompression)
+ * 6: PullChunksIfModified
+ * 7: Subscribe, and the chunks pushed by the servers to the subscribers (ts: server_push_ts_)
  * 11: PullChunksWithMinClock
  * 13: PullChunksWithMinClock + local zero-copy
+ * 16: PullChunksIfModified with min clock
  * 100+k: consistency_control off
  *
  * consistency_control_off_magic_:100
  * with_min_clock_magic_: 10
  * local_zero_copy_magic_: 2
+ *
+ * Request format: kv_id, ts, server_id, cmd, push, src, data
+ * server_id is used to dispatch the request when several servers share one mailbox
+ *
+ * Batch format: batch_kv_id_, ts, server_id, n, then n (size, request), see KVWorker::Batch
  */
 class KVWorker {
    public:
     using Callback = std::function<void()>;
     template <typename Val>
     using SlicedKVs = std::vector<std::pair<bool, KVPairs<Val>>>;
+    using BatchRequests = std::vector<std::vector<husky::base::BinStream>>;  // the requests to each server
+
+    /*
+     * Batch: Push/Pull on several kv_ids, sent as one message per server under one ts
+     *
+     * The operations are sliced (and the direct servers accessed) when they are added,
+     * and each server handles them in the order they were added.
+     * Wait on the ts returned by Send with any of the kv_ids.
+     * A Batch holds at most one Pull of each kv_id.
+     */
+    class Batch {
+       public:
+        explicit Batch(KVWorker* kvworker) : kvworker_(kvworker) {}
+
+        template <typename Val>
+        Batch& Push(int kv_id, const std::vector<husky::constants::Key>& keys, const std::vector<Val>& vals,
+                    bool send_all = true, bool local_zero_copy = true, bool consistency_control = true) {
+            auto sliced = std::make_shared<SlicedKVs<Val>>();
+            KVPairs<Val> kvs;
+            kvs.keys = pslite::SArray<husky::constants::Key>(keys);
+            kvs.vals = pslite::SArray<Val>(vals);
+            kvworker_->Slice_(kvs, RangeManager::Get().GetServerKeyRanges(kv_id), sliced.get());
+            auto* direct = kvworker_->GetDirectServers_(kv_id, local_zero_copy);
+            kvworker_->UpdateDirect_(direct, sliced.get());
+            num_responses_ += NumRemote_(*sliced);
+            KVWorker* kvworker = kvworker_;
+            ops_.push_back([=](int ts, BatchRequests* requests) {
+                kvworker->Send_(kv_id, ts, true, *sliced, send_all, local_zero_copy, consistency_control, direct, requests);
+            });
+            return *this;
+        }
+
+        /*
+         * vals is resized to keys.size() and filled once the ts of the batch is waited
+         */
+        template <typename Val>
+        Batch& Pull(int kv_id, const std::vector<husky::constants::Key>& keys, std::vector<Val>* vals,
+                    bool send_all = true, bool local_zero_copy = true, bool consistency_control = true) {
+            assert(std::find(pull_kv_ids_.begin(), pull_kv_ids_.end(), kv_id) == pull_kv_ids_.end());
+            pslite::SArray<husky::constants::Key> sorted_keys(keys);
+            auto sliced = std::make_shared<SlicedKVs<Val>>();
+            KVPairs<Val> kvs;
+            kvs.keys = sorted_keys;
+            kvworker_->Slice_(kvs, RangeManager::Get().GetServerKeyRanges(kv_id), sliced.get());
+            vals->resize(keys.size());
+            auto* direct = kvworker_->GetDirectServers_(kv_id, local_zero_copy);
+            kvworker_->RetrieveDirect_(direct, sorted_keys, sliced.get(), vals->data());
+            int num_remote = NumRemote_(*sliced);
+            if (num_remote != 0)
+                pull_kv_ids_.push_back(kv_id);
+            num_responses_ += num_remote;
+            KVWorker* kvworker = kvworker_;
+            ops_.push_back([=](int ts, BatchRequests* requests) {
+                if (num_remote != 0)
+                    kvworker->AddCallback(kv_id, ts, kvworker->PullCallback_<Val>(kv_id, ts, sorted_keys, vals, nullptr));
+                kvworker->Send_(kv_id, ts, false, *sliced, send_all, local_zero_copy, consistency_control, direct, requests);
+            });
+            return *this;
+        }
+
+        /*
+         * Send the operations added so far, the batch is empty afterwards
+         *
+         * @return ts
+         */
+        int Send() {
+            int ts = kvworker_->customer_->NewRequest(batch_kv_id_, num_responses_);
+            if (!pull_kv_ids_.empty()) {
+                std::lock_guard<std::mutex> lk(kvworker_->mu_);
+                kvworker_->batch_kv_ids_[ts] = pull_kv_ids_;
+            }
+            BatchRequests requests(RangeManager::Get().GetNumServers());
+            for (auto& op : ops_)
+                op(ts, &requests);
+            for (size_t i = 0; i < requests.size(); ++ i)
+                kvworker_->SendBatch_(i, ts, requests[i]);
+            ops_.clear();
+            pull_kv_ids_.clear();
+            num_responses_ = 0;
+            return ts;
+        }
+
+       private:
+        KVWorker* kvworker_;
+        int num_responses_ = 0;
+        std::vector<int> pull_kv_ids_;
+        std::vector<std::function<void(int, BatchRequests*)>> ops_;
+    };
 
     KVWorker(const PSInfo& info, husky::LocalMailbox& mailbox)
         : customer_(new WorkerCustomer(mailbox, [this](int kv_id, int ts, husky::base::BinStream& bin,
                                                        bool runCallback) { Process(kv_id, ts, bin, runCallback); },
                                        info.channel_id)),
           info_(info) {
+        AddMetrics_(batch_kv_id_);
         customer_->Start();
     }
     ~KVWorker() { customer_->Stop(); }
@@ -79,8 +207,8 @@ class KVWorker {
         bool push = true;
         for (int i = 0; i < num_servers; ++ i) {
             husky::BinStream bin;
-            bin << kv_id << ts << cmd << push << src << num_workers;
-            customer_->send(info_.get_tid(i), bin);
+            bin << kv_id << ts << i << cmd << push << src << num_workers;
+            SendTo_(i, bin);
         }
         return ts;
     }
@@ -116,10 +244,13 @@ class KVWorker {
         kvs.vals = vals;
         SlicedKVs<Val> sliced;
         Slice_(kvs, RangeManager::Get().GetServerKeyRanges(kv_id), &sliced);
-        // 2. get ts
+        // 2. update the local servers directly
+        auto* direct = GetDirectServers_(kv_id, local_zero_copy);
+        UpdateDirect_(direct, &sliced);
+        // 3. get ts
         int ts = GetTimestamp_(kv_id, sliced);
-        // 3. send
-        Send_(kv_id, ts, true, sliced, send_all, local_zero_copy, consistency_control);
+        // 4. send
+        Send_(kv_id, ts, true, sliced, send_all, local_zero_copy, consistency_control, direct);
         return ts;
     }
 
@@ -149,6 +280,66 @@ class KVWorker {
         return Pull_<Val>(kv_id, keys, vals, send_all, local_zero_copy, consistency_control, cb);
     }
 
+    /*
+     * Start a Batch of Push/Pull on several kv_ids
+     */
+    Batch NewBatch() { return Batch(this); }
+
+    /*
+     * Pull returning a future, the reply of each server is written into vals on arrival
+     *
+     * vals is resized to keys.size() up front (one val per key) and must stay alive
+     * until the future completes. keys must be sorted, as in Pull.
+     * Several PullAsync can be overlapped with KVFuture::WhenAll.
+     */
+    template <typename Val>
+    KVFuture PullAsync(int kv_id, const std::vector<husky::constants::Key>& keys, std::vector<Val>* vals,
+                       bool send_all = true, bool local_zero_copy = true, bool consistency_control = true) {
+        pslite::SArray<husky::constants::Key> sorted_keys(keys);
+        KVPairs<Val> kvs;
+        kvs.keys = sorted_keys;
+        SlicedKVs<Val> sliced;
+        Slice_(kvs, RangeManager::Get().GetServerKeyRanges(kv_id), &sliced);
+        vals->resize(keys.size());
+        auto* direct = GetDirectServers_(kv_id, local_zero_copy);
+        RetrieveDirect_(direct, sorted_keys, &sliced, vals->data());
+        int ts = GetTimestamp_(kv_id, sliced);
+        KVFuture future = KVFuture::Make();
+        AddPullSink_(kv_id, ts, NumRemote_(sliced) == 0, future, [sorted_keys, vals](int cmd, husky::base::BinStream& bin) {
+            if (cmd == local_zero_copy_magic_) {  // local zero-copy, the reply is handed over by pointer
+                std::uintptr_t ptr;
+                bin >> ptr;
+                auto* p_recv = reinterpret_cast<KVPairs<Val>*>(ptr);
+                if (p_recv->keys.size() != 0) {
+                    size_t offset = std::lower_bound(sorted_keys.begin(), sorted_keys.end(), p_recv->keys.front()) - sorted_keys.begin();
+                    assert(offset + p_recv->vals.size() <= vals->size());
+                    memcpy(vals->data() + offset, p_recv->vals.data(), p_recv->vals.size() * sizeof(Val));
+                }
+                delete p_recv;
+                return;
+            }
+            husky::constants::Key first_key;
+            size_t num_keys;
+            if (cmd == encoded_cmd_) {
+                pslite::SArray<husky::constants::Key> recv_keys;
+                DecodeKeys(bin, &recv_keys);
+                num_keys = recv_keys.size();
+                first_key = num_keys ? recv_keys.front() : 0;
+            } else {  // only the first key is needed, read the keys in place
+                pslite::SArray<husky::constants::Key> recv_keys;
+                ViewSArray(bin, &recv_keys);
+                num_keys = recv_keys.size();
+                first_key = num_keys ? recv_keys.front() : 0;
+            }
+            if (num_keys == 0)
+                return;
+            size_t offset = std::lower_bound(sorted_keys.begin(), sorted_keys.end(), first_key) - sorted_keys.begin();
+            ScatterVals_(bin, vals->data() + offset, vals->size() - offset);
+        });
+        Send_(kv_id, ts, false, sliced, send_all, local_zero_copy, consistency_control, direct);
+        return future;
+    }
+
     /*
      * Push a list of chunk to server
      *
@@ -166,10 +357,13 @@ class KVWorker {
         assert(chunk_ids.size() == chunks.size());
         // 1. partition
         std::vector<size_t> pos = PartitionChunks_(kv_id, chunk_ids);
-        // 2. get ts
-        int ts = GetTimestampChunk_(kv_id, pos, send_all);
-        // 3. send
-        SendChunks_(kv_id, ts, true, chunk_ids, chunks, pos, send_all, local_zero_copy, false, consistency_control);
+        // 2. update the local servers directly
+        auto* direct = GetDirectServers_(kv_id, local_zero_copy);
+        UpdateChunksDirect_(direct, chunk_ids, chunks, pos);
+        // 3. get ts
+        int ts = GetTimestampChunk_(kv_id, pos, send_all, direct);
+        // 4. send
+        SendChunks_(kv_id, ts, true, chunk_ids, chunks, pos, send_all, local_zero_copy, false, consistency_control, direct);
         return ts;
     }
 
@@ -190,8 +384,17 @@ class KVWorker {
         assert(chunk_ids.size() == chunks.size());
         // 1. partition
         std::vector<size_t> pos = PartitionChunks_(kv_id, chunk_ids);
-        // 2. get ts
-        int ts = GetTimestampChunk_(kv_id, pos, send_all);
+        // 2. retrieve from the local servers directly
+        auto* direct = GetDirectServers_(kv_id, local_zero_copy);
+        RetrieveChunksDirect_(direct, chunk_ids, chunks, pos);
+        // 3. get ts
+        int ts = GetTimestampChunk_(kv_id, pos, send_all, direct);
+        if (NumRemoteChunks_(pos, direct) == 0) {  // all done
+            SendChunks_(kv_id, ts, false, chunk_ids, std::vector<std::vector<Val>*>(), pos, send_all, local_zero_copy, false, consistency_control, direct);
+            if (cb)
+                cb();
+            return ts;
+        }
         AddCallback(kv_id, ts, [this, kv_id, ts, chunk_ids, chunks, cb]() {
             mu_.lock();
             auto& kvs = static_cast<RecvKVPairs<Val>*>(recv_kvs_[{kv_id, ts}])->recv_kvs;
@@ -199,11 +402,9 @@ class KVWorker {
 
             size_t chunk_size = RangeManager::Get().GetChunkSize(kv_id);
             size_t chunk_num = RangeManager::Get().GetChunkNum(kv_id);
-            std::sort(kvs.begin(), kvs.end(),
-                      [](const KVPairs<Val>& a, const KVPairs<Val>& b) { return a.keys.front() < b.keys.front(); });
-
-            int idx = 0;
             for (const auto& s : kvs) {
+                // the chunks of one server are a consecutive run of chunk_ids
+                int idx = std::lower_bound(chunk_ids.begin(), chunk_ids.end(), s.keys.front()) - chunk_ids.begin();
                 int start = 0;
                 for (int i = 0; i < s.keys.size(); ++ i) {
                     if (s.keys[i] == chunk_num-1) {
@@ -225,10 +426,55 @@ class KVWorker {
             if (cb)
                 cb();
         });
-        SendChunks_(kv_id, ts, false, chunk_ids, std::vector<std::vector<Val>*>(), pos, send_all, local_zero_copy, false, consistency_control);
+        SendChunks_(kv_id, ts, false, chunk_ids, std::vector<std::vector<Val>*>(), pos, send_all, local_zero_copy, false, consistency_control, direct);
         return ts;
     }
 
+    /*
+     * PullChunks returning a future, the chunks of each server are written into chunks on arrival
+     *
+     * The chunks are resized up front and must stay alive until the future completes.
+     * chunk_ids must be sorted, as in PullChunks.
+     */
+    template <typename Val>
+    KVFuture PullChunksAsync(int kv_id, const std::vector<size_t>& chunk_ids, const std::vector<std::vector<Val>*>& chunks,
+                             bool send_all = true, bool local_zero_copy = true, bool consistency_control = true) {
+        assert(chunk_ids.size() == chunks.size());
+        std::vector<size_t> pos = PartitionChunks_(kv_id, chunk_ids);
+        size_t chunk_num = RangeManager::Get().GetChunkNum(kv_id);
+        for (size_t i = 0; i < chunk_ids.size(); ++ i)
+            chunks[i]->resize(chunk_ids[i] == chunk_num - 1 ? RangeManager::Get().GetLastChunkSize(kv_id)
+                                                            : RangeManager::Get().GetChunkSize(kv_id));
+        auto* direct = GetDirectServers_(kv_id, local_zero_copy);
+        RetrieveChunksDirect_(direct, chunk_ids, chunks, pos);
+        int ts = GetTimestampChunk_(kv_id, pos, send_all, direct);
+        KVFuture future = KVFuture::Make();
+        auto ids = std::make_shared<std::vector<size_t>>(chunk_ids);
+        auto dsts = std::make_shared<std::vector<std::vector<Val>*>>(chunks);
+        AddPullSink_(kv_id, ts, NumRemoteChunks_(pos, direct) == 0, future, [ids, dsts](int cmd, husky::base::BinStream& bin) {
+            pslite::SArray<husky::constants::Key> recv_keys;
+            pslite::SArray<Val> recv_vals;
+            ViewSArray(bin, &recv_keys);
+            ViewSArray(bin, &recv_vals);
+            size_t num_keys = recv_keys.size();
+            const husky::constants::Key* p_keys = recv_keys.data();
+            size_t num_vals = recv_vals.size();
+            const Val* p_vals = recv_vals.data();
+            // the chunks of one server are a consecutive run of chunk_ids
+            size_t idx = std::lower_bound(ids->begin(), ids->end(), num_keys ? p_keys[0] : 0) - ids->begin();
+            for (size_t i = 0; i < num_keys; ++ i, ++ idx) {
+                assert((*ids)[idx] == p_keys[i]);
+                std::vector<Val>* chunk = (*dsts)[idx];
+                assert(chunk->size() <= num_vals);
+                memcpy(chunk->data(), p_vals, chunk->size() * sizeof(Val));
+                p_vals += chunk->size();
+                num_vals -= chunk->size();
+            }
+        });
+        SendChunks_(kv_id, ts, false, chunk_ids, std::vector<std::vector<Val>*>(), pos, send_all, local_zero_copy, false, consistency_control, direct);
+        return future;
+    }
+
     /*
      * Pull a list of chunks from server with min clock
      * TODO: Now the API only get the smallest min_clock among all the servers
@@ -291,6 +537,133 @@ class KVWorker {
         return ts;
     }
 
+    /*
+     * Pull a list of chunks, but only the chunks modified since the versions held by the caller are shipped
+     *
+     * The servers keep a version for each chunk (see ChunkVersions) and reply with the chunks whose
+     * version differs from (*versions)[i], the others are not modified and not sent.
+     * Modified chunks and their entries in versions are overwritten, the rest are left untouched.
+     * Use ChunkVersions::kNoVersion for the chunks not held yet.
+     * Local servers are also reached by serialization, zero-copy would copy every chunk anyway.
+     *
+     * @param kv_id the kv_id users want to handle with
+     * @param chunk_ids The chunk_ids that needs to be pulled
+     * @param chunks The chunks provided must be created beforehand
+     * @param versions The versions of the chunks held by the caller, updated in place
+     * @param min_clock If not nullptr, pull with min clock as PullChunksWithMinClock (SSP only)
+     * @param send_all whether needs to send to all servers
+     * @param cb callback function
+     */
+    template<typename Val>
+    int PullChunksIfModified(int kv_id, const std::vector<size_t>& chunk_ids, const std::vector<std::vector<Val>*>& chunks,
+             std::vector<uint32_t>* versions, int* min_clock = nullptr, bool send_all = true, const Callback& cb = nullptr) {
+        assert(chunk_ids.size() == chunks.size());
+        assert(chunk_ids.size() == versions->size());
+        // 1. partition
+        std::vector<size_t> pos = PartitionChunks_(kv_id, chunk_ids);
+        // 2. get ts
+        int ts = GetTimestampChunk_(kv_id, pos, send_all);
+        AddCallback(kv_id, ts, [this, kv_id, ts, chunk_ids, chunks, versions, min_clock, cb]() {
+            mu_.lock();
+            auto& kvs = static_cast<RecvKVPairsWithVersions<Val>*>(recv_kvs_[{kv_id, ts}])->recv_kvs;
+            mu_.unlock();
+
+            size_t chunk_size = RangeManager::Get().GetChunkSize(kv_id);
+            size_t chunk_num = RangeManager::Get().GetChunkNum(kv_id);
+            int min_clock_local = std::numeric_limits<int>::max();
+            for (const auto& s : kvs) {
+                const KVPairs<Val>& kv = std::get<0>(s);
+                const std::vector<uint32_t>& new_versions = std::get<1>(s);
+                size_t start = 0;
+                for (size_t i = 0; i < kv.keys.size(); ++ i) {
+                    size_t idx = std::lower_bound(chunk_ids.begin(), chunk_ids.end(), kv.keys[i]) - chunk_ids.begin();
+                    assert(idx < chunk_ids.size() && chunk_ids[idx] == kv.keys[i]);
+                    size_t real_chunk_size = kv.keys[i] == chunk_num - 1 ? kv.vals.size() - start : chunk_size;
+                    chunks[idx]->resize(real_chunk_size);
+                    memcpy(chunks[idx]->data(), kv.vals.data() + start, real_chunk_size * sizeof(Val));
+                    (*versions)[idx] = new_versions[i];
+                    start += real_chunk_size;
+                }
+                if (std::get<2>(s) < min_clock_local)
+                    min_clock_local = std::get<2>(s);
+            }
+            if (min_clock)
+                *min_clock = min_clock_local;
+
+            mu_.lock();
+            delete recv_kvs_[{kv_id, ts}];
+            recv_kvs_.erase({kv_id, ts});
+            mu_.unlock();
+            if (cb)
+                cb();
+        });
+        // 3. send chunk_ids and versions
+        const std::vector<pslite::Range>& ranges = RangeManager::Get().GetServerKeyRanges(kv_id);
+        int src = info_.global_id;
+        int cmd = min_clock ? versioned_cmd_ + with_min_clock_magic_ : versioned_cmd_;  // 6, 16
+        for (size_t i = 0; i < ranges.size(); ++ i) {
+            if (!send_all && pos[i] == pos[i+1])  // if no need to send all, skip empty sliced
+                continue;
+            husky::base::BinStream bin;
+            bin << kv_id << ts << static_cast<int>(i) << cmd << false << src;
+            if (pos[i] != pos[i+1]) {  // if empty, don't send the size
+                std::vector<size_t> ids(chunk_ids.begin() + pos[i], chunk_ids.begin() + pos[i+1]);
+                std::vector<uint32_t> held(versions->begin() + pos[i], versions->begin() + pos[i+1]);
+                bin << ids << held;
+            }
+            SendTo_(i, bin);
+        }
+        return ts;
+    }
+
+    /*
+     * Subscribe to the chunks of an SSP kvstore (Eager SSP)
+     *
+     * Whenever the min_clock of a server advances, it pushes the subscribed chunks modified since
+     * its last push to this kvworker, and handler is invoked on the receiving thread with them.
+     * The chunks in EagerChunks::unmodified are unchanged, so their cached copies are as fresh as min_clock.
+     * Subscribe replaces the previous subscription of this kvworker for kv_id,
+     * empty chunk_ids unsubscribe. Once the returned ts is waited, handler won't be invoked for the
+     * old subscription anymore.
+     *
+     * Only for the kvstores served by SSPServer, throw otherwise.
+     *
+     * @param kv_id the kv_id users want to handle with
+     * @param chunk_ids The sorted chunk_ids to subscribe
+     * @param handler The function to handle the pushed chunks
+     */
+    template<typename Val>
+    int Subscribe(int kv_id, const std::vector<size_t>& chunk_ids, const std::function<void(EagerChunks<Val>&)>& handler) {
+        if (subscribable_kv_ids_.find(kv_id) == subscribable_kv_ids_.end())
+            throw husky::base::HuskyException("Subscribe on kv_id " + std::to_string(kv_id) + " which is not served by SSPServer");
+        std::vector<size_t> pos = PartitionChunks_(kv_id, chunk_ids);
+        size_t n = RangeManager::Get().GetServerKeyRanges(kv_id).size();
+        int ts = customer_->NewRequest(kv_id, n);  // all servers, to replace the old subscriptions
+        if (chunk_ids.empty()) {
+            AddCallback(kv_id, ts, [this, kv_id]() {
+                std::lock_guard<std::mutex> lk(mu_);
+                eager_handlers_.erase(kv_id);
+            });
+        } else {
+            std::lock_guard<std::mutex> lk(mu_);
+            eager_handlers_[kv_id] = [handler](husky::base::BinStream& bin) {
+                EagerChunks<Val> chunks;
+                bin >> chunks.kvs.keys >> chunks.kvs.vals >> chunks.versions >> chunks.unmodified >> chunks.min_clock;
+                handler(chunks);
+            };
+        }
+        int src = info_.global_id;
+        int cmd = eager_cmd_;
+        bool push = true;  // no data in the reply
+        for (size_t i = 0; i < n; ++ i) {
+            husky::base::BinStream bin;
+            bin << kv_id << ts << static_cast<int>(i) << cmd << push << src;
+            bin << std::vector<size_t>(chunk_ids.begin() + pos[i], chunk_ids.begin() + pos[i+1]);
+            SendTo_(i, bin);
+        }
+        return ts;
+    }
+
     // Deprecated
     template<typename Val>
     int PushLocal(int kv_id, int dst, const std::vector<husky::constants::Key>& keys, 
@@ -301,9 +674,10 @@ class KVWorker {
         bool isPush = true;
         int cmd = 0;
         int src = info_.global_id;
-        bin << kv_id << ts << cmd << isPush << src;
-        bin << keys << vals;
-        customer_->send(info_.get_tid(dst), bin);
+        bin << kv_id << ts << dst << cmd << isPush << src;
+        WriteSArray(bin, pslite::SArray<husky::constants::Key>(keys));
+        WriteSArray(bin, pslite::SArray<Val>(vals));
+        SendTo_(dst, bin);
         return ts;
     }
 
@@ -334,16 +708,50 @@ class KVWorker {
         bool isPush = false;
         int cmd = 0;
         int src = info_.global_id;
-        bin << kv_id << ts << cmd << isPush << src;
-        bin << keys;
-        customer_->send(info_.get_tid(dst), bin);
+        bin << kv_id << ts << dst << cmd << isPush << src;
+        WriteSArray(bin, pslite::SArray<husky::constants::Key>(keys));
+        SendTo_(dst, bin);
         return ts;
     }
 
     /*
      * \brief Waits until a push or pull has been finished
      */
-    void Wait(int kv_id, int timestamp) { customer_->WaitRequest(kv_id, timestamp); }
+    void Wait(int kv_id, int timestamp) {
+        ScopedTimer timer(GetMetrics_(kv_id).wait_ns);
+        husky::TraceScope scope("Wait", "kvworker", "kv_id", kv_id, true);
+        customer_->WaitRequest(kv_id, timestamp);
+    }
+
+    /*
+     * \brief Set the wire encoding of the keys in Push/Pull for kv_id
+     *
+     * Keys sent to remote servers are encoded with codec (cmd 5), the servers decode them
+     * and encode the keys in the reply. Local zero-copy requests are not affected.
+     * Should be set before the kvstore is used, like AddProcessFunc.
+     */
+    void SetKeyCodec(int kv_id, KeyCodec codec) {
+        key_codecs_[kv_id] = codec;
+    }
+
+    /*
+     * \brief Set the lossy compression of the vals in Push for kv_id
+     *
+     * Only Push to remote servers is compressed (cmd 5), the error is fed back to the next Push.
+     * Should be set before the kvstore is used, like AddProcessFunc.
+     */
+    void SetPushCompression(int kv_id, const PushCompression& compression) {
+        push_compressions_[kv_id] = compression;
+        push_compressors_.erase(kv_id);
+    }
+
+    /*
+     * \brief Return the compression stats of Push for kv_id
+     */
+    PushCompressionStats GetPushCompressionStats(int kv_id) {
+        auto it = push_compressors_.find(kv_id);
+        return it == push_compressors_.end() ? PushCompressionStats() : it->second->stats;
+    }
 
     /*
      * \brief Engine use this funciton to add process func
@@ -351,12 +759,33 @@ class KVWorker {
     template <typename Val>
     void AddProcessFunc(int kv_id) {
         assert(process_map.find(kv_id) == process_map.end());
+        AddMetrics_(kv_id);
         process_map.insert(
             std::make_pair(kv_id, [this](int kv_id, int ts, husky::base::BinStream& bin, bool runCallback) {
                 UniqueProcess<Val>(kv_id, ts, bin, runCallback);
             }));  // push the function template in
     }
 
+    /*
+     * \brief KVStore uses this function to register a server of this process which supports direct access
+     *
+     * Push/Pull with local_zero_copy then read and update its storage in the calling thread,
+     * without a message. Should be called before the kvstore is used, like AddProcessFunc.
+     */
+    void AddDirectServer(int kv_id, int server_id, DirectAccessBase* server) {
+        assert(info_.local_server_ids.find(server_id) != info_.local_server_ids.end());
+        auto& servers = direct_servers_[kv_id];
+        servers.resize(info_.num_ps_servers, nullptr);
+        servers[server_id] = server;
+    }
+
+    /*
+     * \brief KVStore uses this function to register a kvstore whose servers accept Subscribe
+     *
+     * Should be called before the kvstore is used, like AddProcessFunc.
+     */
+    void AllowSubscribe(int kv_id) { subscribable_kv_ids_.insert(kv_id); }
+
    private:
     /*
      * \brief UniqueProcess for every individual kvstore
@@ -369,6 +798,17 @@ class KVWorker {
         bin >> cmd;
         bin >> push;
         bin >> src;
+        if (ts == WorkerCustomer::server_push_ts_) {  // chunks pushed by the server (Eager SSP), not a response
+            std::function<void(husky::base::BinStream&)> handler;
+            mu_.lock();
+            auto it = eager_handlers_.find(kv_id);
+            if (it != eager_handlers_.end())
+                handler = it->second;
+            mu_.unlock();
+            if (handler)
+                handler(bin);
+            return;
+        }
         if (push == true)
             ;                      // if is push
         else if (push == false) {  // if is pull
@@ -397,7 +837,15 @@ class KVWorker {
                 mu_.unlock();
             };
             cmd %= consistency_control_off_magic_;
-            if (cmd == 2) {  // zero-copy enabled
+            std::function<void(int, husky::base::BinStream&)> sink;
+            mu_.lock();
+            auto sink_it = pull_sinks_.find({kv_id, ts});
+            if (sink_it != pull_sinks_.end())
+                sink = sink_it->second;
+            mu_.unlock();
+            if (sink) {  // PullAsync/PullChunksAsync, write into the destination of the caller directly
+                sink(cmd, bin);
+            } else if (cmd == 2) {  // zero-copy enabled
                 // husky::LOG_I << RED("zero-copy in Pull is enabled");
                 std::uintptr_t ptr;
                 bin >> ptr;
@@ -405,14 +853,38 @@ class KVWorker {
                 update_kvs(*p_recv);
                 delete p_recv;
             } else if (cmd == 13 || cmd == 11) {  // for PullChunksWithMinClock
+                auto owner = std::make_shared<husky::base::BinStream>(std::move(bin));  // kept by the SArrays until the callback
                 std::pair<KVPairs<Val>, int> kvs;
-                bin >> kvs.first.keys >> kvs.first.vals >> kvs.second;
+                ShareSArray(owner, &kvs.first.keys);
+                ShareSArray(owner, &kvs.first.vals);
+                *owner >> kvs.second;
                 update_kvs_with_min_clock(kvs);
+            } else if (cmd == 6 || cmd == 16) {  // for PullChunksIfModified, keep the replies without modified chunks
+                std::tuple<KVPairs<Val>, std::vector<uint32_t>, int> kvs;
+                bin >> std::get<0>(kvs).keys >> std::get<0>(kvs).vals >> std::get<1>(kvs);
+                std::get<2>(kvs) = std::numeric_limits<int>::max();
+                if (cmd == 16)
+                    bin >> std::get<2>(kvs);
+                mu_.lock();
+                if (recv_kvs_.find({kv_id, ts}) == recv_kvs_.end()) {
+                    recv_kvs_[{kv_id, ts}] = new RecvKVPairsWithVersions<Val>();
+                }
+                static_cast<RecvKVPairsWithVersions<Val>*>(recv_kvs_[{kv_id, ts}])->recv_kvs.push_back(std::move(kvs));
+                mu_.unlock();
+            } else if (cmd == 5) {  // encoded keys
+                auto owner = std::make_shared<husky::base::BinStream>(std::move(bin));
+                KVPairs<Val> kvs;
+                DecodeKeys(*owner, &kvs.keys);
+                ShareSArray(owner, &kvs.vals);
+                update_kvs(kvs);
             } else {
                 // husky::LOG_I << RED("zero-copy in Pull is disabled");
+                // the SArrays alias the message instead of copying it
+                auto owner = std::make_shared<husky::base::BinStream>(std::move(bin));
                 KVPairs<Val> kvs;
                 // Format: keys, values
-                bin >> kvs.keys >> kvs.vals;
+                ShareSArray(owner, &kvs.keys);
+                ShareSArray(owner, &kvs.vals);
                 update_kvs(kvs);
             }
         }
@@ -429,7 +901,55 @@ class KVWorker {
      */
     void Process(int kv_id, int ts, husky::base::BinStream& bin, bool runCallback) {
         assert(process_map.find(kv_id) != process_map.end());
-        process_map[kv_id](kv_id, ts, bin, runCallback);
+        if (Metrics::Enabled()) {
+            auto& metrics = GetMetrics_(kv_id);
+            metrics.replies->Add();
+            metrics.bytes_in->Add(bin.size());
+        }
+        std::vector<int> batch_kv_ids;
+        if (runCallback) {  // the ts of a Batch is shared by its kv_ids, run the callbacks of all of them
+            std::lock_guard<std::mutex> lk(mu_);
+            auto it = batch_kv_ids_.find(ts);
+            if (it != batch_kv_ids_.end()) {
+                batch_kv_ids.swap(it->second);
+                batch_kv_ids_.erase(it);
+            }
+        }
+        process_map[kv_id](kv_id, ts, bin, runCallback && batch_kv_ids.empty());
+        for (int id : batch_kv_ids)
+            RunCallback(id, ts);
+    }
+
+    /*
+     * Register the sink of a PullAsync/PullChunksAsync, the future completes with the last reply
+     *
+     * The replies of different servers go to disjoint parts of the destination, so the sink
+     * runs without holding mu_.
+     */
+    void AddPullSink_(int kv_id, int ts, bool empty, const KVFuture& future, const std::function<void(int, husky::base::BinStream&)>& sink) {
+        if (empty) {  // no server to wait for
+            future.Complete();
+            return;
+        }
+        std::lock_guard<std::mutex> lk(mu_);
+        pull_sinks_[{kv_id, ts}] = sink;
+        callbacks_[{kv_id, ts}] = [this, kv_id, ts, future]() {
+            mu_.lock();
+            pull_sinks_.erase({kv_id, ts});
+            mu_.unlock();
+            future.Complete();
+        };
+    }
+
+    /*
+     * Read an SArray<Val> from bin straight into dst, which has room for capacity vals
+     */
+    template <typename Val>
+    static void ScatterVals_(husky::base::BinStream& bin, Val* dst, size_t capacity) {
+        pslite::SArray<Val> vals;
+        ViewSArray(bin, &vals);
+        assert(vals.size() <= capacity);
+        memcpy(dst, vals.data(), vals.size() * sizeof(Val));
     }
 
     /*
@@ -465,31 +985,40 @@ class KVWorker {
         kvs.keys = keys;
         SlicedKVs<Val> sliced;
         Slice_(kvs, RangeManager::Get().GetServerKeyRanges(kv_id), &sliced);
-        // 2. get ts
+        // 2. retrieve from the local servers directly, one val per key
+        vals->resize(keys.size());
+        auto* direct = GetDirectServers_(kv_id, local_zero_copy);
+        RetrieveDirect_(direct, keys, &sliced, vals->data());
+        // 3. get ts
         int ts = GetTimestamp_(kv_id, sliced);
-        // 3. add callback
-        AddCallback(kv_id, ts, [this, kv_id, ts, keys, vals, cb]() mutable {
+        if (NumRemote_(sliced) == 0) {  // all done
+            Send_(kv_id, ts, false, sliced, send_all, local_zero_copy, consistency_control, direct);
+            if (cb)
+                cb();
+            return ts;
+        }
+        // 4. add callback
+        AddCallback(kv_id, ts, PullCallback_<Val>(kv_id, ts, keys, vals, cb));
+        // 5. send
+        Send_(kv_id, ts, false, sliced, send_all, local_zero_copy, consistency_control, direct);
+        return ts;
+    }
+
+    /*
+     * The callback of Pull_, fill vals with the replies of the servers
+     */
+    template <typename Val, typename C>
+    Callback PullCallback_(int kv_id, int ts, const pslite::SArray<husky::constants::Key>& keys, C* vals, const Callback& cb) {
+        return [this, kv_id, ts, keys, vals, cb]() {
             mu_.lock();
             auto& kvs = static_cast<RecvKVPairs<Val>*>(recv_kvs_[{kv_id, ts}])->recv_kvs;
             mu_.unlock();
 
-            // do check
-            size_t total_key = 0, total_val = 0;
-            for (const auto& s : kvs) {
-                pslite::Range range = pslite::FindRange(keys, s.keys.front(), s.keys.back() + 1);
-                total_key += s.keys.size();
-                total_val += s.vals.size();
-            }
-
-            // fill vals and lens
-            std::sort(kvs.begin(), kvs.end(),
-                      [](const KVPairs<Val>& a, const KVPairs<Val>& b) { return a.keys.front() < b.keys.front(); });
-            // resize, do we need to really free the memory?
-            vals->resize(total_val);
-            Val* p_vals = vals->data();
+            // fill vals, each reply goes to the offset of its first key
             for (const auto& s : kvs) {
-                memcpy(p_vals, s.vals.data(), s.vals.size() * sizeof(Val));
-                p_vals += s.vals.size();
+                size_t offset = std::lower_bound(keys.begin(), keys.end(), s.keys.front()) - keys.begin();
+                assert(offset + s.vals.size() <= vals->size());
+                memcpy(vals->data() + offset, s.vals.data(), s.vals.size() * sizeof(Val));
             }
 
             mu_.lock();
@@ -498,10 +1027,7 @@ class KVWorker {
             mu_.unlock();
             if (cb)
                 cb();
-        });
-        // 4. send
-        Send_(kv_id, ts, false, sliced, send_all, local_zero_copy, consistency_control);
-        return ts;
+        };
     }
 
     /*
@@ -556,31 +1082,113 @@ class KVWorker {
      */
     template<typename Val>
     int GetTimestamp_(int kv_id, const SlicedKVs<Val>& sliced) { 
-        int wait_num = 0;
-        for (size_t i = 0; i < sliced.size(); ++ i) {
-            if (sliced[i].first) wait_num += 1;
-        }
+        int wait_num = NumRemote_(sliced);
         int ts = customer_->NewRequest(kv_id, wait_num);
         // husky::LOG_I << RED("Wait num: "+std::to_string(wait_num));
         return ts;
     }
 
 
+    /*
+     * The servers of kv_id in this process which support direct access, indexed by server_id
+     *
+     * nullptr if local_zero_copy is off or there is no such server, e.g. SSP/BSP
+     */
+    const std::vector<DirectAccessBase*>* GetDirectServers_(int kv_id, bool local_zero_copy) {
+        if (!local_zero_copy)
+            return nullptr;
+        auto it = direct_servers_.find(kv_id);
+        return it == direct_servers_.end() ? nullptr : &it->second;
+    }
+    static bool IsDirect_(const std::vector<DirectAccessBase*>* direct, size_t server_id) {
+        return direct != nullptr && (*direct)[server_id] != nullptr;
+    }
+
+    /*
+     * Apply the slices of the direct servers in place and mark them as empty,
+     * so that only the remote servers are waited for
+     */
+    template <typename Val>
+    void UpdateDirect_(const std::vector<DirectAccessBase*>* direct, SlicedKVs<Val>* sliced) {
+        for (size_t i = 0; i < sliced->size(); ++ i) {
+            if (IsDirect_(direct, i) && sliced->at(i).first) {
+                auto& kvs = sliced->at(i).second;
+                static_cast<DirectAccess<Val>*>((*direct)[i])->DirectUpdate(kvs.keys.data(), kvs.vals.data(), kvs.keys.size());
+                sliced->at(i).first = false;
+            }
+        }
+    }
+    // vals holds one val per key of keys, the slices are segments of keys
+    template <typename Val>
+    void RetrieveDirect_(const std::vector<DirectAccessBase*>* direct, const pslite::SArray<husky::constants::Key>& keys,
+                         SlicedKVs<Val>* sliced, Val* vals) {
+        for (size_t i = 0; i < sliced->size(); ++ i) {
+            if (IsDirect_(direct, i) && sliced->at(i).first) {
+                auto& kvs = sliced->at(i).second;
+                size_t offset = kvs.keys.data() - keys.data();
+                static_cast<DirectAccess<Val>*>((*direct)[i])->DirectRetrieve(kvs.keys.data(), vals + offset, kvs.keys.size());
+                sliced->at(i).first = false;
+            }
+        }
+    }
+    template <typename Val>
+    void UpdateChunksDirect_(const std::vector<DirectAccessBase*>* direct, const std::vector<size_t>& chunk_ids,
+                             const std::vector<std::vector<Val>*>& chunks, const std::vector<size_t>& pos) {
+        for (size_t i = 0; i + 1 < pos.size(); ++ i) {
+            if (IsDirect_(direct, i) && pos[i] != pos[i+1])
+                static_cast<DirectAccess<Val>*>((*direct)[i])->DirectUpdateChunks(chunk_ids.data() + pos[i], chunks.data() + pos[i], pos[i+1] - pos[i]);
+        }
+    }
+    template <typename Val>
+    void RetrieveChunksDirect_(const std::vector<DirectAccessBase*>* direct, const std::vector<size_t>& chunk_ids,
+                               const std::vector<std::vector<Val>*>& chunks, const std::vector<size_t>& pos) {
+        for (size_t i = 0; i + 1 < pos.size(); ++ i) {
+            if (IsDirect_(direct, i) && pos[i] != pos[i+1])
+                static_cast<DirectAccess<Val>*>((*direct)[i])->DirectRetrieveChunks(chunk_ids.data() + pos[i], chunks.data() + pos[i], pos[i+1] - pos[i]);
+        }
+    }
+
+    /*
+     * The number of servers to wait for
+     */
+    template <typename Val>
+    static int NumRemote_(const SlicedKVs<Val>& sliced) {
+        int num = 0;
+        for (size_t i = 0; i < sliced.size(); ++ i) {
+            if (sliced[i].first) num += 1;
+        }
+        return num;
+    }
+    static int NumRemoteChunks_(const std::vector<size_t>& pos, const std::vector<DirectAccessBase*>* direct) {
+        int num = 0;
+        for (size_t i = 0; i + 1 < pos.size(); ++ i) {
+            if (pos[i] != pos[i+1] && !IsDirect_(direct, i)) num += 1;
+        }
+        return num;
+    }
+
     /*
      * 3. The Send_ function to send out Push/Pull request
      *
      * @return ts 
      */
     template <typename Val>
-    void Send_(int kv_id, int ts, bool push, const SlicedKVs<Val>& sliced, bool send_all, bool local_zero_copy, bool consistency_control) {
+    void Send_(int kv_id, int ts, bool push, const SlicedKVs<Val>& sliced, bool send_all, bool local_zero_copy, bool consistency_control,
+               const std::vector<DirectAccessBase*>* direct = nullptr, BatchRequests* batch = nullptr) {
         int src = info_.global_id;
         int cmd = 0;  // cmd 0 for normal
+        auto codec_it = key_codecs_.find(kv_id);
+        KeyCodec codec = codec_it == key_codecs_.end() ? KeyCodec::kRaw : codec_it->second;
+        PushCompressor<Val>* compressor = push ? GetPushCompressor_<Val>(kv_id) : nullptr;
         for (size_t i = 0; i < sliced.size(); ++i) {
             if (!send_all && !sliced[i].first) {  // if no need to send all, skip empty sliced
                 continue;
             }
+            if (IsDirect_(direct, i)) {  // handled by UpdateDirect_/RetrieveDirect_
+                continue;
+            }
             husky::base::BinStream bin;
-            bin << kv_id << ts;
+            bin << kv_id << ts << static_cast<int>(i);
             if (local_zero_copy == true && info_.local_server_ids.find(i) != info_.local_server_ids.end()) {  // if enable local_zero_copy
                 if (consistency_control) {
                     bin << cmd + local_zero_copy_magic_;  // 2
@@ -597,25 +1205,112 @@ class KVWorker {
                     bin << reinterpret_cast<std::uintptr_t>(p);
                 }
             } else {
+                bool encoded = codec != KeyCodec::kRaw || compressor != nullptr;
+                int remote_cmd = encoded ? encoded_cmd_ : cmd;  // 0 or 5
                 if (consistency_control) {
-                    bin << cmd;  // 0
+                    bin << remote_cmd;  // 0, 5
                 } else {
-                    bin << cmd + consistency_control_off_magic_;  // 100
+                    bin << remote_cmd + consistency_control_off_magic_;  // 100, 105
                 }
                 bin << push << src;
                 if (sliced[i].first) {  // if no empty, don't send the size
                     auto& kvs = sliced[i].second;
-                    if (push)
-                        bin << kvs.keys << kvs.vals;
-                    else
-                        bin << kvs.keys;
+                    if (compressor) {
+                        compressor->Compress(kvs, codec, bin);
+                    } else if (encoded) {
+                        EncodeKeys(codec, kvs.keys, bin);
+                        if (push)
+                            EncodeVals(ValCodec::kRaw, kvs.vals.data(), kvs.vals.size(), bin, nullptr, static_cast<Val*>(nullptr));
+                    } else {
+                        WriteSArray(bin, kvs.keys);
+                        if (push)
+                            WriteSArray(bin, kvs.vals);
+                    }
                 }
             }
             // husky::LOG_I << CLAY("sending to "+std::to_string(i)+" size: "+std::to_string(bin.size()));
-            customer_->send(info_.get_tid(i), bin);
+            Post_(i, bin, batch);
         }
     }
 
+    /*
+     * Send a request to server_id, or keep it in batch to be sent by Batch::Send
+     */
+    void Post_(int server_id, husky::base::BinStream& bin, BatchRequests* batch) {
+        if (batch)
+            (*batch)[server_id].push_back(std::move(bin));
+        else
+            SendTo_(server_id, bin);
+    }
+
+    /*
+     * Send a message to server_id, the message starts with its kv_id
+     */
+    void SendTo_(int server_id, husky::base::BinStream& bin) {
+        if (Metrics::Enabled()) {
+            int kv_id;
+            memcpy(&kv_id, bin.get_remained_buffer(), sizeof(kv_id));
+            GetMetrics_(kv_id).bytes_out->Add(bin.size());
+        }
+        customer_->send(info_.get_tid(server_id), bin);
+    }
+
+    /*
+     * The metrics of kv_id, registered with the process func so that the lookup needs no lock
+     */
+    struct WorkerMetrics {
+        Metrics::Counter* bytes_out;
+        Metrics::Counter* bytes_in;
+        Metrics::Counter* replies;
+        Metrics::Histogram* wait_ns;
+    };
+    void AddMetrics_(int kv_id) {
+        auto& metrics = Metrics::Get();
+        int worker = info_.global_id;
+        metrics_[kv_id] = WorkerMetrics{metrics.GetCounter("kvstore_worker_bytes_out_total", kv_id, -1, worker),
+                                        metrics.GetCounter("kvstore_worker_bytes_in_total", kv_id, -1, worker),
+                                        metrics.GetCounter("kvstore_worker_replies_total", kv_id, -1, worker),
+                                        metrics.GetHistogram("kvstore_worker_wait_ns", kv_id, -1, worker)};
+    }
+    WorkerMetrics& GetMetrics_(int kv_id) {
+        auto it = metrics_.find(kv_id);
+        assert(it != metrics_.end());
+        return it->second;
+    }
+
+    /*
+     * Wrap the requests to server_id of a Batch into one message
+     */
+    void SendBatch_(int server_id, int ts, std::vector<husky::base::BinStream>& requests) {
+        if (requests.empty())
+            return;
+        if (requests.size() == 1) {  // no need to wrap
+            SendTo_(server_id, requests[0]);
+            return;
+        }
+        husky::base::BinStream bin;
+        bin << static_cast<int>(batch_kv_id_) << ts << server_id << requests.size();
+        for (auto& request : requests) {
+            bin << request.size();
+            bin.push_back_bytes(request.get_remained_buffer(), request.size());
+        }
+        SendTo_(server_id, bin);
+    }
+
+
+    /*
+     * Return the PushCompressor of kv_id, nullptr if Push of kv_id is not compressed
+     */
+    template <typename Val>
+    PushCompressor<Val>* GetPushCompressor_(int kv_id) {
+        auto it = push_compressions_.find(kv_id);
+        if (it == push_compressions_.end() || it->second.codec == ValCodec::kRaw)
+            return nullptr;
+        auto& compressor = push_compressors_[kv_id];
+        if (!compressor)
+            compressor.reset(new PushCompressor<Val>(it->second));
+        return static_cast<PushCompressor<Val>*>(compressor.get());
+    }
 
     /*
      * 1. PartitionChunks_ function to partition the provided chunk_ids for PushChunks/PullChunks
@@ -648,11 +1343,9 @@ class KVWorker {
      *
      * Identify wait_num
      */
-    int GetTimestampChunk_(int kv_id, const std::vector<size_t>& pos, bool send_all) {
-        int wait_num = 0;
-        for (int i = 0; i < pos.size() - 1; ++ i) {
-            if (pos[i] != pos[i+1]) wait_num += 1;
-        }
+    int GetTimestampChunk_(int kv_id, const std::vector<size_t>& pos, bool send_all,
+                           const std::vector<DirectAccessBase*>* direct = nullptr) {
+        int wait_num = NumRemoteChunks_(pos, direct);
         // husky::LOG_I << RED("wait num: "+std::to_string(wait_num));
         int ts = customer_->NewRequest(kv_id, wait_num);
         // husky::LOG_I << RED("Wait num: "+std::to_string(wait_num));
@@ -667,7 +1360,8 @@ class KVWorker {
     template<typename Val>
     void SendChunks_(int kv_id, int ts, bool push,
             const std::vector<size_t>& chunk_ids, const std::vector<std::vector<Val>*>& chunks, 
-            const std::vector<size_t>& pos, bool send_all, bool local_zero_copy, bool with_min_clock, bool consistency_control) {
+            const std::vector<size_t>& pos, bool send_all, bool local_zero_copy, bool with_min_clock, bool consistency_control,
+            const std::vector<DirectAccessBase*>* direct = nullptr) {
         const std::vector<pslite::Range>& ranges = RangeManager::Get().GetServerKeyRanges(kv_id);
         size_t n = ranges.size();
 
@@ -678,8 +1372,11 @@ class KVWorker {
             if (!send_all && pos[i] == pos[i+1]) {  // if no need to send all, skip empty sliced
                 continue;
             }
+            if (IsDirect_(direct, i)) {  // handled by UpdateChunksDirect_/RetrieveChunksDirect_
+                continue;
+            }
             husky::base::BinStream bin;
-            bin << kv_id << ts;
+            bin << kv_id << ts << static_cast<int>(i);
             if (local_zero_copy == true && info_.local_server_ids.find(i) != info_.local_server_ids.end()) {
                 int local_cmd = cmd + local_zero_copy_magic_;  // 3
                 if (with_min_clock)
@@ -729,7 +1426,7 @@ class KVWorker {
                     }
                 }
             }
-            customer_->send(info_.get_tid(i), bin);
+            SendTo_(i, bin);
         }
     }
 
@@ -738,10 +1435,25 @@ class KVWorker {
     std::unordered_map<std::pair<int, int>, RecvKVPairsBase*> recv_kvs_;  // { <kv_id,ts>, recv_kvs_ }
     // callbacks
     std::unordered_map<std::pair<int, int>, Callback> callbacks_;  // { <kv_id,ts>, callback_ }
+    // destinations of PullAsync/PullChunksAsync
+    std::unordered_map<std::pair<int, int>, std::function<void(int, husky::base::BinStream&)>> pull_sinks_;  // { <kv_id,ts>, sink }
     // process function map
     std::unordered_map<int, std::function<void(int, int, husky::base::BinStream&, bool)>>
         process_map;  // {kv_id, process()}
     std::mutex mu_;
+    // key codecs
+    std::unordered_map<int, KeyCodec> key_codecs_;  // {kv_id, codec}, kRaw if not set
+    // push compression
+    std::unordered_map<int, PushCompression> push_compressions_;  // {kv_id, compression}
+    std::unordered_map<int, std::unique_ptr<PushCompressorBase>> push_compressors_;  // {kv_id, compressor}
+    // Eager SSP
+    std::unordered_map<int, std::function<void(husky::base::BinStream&)>> eager_handlers_;  // {kv_id, handler}
+    std::unordered_set<int> subscribable_kv_ids_;
+    // local servers with direct access
+    std::unordered_map<int, std::vector<DirectAccessBase*>> direct_servers_;  // {kv_id, servers indexed by server_id}
+    // the kv_ids with a Pull in a Batch in flight
+    std::unordered_map<int, std::vector<int>> batch_kv_ids_;  // {ts, kv_ids}
+    std::unordered_map<int, WorkerMetrics> metrics_;  // {kv_id, metrics}
 
     // customer
     std::unique_ptr<WorkerCustomer> customer_;
@@ -750,6 +1462,10 @@ class KVWorker {
     static const int consistency_control_off_magic_ = 100;
     static const int local_zero_copy_magic_ = 2;
     static const int with_min_clock_magic_ = 10;
+    static const int encoded_cmd_ = 5;
+    static const int versioned_cmd_ = 6;
+    static const int eager_cmd_ = 7;
+    static const int batch_kv_id_ = -1;  // the requests of a Batch in one message, see KVManager::ProcessBatch
 };
 
 }  // namespace kvstore
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace kvstore {
+
+/*
+ * LatencyHistogram: log-linear buckets over uint64_t (e.g. latencies in ns)
+ *
+ * The values below 2^kSubBits have their own bucket, above that each power of 2 is split into
+ * 2^kSubBits buckets, so a percentile is off by at most 1/2^kSubBits (~3%) with a fixed 15KB table.
+ * Not thread-safe: record in one histogram per thread and Merge them.
+ */
+class LatencyHistogram {
+   public:
+    static const int kSubBits = 5;
+    static const int kSubBuckets = 1 << kSubBits;
+    static const int kNumBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+    LatencyHistogram() : buckets_(kNumBuckets) {}
+
+    void Record(uint64_t val) {
+        buckets_[BucketOf(val)] += 1;
+        count_ += 1;
+        sum_ += val;
+        min_ = std::min(min_, val);
+        max_ = std::max(max_, val);
+    }
+
+    void Merge(const LatencyHistogram& other) {
+        for (int i = 0; i < kNumBuckets; ++ i)
+            buckets_[i] += other.buckets_[i];
+        count_ += other.count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    void Clear() { *this = LatencyHistogram(); }
+
+    /*
+     * The value below which p percent of the records fall, the upper bound of its bucket
+     *
+     * @param p in [0, 100]
+     */
+    uint64_t Percentile(double p) const {
+        if (count_ == 0)
+            return 0;
+        uint64_t rank = static_cast<uint64_t>(p / 100.0 * count_ + 0.5);
+        rank = std::max<uint64_t>(1, std::min(rank, count_));
+        uint64_t seen = 0;
+        for (int i = 0; i < kNumBuckets; ++ i) {
+            seen += buckets_[i];
+            if (seen >= rank)
+                return std::max(min_, std::min(max_, UpperBound(i)));
+        }
+        return max_;
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    uint64_t sum() const { return sum_; }
+    double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0.0; }
+
+    static int BucketOf(uint64_t val) {
+        if (val < kSubBuckets)
+            return val;
+        int exp = 63 - __builtin_clzll(val);  // >= kSubBits
+        int sub = (val >> (exp - kSubBits)) & (kSubBuckets - 1);
+        return (exp - kSubBits + 1) * kSubBuckets + sub;
+    }
+
+    // the largest value in bucket i
+    static uint64_t UpperBound(int i) {
+        if (i < kSubBuckets)
+            return i;
+        int exp = i / kSubBuckets + kSubBits - 1;
+        uint64_t sub = i % kSubBuckets;
+        uint64_t width = uint64_t(1) << (exp - kSubBits);
+        return (uint64_t(1) << exp) + (sub + 1) * width - 1;
+    }
+
+   private:
+    std::vector<uint64_t> buckets_;
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = std::numeric_limits<uint64_t>::max();
+    uint64_t max_ = 0;
+};
+
+}  // namespace kvstore
@@ -0,0 +1,45 @@
+#include "gtest/gtest.h"
+
+#include "kvstore/latency_histogram.hpp"
+
+namespace husky {
+namespace {
+
+class TestLatencyHistogram: public testing::Test {
+   public:
+    TestLatencyHistogram() {}
+    ~TestLatencyHistogram() {}
+};
+
+TEST_F(TestLatencyHistogram, Buckets) {
+    // every value falls into a bucket whose upper bound is not below it
+    for (uint64_t val : {0ull, 1ull, 31ull, 32ull, 33ull, 1000ull, 123456789ull, ~0ull}) {
+        int bucket = kvstore::LatencyHistogram::BucketOf(val);
+        EXPECT_LT(bucket, static_cast<int>(kvstore::LatencyHistogram::kNumBuckets));
+        EXPECT_GE(kvstore::LatencyHistogram::UpperBound(bucket), val);
+        if (bucket > 0) {
+            EXPECT_LT(kvstore::LatencyHistogram::UpperBound(bucket - 1), val);
+        }
+    }
+}
+
+TEST_F(TestLatencyHistogram, Percentile) {
+    kvstore::LatencyHistogram a, b;
+    EXPECT_EQ(a.Percentile(50), 0);
+    for (uint64_t i = 1; i <= 5000; ++ i)
+        a.Record(i * 1000);
+    for (uint64_t i = 5001; i <= 10000; ++ i)
+        b.Record(i * 1000);
+    a.Merge(b);
+    EXPECT_EQ(a.count(), 10000);
+    EXPECT_EQ(a.min(), 1000);
+    EXPECT_EQ(a.max(), 10000000);
+    EXPECT_DOUBLE_EQ(a.mean(), 5000500.0);
+    // within the relative error of the buckets
+    EXPECT_NEAR(a.Percentile(50), 5000000, 5000000 / 32);
+    EXPECT_NEAR(a.Percentile(99), 9900000, 9900000 / 32);
+    EXPECT_EQ(a.Percentile(100), 10000000);
+}
+
+}  // namespace
+}  // namespace husky
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+
+#include "kvstore/latency_histogram.hpp"
+
+namespace kvstore {
+
+/*
+ * The runtime metrics of the kvstore
+ *
+ * A metric is identified by its name and the labels kv_id, server_id and worker (-1 if not relevant).
+ * The instrumented code looks up its Counter/Gauge/Histogram once and keeps the pointer,
+ * they live as long as the process. Updates are sharded by thread, so they rarely contend.
+ *
+ * Recording is off by default, the instrumented code checks Metrics::Enabled() first.
+ * Query in process with CounterValue/GaugeValue/HistogramValue, or dump the Prometheus text
+ * format to a file periodically with StartDump.
+ *
+ * Metrics of the kvstore:
+ *   kvstore_server_requests_total, kvstore_server_bytes_in_total, kvstore_server_bytes_out_total,
+ *   kvstore_server_handle_ns                           {kv_id, server_id}
+ *   kvstore_server_queue_depth                         {server_id}, requests waiting for a shard thread
+ *   kvstore_ssp_blocked_pull_ns, kvstore_ssp_blocked_push_ns
+ *                                                      {kv_id, server_id}, time parked by SSP
+ *   kvstore_worker_bytes_out_total, kvstore_worker_bytes_in_total, kvstore_worker_replies_total,
+ *   kvstore_worker_wait_ns                             {kv_id, worker}, worker is the kvworker mailbox id
+ */
+class Metrics {
+   public:
+    static const int kNumShards = 16;
+
+    class Counter {
+       public:
+        void Add(uint64_t n = 1) { shards_[ShardIndex()].val.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t Value() const {
+            uint64_t sum = 0;
+            for (auto& shard : shards_)
+                sum += shard.val.load(std::memory_order_relaxed);
+            return sum;
+        }
+
+       private:
+        // padded to a cache line, not alignas(64): plain new does not honour over-alignment before C++17
+        struct Shard {
+            std::atomic<uint64_t> val{0};
+            char pad[64 - sizeof(std::atomic<uint64_t>)];
+        };
+        std::array<Shard, kNumShards> shards_;
+    };
+
+    class Gauge {
+       public:
+        void Add(int64_t n) { val_.fetch_add(n, std::memory_order_relaxed); }
+        void Set(int64_t n) { val_.store(n, std::memory_order_relaxed); }
+        int64_t Value() const { return val_.load(std::memory_order_relaxed); }
+
+       private:
+        std::atomic<int64_t> val_{0};
+    };
+
+    /*
+     * The shards are allocated by the first Record of a thread in them, most histograms
+     * are only recorded by one or two threads
+     */
+    class Histogram {
+       public:
+        void Record(uint64_t val) {
+            auto& shard = shards_[ShardIndex()];
+            std::lock_guard<std::mutex> lk(shard.mu);
+            if (!shard.hist)
+                shard.hist.reset(new LatencyHistogram());
+            shard.hist->Record(val);
+        }
+        LatencyHistogram Value() const {
+            LatencyHistogram res;
+            for (auto& shard : shards_) {
+                std::lock_guard<std::mutex> lk(shard.mu);
+                if (shard.hist)
+                    res.Merge(*shard.hist);
+            }
+            return res;
+        }
+
+       private:
+        struct Shard {
+            mutable std::mutex mu;
+            std::unique_ptr<LatencyHistogram> hist;
+        };
+        std::array<Shard, kNumShards> shards_;
+    };
+
+    static Metrics& Get() {
+        static Metrics metrics;
+        return metrics;
+    }
+    ~Metrics() { StopDump(); }
+
+    static bool Enabled() { return EnabledFlag().load(std::memory_order_relaxed); }
+    static void Enable(bool enabled = true) { EnabledFlag().store(enabled); }
+
+    Counter* GetCounter(const std::string& name, int kv_id, int server_id = -1, int worker = -1) {
+        return Find(counters_, name, kv_id, server_id, worker);
+    }
+    Gauge* GetGauge(const std::string& name, int kv_id, int server_id = -1, int worker = -1) {
+        return Find(gauges_, name, kv_id, server_id, worker);
+    }
+    Histogram* GetHistogram(const std::string& name, int kv_id, int server_id = -1, int worker = -1) {
+        return Find(histograms_, name, kv_id, server_id, worker);
+    }
+
+    uint64_t CounterValue(const std::string& name, int kv_id, int server_id = -1, int worker = -1) {
+        return GetCounter(name, kv_id, server_id, worker)->Value();
+    }
+    int64_t GaugeValue(const std::string& name, int kv_id, int server_id = -1, int worker = -1) {
+        return GetGauge(name, kv_id, server_id, worker)->Value();
+    }
+    LatencyHistogram HistogramValue(const std::string& name, int kv_id, int server_id = -1, int worker = -1) {
+        return GetHistogram(name, kv_id, server_id, worker)->Value();
+    }
+
+    /*
+     * All the metrics in the Prometheus text format, histograms as summaries
+     */
+    std::string DumpPrometheus() {
+        std::stringstream ss;
+        std::lock_guard<std::mutex> lk(mu_);
+        std::string last;
+        for (auto& kv : counters_) {
+            Type(ss, std::get<0>(kv.first), "counter", &last);
+            ss << std::get<0>(kv.first) << Labels(kv.first) << " " << kv.second->Value() << "\n";
+        }
+        for (auto& kv : gauges_) {
+            Type(ss, std::get<0>(kv.first), "gauge", &last);
+            ss << std::get<0>(kv.first) << Labels(kv.first) << " " << kv.second->Value() << "\n";
+        }
+        for (auto& kv : histograms_) {
+            const std::string& name = std::get<0>(kv.first);
+            Type(ss, name, "summary", &last);
+            LatencyHistogram hist = kv.second->Value();
+            for (auto q : {std::make_pair("0.5", 50.0), std::make_pair("0.99", 99.0), std::make_pair("0.999", 99.9)})
+                ss << name << Labels(kv.first, std::string("quantile=\"") + q.first + "\"") << " " << hist.Percentile(q.second) << "\n";
+            ss << name << "_sum" << Labels(kv.first) << " " << hist.sum() << "\n";
+            ss << name << "_count" << Labels(kv.first) << " " << hist.count() << "\n";
+        }
+        return ss.str();
+    }
+
+    /*
+     * Write DumpPrometheus to path every interval_ms in a background thread, replaced atomically
+     */
+    void StartDump(const std::string& path, int interval_ms) {
+        StopDump();
+        std::lock_guard<std::mutex> lk(dump_mu_);
+        dump_stopped_ = false;
+        dump_thread_.reset(new std::thread([this, path, interval_ms]() {
+            std::unique_lock<std::mutex> lk(dump_mu_);
+            while (!dump_cond_.wait_for(lk, std::chrono::milliseconds(interval_ms), [this] { return dump_stopped_; })) {
+                lk.unlock();
+                DumpToFile(path);
+                lk.lock();
+            }
+            lk.unlock();
+            DumpToFile(path);  // the final values
+        }));
+    }
+    void StopDump() {
+        std::unique_ptr<std::thread> thread;
+        {
+            std::lock_guard<std::mutex> lk(dump_mu_);
+            dump_stopped_ = true;
+            thread.swap(dump_thread_);
+        }
+        dump_cond_.notify_all();
+        if (thread)
+            thread->join();
+    }
+
+   private:
+    using MetricKey = std::tuple<std::string, int, int, int>;  // name, kv_id, server_id, worker
+
+    Metrics() = default;
+
+    static std::atomic<bool>& EnabledFlag() {
+        static std::atomic<bool> enabled{false};
+        return enabled;
+    }
+
+    static size_t ShardIndex() {
+        static std::atomic<size_t> next{0};
+        thread_local size_t index = next.fetch_add(1) % kNumShards;
+        return index;
+    }
+
+    template <typename T>
+    T* Find(std::map<MetricKey, std::unique_ptr<T>>& metrics, const std::string& name, int kv_id, int server_id, int worker) {
+        std::lock_guard<std::mutex> lk(mu_);
+        auto& metric = metrics[MetricKey(name, kv_id, server_id, worker)];
+        if (!metric)
+            metric.reset(new T());
+        return metric.get();
+    }
+
+    static void Type(std::stringstream& ss, const std::string& name, const char* type, std::string* last) {
+        if (name != *last)
+            ss << "# TYPE " << name << " " << type << "\n";
+        *last = name;
+    }
+
+    static std::string Labels(const MetricKey& key, const std::string& extra = "") {
+        std::string labels;
+        auto add = [&labels](const std::string& label) { labels += (labels.empty() ? "" : ",") + label; };
+        if (std::get<1>(key) != -1)
+            add("kv_id=\"" + std::to_string(std::get<1>(key)) + "\"");
+        if (std::get<2>(key) != -1)
+            add("server_id=\"" + std::to_string(std::get<2>(key)) + "\"");
+        if (std::get<3>(key) != -1)
+            add("worker=\"" + std::to_string(std::get<3>(key)) + "\"");
+        if (!extra.empty())
+            add(extra);
+        return labels.empty() ? "" : "{" + labels + "}";
+    }
+
+    void DumpToFile(const std::string& path) {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp);
+            out << DumpPrometheus();
+        }
+        std::rename(tmp.c_str(), path.c_str());
+    }
+
+    std::mutex mu_;
+    std::map<MetricKey, std::unique_ptr<Counter>> counters_;
+    std::map<MetricKey, std::unique_ptr<Gauge>> gauges_;
+    std::map<MetricKey, std::unique_ptr<Histogram>> histograms_;
+
+    std::mutex dump_mu_;
+    std::condition_variable dump_cond_;
+    bool dump_stopped_ = true;
+    std::unique_ptr<std::thread> dump_thread_;
+};
+
+/*
+ * Record the time from construction to destruction in hist (ns) if the metrics are enabled
+ */
+class ScopedTimer {
+   public:
+    explicit ScopedTimer(Metrics::Histogram* hist) : hist_(Metrics::Enabled() ? hist : nullptr) {
+        if (hist_)
+            start_ = std::chrono::steady_clock::now();
+    }
+    ~ScopedTimer() {
+        if (hist_)
+            hist_->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+    }
+
+   private:
+    Metrics::Histogram* hist_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace kvstore
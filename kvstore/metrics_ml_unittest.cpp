@@ -0,0 +1,95 @@
+#include "gtest/gtest.h"
+
+#include <thread>
+
+#include "kvstore/kvstore.hpp"
+#include "kvstore/metrics.hpp"
+
+namespace husky {
+namespace {
+
+class TestMetrics: public testing::Test {
+   public:
+    TestMetrics() {}
+    ~TestMetrics() {}
+
+   protected:
+    void SetUp() {
+        // 1. Create WorkerInfo
+        worker_info.add_worker(0,0,0);
+        worker_info.add_worker(0,1,1);
+        worker_info.set_process_id(0);
+
+        // 2. Create Mailbox
+        el = new MailboxEventLoop(&zmq_context);
+        el->set_process_id(0);
+        recver = new CentralRecver(&zmq_context, "inproc://test");
+        kvstore::Metrics::Enable();
+    }
+    void TearDown() {
+        kvstore::Metrics::Enable(false);
+        delete el;
+        delete recver;
+    }
+
+    WorkerInfo worker_info;
+    zmq::context_t zmq_context;
+    MailboxEventLoop* el;
+    CentralRecver * recver;
+};
+
+TEST_F(TestMetrics, Registry) {
+    auto& metrics = kvstore::Metrics::Get();
+    auto* counter = metrics.GetCounter("test_counter_total", 1, 2);
+    EXPECT_EQ(counter, metrics.GetCounter("test_counter_total", 1, 2));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++ i) {
+        threads.emplace_back([counter, &metrics]() {
+            for (int j = 0; j < 1000; ++ j) {
+                counter->Add();
+                metrics.GetHistogram("test_latency_ns", 1, -1, 3)->Record(j);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    metrics.GetGauge("test_depth", -1, 2)->Add(5);
+    EXPECT_EQ(metrics.CounterValue("test_counter_total", 1, 2), 4000);
+    EXPECT_EQ(metrics.GaugeValue("test_depth", -1, 2), 5);
+    EXPECT_EQ(metrics.HistogramValue("test_latency_ns", 1, -1, 3).count(), 4000);
+
+    std::string text = metrics.DumpPrometheus();
+    EXPECT_NE(text.find("# TYPE test_counter_total counter\n"), std::string::npos);
+    EXPECT_NE(text.find("test_counter_total{kv_id=\"1\",server_id=\"2\"} 4000\n"), std::string::npos);
+    EXPECT_NE(text.find("test_depth{server_id=\"2\"} 5\n"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_ns_count{kv_id=\"1\",worker=\"3\"} 4000\n"), std::string::npos);
+}
+
+TEST_F(TestMetrics, KVStore) {
+    auto& metrics = kvstore::Metrics::Get();
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context);
+    // SSP with staleness 0, so the Pull of the faster worker is blocked
+    int kv = kvstore::KVStore::Get().CreateKVStore<float>("ssp_add_map", 2, 0);
+    auto* kvworker0 = kvstore::KVStore::Get().get_kvworker(0);
+    auto* kvworker1 = kvstore::KVStore::Get().get_kvworker(1);
+    int worker0 = kvstore::KVStore::Get().get_kvworker_tid(0);
+    uint64_t requests = metrics.CounterValue("kvstore_server_requests_total", kv, 0);
+    uint64_t blocked = metrics.HistogramValue("kvstore_ssp_blocked_pull_ns", kv, 0).count();
+    uint64_t waits = metrics.HistogramValue("kvstore_worker_wait_ns", kv, -1, worker0).count();
+
+    kvworker0->Wait(kv, kvworker0->Push(kv, {0}, std::vector<float>{1.0}));
+    int ts = kvworker0->Pull(kv, {0}, new std::vector<float>);  // blocked until worker 1 pushes
+    kvworker1->Wait(kv, kvworker1->Push(kv, {0}, std::vector<float>{1.0}));
+    kvworker0->Wait(kv, ts);
+
+    EXPECT_EQ(metrics.CounterValue("kvstore_server_requests_total", kv, 0), requests + 3);
+    EXPECT_GT(metrics.CounterValue("kvstore_server_bytes_in_total", kv, 0), 0);
+    EXPECT_GT(metrics.CounterValue("kvstore_server_bytes_out_total", kv, 0), 0);
+    EXPECT_GT(metrics.CounterValue("kvstore_worker_bytes_out_total", kv, -1, worker0), 0);
+    EXPECT_EQ(metrics.HistogramValue("kvstore_ssp_blocked_pull_ns", kv, 0).count(), blocked + 1);
+    EXPECT_EQ(metrics.HistogramValue("kvstore_worker_wait_ns", kv, -1, worker0).count(), waits + 2);
+    kvstore::KVStore::Get().Stop();
+}
+
+}  // namespace
+}  // namespace husky
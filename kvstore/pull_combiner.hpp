@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "core/constants.hpp"
+#include "kvworker.hpp"
+
+namespace kvstore {
+
+class PullCombinerBase {
+   public:
+    virtual ~PullCombinerBase() {}
+};
+
+/*
+ * PullCombiner: merge the concurrent Pull of the worker threads of one process on one kv_id
+ *
+ * The first Pull of a batch waits for window_us, or until max_batch threads have joined,
+ * then sends one Pull with the deduplicated keys of the batch through its own kvworker.
+ * The other threads block until the result arrives and copy their vals from it,
+ * so the servers see one request per batch instead of one per thread.
+ *
+ * Under SSP only the Pull of the same clock are merged: the servers check the progress of
+ * the sender, and a sender ahead of another thread of the batch could wait for that thread.
+ */
+template <typename Val>
+class PullCombiner : public PullCombinerBase {
+    struct Batch {
+        size_t num_joined = 0;
+        std::vector<const std::vector<husky::constants::Key>*> requests;
+        std::vector<husky::constants::Key> keys;  // sorted and deduplicated
+        std::vector<Val> vals;
+        bool done = false;
+        std::condition_variable cond;
+    };
+
+   public:
+    static const int kDefaultWindowUs = 200;
+
+    PullCombiner(int kv_id, size_t max_batch, int window_us = kDefaultWindowUs)
+        : kv_id_(kv_id), max_batch_(max_batch), window_(window_us) {}
+
+    void SetMaxBatch(size_t max_batch) {
+        std::lock_guard<std::mutex> lk(mu_);
+        max_batch_ = max_batch;
+    }
+
+    /*
+     * Pull keys (sorted) into vals, blocks until the vals are ready
+     *
+     * @param clock the clock of the calling thread under SSP, -1 otherwise
+     */
+    void Pull(KVWorker* kvworker, const std::vector<husky::constants::Key>& keys, std::vector<Val>* vals,
+              bool send_all, int clock = -1) {
+        num_pulls_.fetch_add(1, std::memory_order_relaxed);
+        std::unique_lock<std::mutex> lk(mu_);
+        std::shared_ptr<Batch>& open = open_[clock];
+        bool leader = !open;
+        if (leader)
+            open = std::make_shared<Batch>();
+        std::shared_ptr<Batch> batch = open;
+        batch->requests.push_back(&keys);
+        batch->num_joined += 1;
+        if (leader) {
+            batch->cond.wait_for(lk, window_, [this, &batch] { return batch->num_joined >= max_batch_; });
+            open_.erase(clock);  // sealed, the following Pull start a new batch
+            lk.unlock();
+            // the requests stay valid, their threads are waiting for this batch
+            for (auto* request : batch->requests)
+                batch->keys.insert(batch->keys.end(), request->begin(), request->end());
+            std::sort(batch->keys.begin(), batch->keys.end());
+            batch->keys.erase(std::unique(batch->keys.begin(), batch->keys.end()), batch->keys.end());
+            kvworker->Wait(kv_id_, kvworker->Pull(kv_id_, batch->keys, &batch->vals, send_all, true));
+            num_batches_.fetch_add(1, std::memory_order_relaxed);
+            lk.lock();
+            batch->done = true;
+            batch->cond.notify_all();
+        } else {
+            if (batch->num_joined >= max_batch_)
+                batch->cond.notify_all();  // wake up the leader
+            batch->cond.wait(lk, [&batch] { return batch->done; });
+        }
+        lk.unlock();
+
+        // fan out, both keys are sorted
+        vals->resize(keys.size());
+        size_t j = 0;
+        for (size_t i = 0; i < keys.size(); ++ i) {
+            while (batch->keys[j] != keys[i])
+                j += 1;
+            (*vals)[i] = batch->vals[j];
+        }
+    }
+
+    // stats
+    size_t num_pulls() const { return num_pulls_.load(); }
+    size_t num_batches() const { return num_batches_.load(); }
+
+   private:
+    int kv_id_;
+    size_t max_batch_;
+    std::chrono::microseconds window_;
+
+    std::mutex mu_;
+    std::map<int, std::shared_ptr<Batch>> open_;  // {clock, the batch accepting Pull}
+
+    std::atomic<size_t> num_pulls_{0};
+    std::atomic<size_t> num_batches_{0};
+};
+
+}  // namespace kvstore
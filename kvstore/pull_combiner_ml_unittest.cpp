@@ -0,0 +1,119 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <thread>
+
+#include "kvstore/kvstore.hpp"
+
+namespace husky {
+namespace {
+
+class TestPullCombiner: public testing::Test {
+   public:
+    TestPullCombiner() {}
+    ~TestPullCombiner() {}
+
+   protected:
+    void SetUp() {
+        // 1. Create WorkerInfo
+        worker_info.add_worker(0,0,0);
+        worker_info.add_worker(0,1,1);
+        worker_info.set_process_id(0);
+
+        // 2. Create Mailbox
+        el = new MailboxEventLoop(&zmq_context);
+        el->set_process_id(0);
+        recver = new CentralRecver(&zmq_context, "inproc://test");
+    }
+    void TearDown() {
+        delete el;
+        delete recver;
+    }
+
+    WorkerInfo worker_info;
+    zmq::context_t zmq_context;
+    MailboxEventLoop* el;
+    CentralRecver * recver;
+};
+
+TEST_F(TestPullCombiner, MergeOverlappingPulls) {
+    // Start KVStore with 3 servers on each process
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context, 3);
+
+    int kv = kvstore::KVStore::Get().CreateKVStore<float>("default_assign_vector", -1, -1, 9, 2);
+    std::vector<husky::constants::Key> all_keys{0, 1, 2, 3, 4, 5, 6, 7, 8};
+    std::vector<float> all_vals{0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0};
+    auto* kvworker = kvstore::KVStore::Get().get_kvworker(0);
+    kvworker->Wait(kv, kvworker->Push(kv, all_keys, all_vals));
+
+    // a long window, the batch is sent when both kvworkers have joined
+    kvstore::PullCombiner<float> combiner(kv, 2, 10 * 1000 * 1000);
+    std::vector<std::vector<husky::constants::Key>> keys{{0, 2, 4, 8}, {2, 3, 4}};
+    std::vector<std::vector<float>> vals(2);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 2; ++ i) {
+        threads.emplace_back([&, i]() {
+            combiner.Pull(kvstore::KVStore::Get().get_kvworker(i), keys[i], &vals[i], false);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    EXPECT_EQ(vals[0], std::vector<float>({0.0, 2.0, 4.0, 8.0}));
+    EXPECT_EQ(vals[1], std::vector<float>({2.0, 3.0, 4.0}));
+    EXPECT_EQ(combiner.num_pulls(), 2);
+    EXPECT_EQ(combiner.num_batches(), 1);
+
+    // Stop KVStore
+    kvstore::KVStore::Get().Stop();
+}
+
+TEST_F(TestPullCombiner, DifferentClocks) {
+    // Start KVStore
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context);
+
+    int kv = kvstore::KVStore::Get().CreateKVStore<float>("default_assign_map", -1, -1);
+    auto* kvworker = kvstore::KVStore::Get().get_kvworker(0);
+    kvworker->Wait(kv, kvworker->Push(kv, {1, 2}, std::vector<float>{1.0, 2.0}));
+
+    // the Pull of different clocks are never merged, each is sent when its window expires
+    auto* combiner = kvstore::KVStore::Get().GetPullCombiner<float>(kv, 2);
+    std::vector<std::vector<float>> vals(2);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 2; ++ i) {
+        threads.emplace_back([&, i]() {
+            combiner->Pull(kvstore::KVStore::Get().get_kvworker(i), {1, 2}, &vals[i], true, i);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    EXPECT_EQ(vals[0], std::vector<float>({1.0, 2.0}));
+    EXPECT_EQ(vals[1], std::vector<float>({1.0, 2.0}));
+    EXPECT_EQ(combiner->num_batches(), 2);
+
+    // Stop KVStore
+    kvstore::KVStore::Get().Stop();
+}
+
+TEST_F(TestPullCombiner, MaxBatch) {
+    // Start KVStore
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context);
+
+    int kv = kvstore::KVStore::Get().CreateKVStore<float>("default_assign_map", -1, -1);
+    auto* kvworker = kvstore::KVStore::Get().get_kvworker(0);
+    kvworker->Wait(kv, kvworker->Push(kv, {1, 2}, std::vector<float>{1.0, 2.0}));
+
+    // a task with one local thread fills its batch at once, without waiting for the window
+    kvstore::PullCombiner<float> combiner(kv, 2, 10 * 1000 * 1000);
+    combiner.SetMaxBatch(1);
+    std::vector<float> vals;
+    auto start = std::chrono::steady_clock::now();
+    combiner.Pull(kvworker, {1, 2}, &vals, true);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+    EXPECT_EQ(vals, std::vector<float>({1.0, 2.0}));
+
+    // Stop KVStore
+    kvstore::KVStore::Get().Stop();
+}
+
+}  // namespace
+}  // namespace husky
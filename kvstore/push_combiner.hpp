@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "core/constants.hpp"
+#include "flat_map.hpp"
+#include "kvworker.hpp"
+
+namespace kvstore {
+
+class PushCombinerBase {
+   public:
+    virtual ~PushCombinerBase() {}
+};
+
+/*
+ * PushCombiner: sum the Push of the worker threads of one process on one kv_id before sending
+ *
+ * The updates are accumulated in a table sharded by key, so the threads rarely contend,
+ * and the updates to the same key are collapsed into one.
+ * The table is flushed to the servers with ZPush when it holds max_keys keys, when max_delay_us
+ * has passed since the last flush (both checked by Push), or by an explicit Flush at a clock boundary.
+ *
+ * Only for the add kvstores, and for ASP: the servers of SSP/BSP count the pushes of each worker.
+ */
+template <typename Val>
+class PushCombiner : public PushCombinerBase {
+    struct Shard {
+        std::mutex mu;
+        FlatMap<Val> table;
+    };
+
+   public:
+    static const size_t kDefaultMaxKeys = 1 << 16;
+    static const int kDefaultMaxDelayUs = 1000;
+    static const size_t kNumShards = 16;
+
+    PushCombiner(int kv_id, bool send_all = false, size_t max_keys = kDefaultMaxKeys, int max_delay_us = kDefaultMaxDelayUs)
+        : kv_id_(kv_id), send_all_(send_all), max_keys_(max_keys), max_delay_(max_delay_us), shards_(kNumShards),
+          last_flush_(Now()) {}
+
+    /*
+     * Accumulate the updates, and flush through kvworker if a threshold is reached
+     *
+     * @return the ts of the flush, -1 if there is no flush
+     */
+    int Push(KVWorker* kvworker, const std::vector<husky::constants::Key>& keys, const std::vector<Val>& vals) {
+        assert(keys.size() == vals.size());
+        for (size_t i = 0; i < keys.size();) {
+            // a run of keys in the same shard under one lock
+            size_t pos = ShardOf(keys[i]);
+            Shard& shard = shards_[pos];
+            std::lock_guard<std::mutex> lk(shard.mu);
+            size_t old_size = shard.table.size();
+            for (; i < keys.size() && ShardOf(keys[i]) == pos; ++ i)
+                shard.table[keys[i]] += vals[i];
+            num_keys_.fetch_add(shard.table.size() - old_size, std::memory_order_relaxed);
+        }
+        num_pushed_.fetch_add(keys.size(), std::memory_order_relaxed);
+        if (num_keys_.load(std::memory_order_relaxed) < max_keys_ && Now() - last_flush_.load() < max_delay_.count())
+            return -1;
+        std::unique_lock<std::mutex> lk(flush_mu_, std::try_to_lock);
+        if (!lk.owns_lock())  // another thread is flushing
+            return -1;
+        return Flush_(kvworker);
+    }
+
+    /*
+     * Send all the accumulated updates through kvworker, e.g. at the end of a clock
+     *
+     * @return the ts of the flush, -1 if there is nothing to send
+     */
+    int Flush(KVWorker* kvworker) {
+        std::lock_guard<std::mutex> lk(flush_mu_);
+        return Flush_(kvworker);
+    }
+
+    // stats
+    size_t num_pushed() const { return num_pushed_.load(); }    // the updates received
+    size_t num_flushed() const { return num_flushed_.load(); }  // the updates sent to the servers
+
+   private:
+    // blocks of consecutive keys share a shard, so a sorted Push takes few locks
+    static size_t ShardOf(husky::constants::Key key) { return (key >> 6) % kNumShards; }
+
+    static int64_t Now() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    int Flush_(KVWorker* kvworker) {
+        std::vector<std::pair<husky::constants::Key, Val>> kvs;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lk(shard.mu);
+            shard.table.for_each([&kvs](husky::constants::Key key, const Val& val) { kvs.emplace_back(key, val); });
+            num_keys_.fetch_sub(shard.table.size(), std::memory_order_relaxed);
+            shard.table.clear();
+        }
+        last_flush_.store(Now());
+        if (kvs.empty())
+            return -1;
+        std::sort(kvs.begin(), kvs.end(),
+                  [](const std::pair<husky::constants::Key, Val>& a, const std::pair<husky::constants::Key, Val>& b) {
+                      return a.first < b.first;
+                  });
+        pslite::SArray<husky::constants::Key> keys(kvs.size());
+        pslite::SArray<Val> vals(kvs.size());
+        for (size_t i = 0; i < kvs.size(); ++ i) {
+            keys[i] = kvs[i].first;
+            vals[i] = kvs[i].second;
+        }
+        num_flushed_.fetch_add(kvs.size(), std::memory_order_relaxed);
+        return kvworker->ZPush(kv_id_, keys, vals, send_all_);
+    }
+
+    int kv_id_;
+    bool send_all_;
+    size_t max_keys_;
+    std::chrono::microseconds max_delay_;
+
+    std::vector<Shard> shards_;
+    std::mutex flush_mu_;  // one flush at a time
+    std::atomic<size_t> num_keys_{0};
+    std::atomic<int64_t> last_flush_;
+
+    std::atomic<size_t> num_pushed_{0};
+    std::atomic<size_t> num_flushed_{0};
+};
+
+}  // namespace kvstore
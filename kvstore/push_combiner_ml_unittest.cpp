@@ -0,0 +1,92 @@
+#include "gtest/gtest.h"
+
+#include <thread>
+
+#include "kvstore/kvstore.hpp"
+
+namespace husky {
+namespace {
+
+class TestPushCombiner: public testing::Test {
+   public:
+    TestPushCombiner() {}
+    ~TestPushCombiner() {}
+
+   protected:
+    void SetUp() {
+        // 1. Create WorkerInfo
+        worker_info.add_worker(0,0,0);
+        worker_info.add_worker(0,1,1);
+        worker_info.set_process_id(0);
+
+        // 2. Create Mailbox
+        el = new MailboxEventLoop(&zmq_context);
+        el->set_process_id(0);
+        recver = new CentralRecver(&zmq_context, "inproc://test");
+    }
+    void TearDown() {
+        delete el;
+        delete recver;
+    }
+
+    WorkerInfo worker_info;
+    zmq::context_t zmq_context;
+    MailboxEventLoop* el;
+    CentralRecver * recver;
+};
+
+TEST_F(TestPushCombiner, CollapseUpdates) {
+    // Start KVStore with 3 servers on each process
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context, 3);
+
+    int kv = kvstore::KVStore::Get().CreateKVStore<float>("default_add_vector", -1, -1, 9, 2);
+    // no flush by size or time
+    kvstore::PushCombiner<float> combiner(kv, false, 1000, 1000 * 1000 * 1000);
+    std::vector<husky::constants::Key> keys{0, 4, 8};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 2; ++ i) {
+        threads.emplace_back([&, i]() {
+            auto* kvworker = kvstore::KVStore::Get().get_kvworker(i);
+            for (int j = 0; j < 100; ++ j)
+                EXPECT_EQ(combiner.Push(kvworker, keys, std::vector<float>{1.0, 2.0, 3.0}), -1);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    auto* kvworker = kvstore::KVStore::Get().get_kvworker(0);
+    int ts = combiner.Flush(kvworker);
+    EXPECT_NE(ts, -1);
+    kvworker->Wait(kv, ts);
+    EXPECT_EQ(combiner.num_pushed(), 600);
+    EXPECT_EQ(combiner.num_flushed(), 3);  // one update per key
+    std::vector<float> res;
+    kvworker->Wait(kv, kvworker->Pull(kv, keys, &res));
+    EXPECT_EQ(res, std::vector<float>({200.0, 400.0, 600.0}));
+    EXPECT_EQ(combiner.Flush(kvworker), -1);  // nothing left
+
+    // Stop KVStore
+    kvstore::KVStore::Get().Stop();
+}
+
+TEST_F(TestPushCombiner, FlushBySize) {
+    // Start KVStore
+    kvstore::KVStore::Get().Start(worker_info, el, &zmq_context);
+
+    int kv = kvstore::KVStore::Get().CreateKVStore<float>("default_add_vector", -1, -1, 100, 2);
+    kvstore::PushCombiner<float> combiner(kv, false, 4, 1000 * 1000 * 1000);
+    auto* kvworker = kvstore::KVStore::Get().get_kvworker(0);
+    EXPECT_EQ(combiner.Push(kvworker, {1, 2, 3}, std::vector<float>{1.0, 1.0, 1.0}), -1);
+    EXPECT_EQ(combiner.Push(kvworker, {1, 2, 3}, std::vector<float>{1.0, 1.0, 1.0}), -1);  // still 3 keys
+    int ts = combiner.Push(kvworker, {70}, std::vector<float>{1.0});  // 4 keys, in another shard
+    EXPECT_NE(ts, -1);
+    kvworker->Wait(kv, ts);
+    std::vector<float> res;
+    kvworker->Wait(kv, kvworker->Pull(kv, {1, 2, 3, 70}, &res));
+    EXPECT_EQ(res, std::vector<float>({2.0, 2.0, 2.0, 1.0}));
+
+    // Stop KVStore
+    kvstore::KVStore::Get().Stop();
+}
+
+}  // namespace
+}  // namespace husky
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "husky/base/serialization.hpp"
+#include "kvstore/ps_lite/sarray.h"
+
+namespace kvstore {
+
+/*
+ * Serialization of the SArray payloads of Push/Pull, so that the receiver can use them in place
+ *
+ * Format: size, pad (uint8_t), pad bytes, data
+ * The pad aligns data to alignof(V) from the beginning of the message. The received message
+ * starts at the beginning of its own buffer, so the data are aligned there as well and
+ * ViewSArray/ShareSArray alias them instead of copying. If not (e.g. the message was sliced
+ * at an odd offset), they fall back to a copy.
+ */
+template <typename V>
+void WriteSArray(husky::base::BinStream& bin, const pslite::SArray<V>& sarray) {
+    static const char zeros[alignof(V)] = {};
+    bin << sarray.size();
+    size_t offset = bin.size() + sizeof(uint8_t);  // a message being written is never popped
+    uint8_t pad = (alignof(V) - offset % alignof(V)) % alignof(V);
+    bin << pad;
+    bin.push_back_bytes(zeros, pad);
+    bin.push_back_bytes(reinterpret_cast<const char*>(sarray.data()), sarray.size() * sizeof(V));
+}
+
+// the common part of ViewSArray/ShareSArray, deleter keeps the message alive
+template <typename V, typename Deleter>
+void ReadSArray_(husky::base::BinStream& bin, pslite::SArray<V>* sarray, const Deleter& deleter) {
+    size_t size;
+    uint8_t pad;
+    bin >> size >> pad;
+    if (pad != 0)
+        bin.pop_front_bytes(pad);
+    if (size == 0) {
+        *sarray = pslite::SArray<V>();
+        return;
+    }
+    V* data = static_cast<V*>(bin.pop_front_bytes(size * sizeof(V)));
+    if (reinterpret_cast<std::uintptr_t>(data) % alignof(V) != 0) {
+        sarray->CopyFrom(data, size);
+        return;
+    }
+    sarray->reset(data, size, deleter);
+}
+
+/*
+ * Read an SArray written by WriteSArray without copying
+ *
+ * The SArray points into bin, so it is only valid while bin is alive.
+ * For the payloads consumed while handling the message.
+ */
+template <typename V>
+void ViewSArray(husky::base::BinStream& bin, pslite::SArray<V>* sarray) {
+    ReadSArray_(bin, sarray, [](V*) {});
+}
+
+/*
+ * Read an SArray written by WriteSArray without copying, the SArray shares the ownership of bin
+ *
+ * For the payloads kept after the message is handled, e.g. the replies of a Pull
+ * waiting for the other servers.
+ */
+template <typename V>
+void ShareSArray(const std::shared_ptr<husky::base::BinStream>& bin, pslite::SArray<V>* sarray) {
+    ReadSArray_(*bin, sarray, [bin](V*) {});
+}
+
+}  // namespace kvstore
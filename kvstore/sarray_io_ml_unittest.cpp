@@ -0,0 +1,64 @@
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <vector>
+
+#include "core/constants.hpp"
+#include "kvstore/sarray_io.hpp"
+
+namespace husky {
+namespace {
+
+class TestSArrayIO: public testing::Test {
+   public:
+    TestSArrayIO() {}
+    ~TestSArrayIO() {}
+};
+
+TEST_F(TestSArrayIO, ViewInPlace) {
+    std::vector<husky::constants::Key> keys{1, 3, 5};
+    std::vector<float> vals{0.1, 0.3, 0.5};
+    base::BinStream bin;
+    bin << 1 << true;  // an odd header, as the kv_id, ts, cmd, push of a request
+    kvstore::WriteSArray(bin, kvstore::pslite::SArray<husky::constants::Key>(keys));
+    kvstore::WriteSArray(bin, kvstore::pslite::SArray<float>(vals));
+    kvstore::WriteSArray(bin, kvstore::pslite::SArray<float>());
+
+    int header;
+    bool flag;
+    bin >> header >> flag;
+    const char* begin = bin.get_remained_buffer();
+    kvstore::pslite::SArray<husky::constants::Key> recv_keys;
+    kvstore::pslite::SArray<float> recv_vals, empty;
+    kvstore::ViewSArray(bin, &recv_keys);
+    kvstore::ViewSArray(bin, &recv_vals);
+    kvstore::ViewSArray(bin, &empty);
+    EXPECT_EQ(bin.size(), 0);
+    EXPECT_EQ(std::vector<husky::constants::Key>(recv_keys.begin(), recv_keys.end()), keys);
+    EXPECT_EQ(std::vector<float>(recv_vals.begin(), recv_vals.end()), vals);
+    EXPECT_TRUE(empty.empty());
+    // aligned and not copied
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(recv_keys.data()) % alignof(husky::constants::Key), 0);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(recv_vals.data()) % alignof(float), 0);
+    EXPECT_GT(reinterpret_cast<const char*>(recv_keys.data()), begin);
+    EXPECT_LT(reinterpret_cast<const char*>(recv_vals.data()), begin + 64);
+}
+
+TEST_F(TestSArrayIO, ShareOwnership) {
+    std::vector<float> vals{1.0, 2.0, 3.0, 4.0};
+    kvstore::pslite::SArray<float> recv_vals;
+    {
+        base::BinStream bin;
+        bin << 7;
+        kvstore::WriteSArray(bin, kvstore::pslite::SArray<float>(vals));
+        auto owner = std::make_shared<base::BinStream>(std::move(bin));
+        int header;
+        *owner >> header;
+        kvstore::ShareSArray(owner, &recv_vals);
+    }
+    // the message is kept alive by recv_vals
+    EXPECT_EQ(std::vector<float>(recv_vals.begin(), recv_vals.end()), vals);
+}
+
+}  // namespace
+}  // namespace husky
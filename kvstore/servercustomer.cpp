@@ -2,6 +2,8 @@
 
 namespace kvstore {
 
+thread_local Metrics::Counter* ServerCustomer::bytes_out_counter_ = nullptr;
+
 void ServerCustomer::Start() {
     // spawn a new thread to recevive
     recv_thread_ = std::unique_ptr<std::thread>(new std::thread(&ServerCustomer::Receiving, this));
@@ -13,7 +15,12 @@ void ServerCustomer::Stop() {
     recv_thread_->join();
 }
 
-void ServerCustomer::send(int dst, husky::base::BinStream& bin) { mailbox_.send(dst, channel_id_, 0, bin); }
+void ServerCustomer::send(int dst, husky::base::BinStream& bin) {
+    if (bytes_out_counter_)
+        bytes_out_counter_->Add(bin.size());
+    std::lock_guard<std::mutex> lk(send_mu_);
+    mailbox_.send(dst, channel_id_, 0, bin);
+}
 
 void ServerCustomer::Receiving() {
     // poll and recv from mailbox
@@ -23,7 +30,7 @@ void ServerCustomer::Receiving() {
         if (bin.size() == 0) {
             break;
         }
-        // Format: kv_id, ts, cmd, push, src, data
+        // Format: kv_id, ts, server_id, cmd, push, src, data
         int kv_id;
         int ts;
         bin >> kv_id >> ts;
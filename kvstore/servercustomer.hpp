@@ -7,6 +7,7 @@
 #include "base/serialization.hpp"
 #include "core/mailbox.hpp"
 #include "husky/base/log.hpp"
+#include "kvstore/metrics.hpp"
 
 namespace kvstore {
 
@@ -27,7 +28,15 @@ class ServerCustomer {
     void Stop();
     void send(int dst, husky::base::BinStream& bin);
 
+    /*
+     * The bytes sent by this thread are added to counter (if not nullptr), set around the handling
+     * of a request so that the replies are accounted to its kv_id and server_id
+     */
+    static void SetBytesOutCounter(Metrics::Counter* counter) { bytes_out_counter_ = counter; }
+
    private:
+    static thread_local Metrics::Counter* bytes_out_counter_;
+
     void Receiving();
 
     // mailbox
@@ -37,6 +46,9 @@ class ServerCustomer {
     RecvHandle recv_handle_;
     std::unique_ptr<std::thread> recv_thread_;
 
+    // shard threads of KVManager may send concurrently
+    std::mutex send_mu_;
+
     // some info
     int channel_id_;
 };
@@ -0,0 +1,288 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "core/constants.hpp"
+#include "husky/base/exception.hpp"
+#include "husky/base/serialization.hpp"
+#include "kvstore/flat_map.hpp"
+#include "kvstore/key_codec.hpp"
+#include "kvstore/kvpairs.hpp"
+#include "kvstore/ps_lite/sarray.h"
+
+namespace kvstore {
+
+/*
+ * The lossy compression of the values in Push
+ *
+ * kRaw: no compression
+ * kFP16: IEEE half precision
+ * kBF16: bfloat16, the upper 16 bits of float
+ * kInt8: 8-bit stochastic quantization, scaled by the max absolute value of each message
+ * kTopK: only the topk_ratio of the values with the largest magnitude are sent
+ *
+ * The part that is not sent is kept in a residual buffer in the kvworker and added to the next Push
+ * of the same key (error feedback), so no update is lost, only delayed.
+ */
+enum class ValCodec : uint8_t {
+    kRaw = 0,
+    kFP16 = 1,
+    kBF16 = 2,
+    kInt8 = 3,
+    kTopK = 4
+};
+
+struct PushCompression {
+    ValCodec codec = ValCodec::kRaw;
+    float topk_ratio = 0.01;  // for kTopK
+};
+
+struct PushCompressionStats {
+    size_t raw_bytes = 0;         // bytes of keys and vals before compression
+    size_t compressed_bytes = 0;  // bytes of keys and vals sent
+    double ratio() const { return compressed_bytes == 0 ? 1.0 : static_cast<double>(raw_bytes) / compressed_bytes; }
+};
+
+namespace val_codec {
+
+inline uint16_t FloatToHalf(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t mant = x & 0x7fffff;
+    int exp = (x >> 23) & 0xff;
+    if (exp == 0xff)  // inf or nan
+        return sign | 0x7c00 | (mant ? 0x200 : 0);
+    int e = exp - 127 + 15;
+    if (e >= 0x1f)  // overflow
+        return sign | 0x7c00;
+    if (e <= 0) {  // subnormal
+        if (e < -10)
+            return sign;
+        mant |= 0x800000;
+        int shift = 14 - e;
+        uint32_t half_mant = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (half_mant & 1)))
+            half_mant += 1;
+        return sign | half_mant;
+    }
+    uint32_t half = sign | (e << 10) | (mant >> 13);
+    uint32_t rem = mant & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1)))  // round to nearest even, may carry into the exponent
+        half += 1;
+    return half;
+}
+
+inline float HalfToFloat(uint16_t h) {
+    uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    int exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t x;
+    if (exp == 0) {
+        if (mant == 0) {
+            x = sign;
+        } else {  // subnormal, normalize it
+            exp = 1;
+            while (!(mant & 0x400)) {
+                mant <<= 1;
+                exp -= 1;
+            }
+            mant &= 0x3ff;
+            x = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+        }
+    } else if (exp == 0x1f) {
+        x = sign | 0x7f800000 | (mant << 13);
+    } else {
+        x = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    }
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+inline uint16_t FloatToBF16(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    if ((x & 0x7fffffff) > 0x7f800000)  // nan
+        return ((x >> 16) & 0x8000) | 0x7fc0;
+    x += 0x7fff + ((x >> 16) & 1);  // round to nearest even
+    return x >> 16;
+}
+
+inline float BF16ToFloat(uint16_t h) {
+    uint32_t x = static_cast<uint32_t>(h) << 16;
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+/*
+ * Return the sorted positions of the k values with the largest magnitude
+ */
+template <typename Val>
+std::vector<size_t> SelectTopK(const Val* vals, size_t n, size_t k) {
+    std::vector<size_t> idx(n);
+    for (size_t i = 0; i < n; ++ i)
+        idx[i] = i;
+    if (k < n) {
+        std::nth_element(idx.begin(), idx.begin() + k, idx.end(),
+                         [vals](size_t a, size_t b) { return std::abs(vals[a]) > std::abs(vals[b]); });
+        idx.resize(k);
+        std::sort(idx.begin(), idx.end());
+    }
+    return idx;
+}
+
+}  // namespace val_codec
+
+/*
+ * Encode vals into bin with codec, decoded (if not nullptr) is filled with the values the receiver will get
+ *
+ * kTopK is encoded as kRaw, the selection is done by PushCompressor
+ * Format: codec, size, data (kInt8: codec, size, scale, data)
+ */
+template <typename Val>
+void EncodeVals(ValCodec codec, const Val* vals, size_t n, husky::base::BinStream& bin, std::mt19937* gen, Val* decoded) {
+    using namespace val_codec;
+    if (codec == ValCodec::kTopK)
+        codec = ValCodec::kRaw;
+    bin << static_cast<uint8_t>(codec) << n;
+    if (codec == ValCodec::kRaw) {
+        bin.push_back_bytes(reinterpret_cast<const char*>(vals), n * sizeof(Val));
+        if (decoded)
+            std::copy(vals, vals + n, decoded);
+        return;
+    }
+    if (!std::is_floating_point<Val>::value)
+        throw husky::base::HuskyException("Lossy compression only supports floating point values");
+    if (codec == ValCodec::kFP16 || codec == ValCodec::kBF16) {
+        std::vector<uint16_t> buf(n);
+        for (size_t i = 0; i < n; ++ i) {
+            buf[i] = codec == ValCodec::kFP16 ? FloatToHalf(vals[i]) : FloatToBF16(vals[i]);
+            if (decoded)
+                decoded[i] = codec == ValCodec::kFP16 ? HalfToFloat(buf[i]) : BF16ToFloat(buf[i]);
+        }
+        bin.push_back_bytes(reinterpret_cast<const char*>(buf.data()), n * sizeof(uint16_t));
+    } else if (codec == ValCodec::kInt8) {
+        float scale = 0;
+        for (size_t i = 0; i < n; ++ i)
+            scale = std::max(scale, static_cast<float>(std::abs(vals[i])));
+        std::vector<int8_t> buf(n, 0);
+        std::uniform_real_distribution<float> dist(0, 1);
+        for (size_t i = 0; i < n; ++ i) {
+            if (scale > 0) {
+                float q = std::floor(static_cast<float>(vals[i]) / scale * 127 + dist(*gen));  // stochastic rounding
+                buf[i] = static_cast<int8_t>(std::max(-127.f, std::min(127.f, q)));
+            }
+            if (decoded)
+                decoded[i] = buf[i] * scale / 127;
+        }
+        bin << scale;
+        bin.push_back_bytes(reinterpret_cast<const char*>(buf.data()), n * sizeof(int8_t));
+    } else {
+        throw husky::base::HuskyException("Unknown val codec " + std::to_string(static_cast<int>(codec)));
+    }
+}
+
+/*
+ * Decode the vals encoded by EncodeVals from bin
+ */
+template <typename Val>
+void DecodeVals(husky::base::BinStream& bin, pslite::SArray<Val>* vals) {
+    using namespace val_codec;
+    uint8_t codec;
+    size_t n;
+    bin >> codec >> n;
+    vals->resize(n);
+    Val* out = vals->data();
+    if (static_cast<ValCodec>(codec) == ValCodec::kRaw) {
+        memcpy(out, bin.pop_front_bytes(n * sizeof(Val)), n * sizeof(Val));
+    } else if (static_cast<ValCodec>(codec) == ValCodec::kFP16 || static_cast<ValCodec>(codec) == ValCodec::kBF16) {
+        const uint16_t* p = reinterpret_cast<const uint16_t*>(bin.pop_front_bytes(n * sizeof(uint16_t)));
+        for (size_t i = 0; i < n; ++ i) {
+            uint16_t h;
+            memcpy(&h, p + i, sizeof(h));
+            out[i] = static_cast<ValCodec>(codec) == ValCodec::kFP16 ? HalfToFloat(h) : BF16ToFloat(h);
+        }
+    } else if (static_cast<ValCodec>(codec) == ValCodec::kInt8) {
+        float scale;
+        bin >> scale;
+        const int8_t* p = reinterpret_cast<const int8_t*>(bin.pop_front_bytes(n * sizeof(int8_t)));
+        for (size_t i = 0; i < n; ++ i) {
+            out[i] = p[i] * scale / 127;
+        }
+    } else {
+        throw husky::base::HuskyException("Unknown val codec " + std::to_string(static_cast<int>(codec)));
+    }
+}
+
+struct PushCompressorBase {
+    virtual ~PushCompressorBase() {}
+    PushCompressionStats stats;
+};
+
+/*
+ * PushCompressor: compress the Push of one kv_id in one kvworker with error feedback
+ */
+template <typename Val>
+class PushCompressor : public PushCompressorBase {
+   public:
+    explicit PushCompressor(const PushCompression& config) : config_(config), gen_(std::random_device()()) {}
+
+    /*
+     * Encode the keys and compressed vals of kvs into bin, and update the residual
+     */
+    void Compress(const KVPairs<Val>& kvs, KeyCodec key_codec, husky::base::BinStream& bin) {
+        size_t n = kvs.keys.size();
+        size_t begin_size = bin.size();
+        // 1. add the residual
+        std::vector<Val> corrected(n);
+        for (size_t i = 0; i < n; ++ i) {
+            Val* r = residual_.find(kvs.keys[i]);
+            corrected[i] = kvs.vals[i] + (r ? *r : Val());
+        }
+        // 2. select the values to send
+        pslite::SArray<husky::constants::Key> keys;
+        std::vector<Val> vals;
+        if (config_.codec == ValCodec::kTopK) {
+            size_t k = std::max<size_t>(1, std::ceil(config_.topk_ratio * n));
+            std::vector<size_t> idx = val_codec::SelectTopK(corrected.data(), n, k);
+            keys.resize(idx.size());
+            vals.resize(idx.size());
+            for (size_t i = 0; i < idx.size(); ++ i) {
+                keys[i] = kvs.keys[idx[i]];
+                vals[i] = corrected[idx[i]];
+            }
+            for (size_t i = 0; i < n; ++ i)  // the values not sent go to the residual
+                residual_[kvs.keys[i]] = corrected[i];
+        } else {
+            keys = kvs.keys;
+            vals = std::move(corrected);
+        }
+        // 3. encode and keep the error as residual
+        std::vector<Val> decoded(vals.size());
+        EncodeKeys(key_codec, keys, bin);
+        EncodeVals(config_.codec, vals.data(), vals.size(), bin, &gen_, decoded.data());
+        for (size_t i = 0; i < keys.size(); ++ i)
+            residual_[keys[i]] = vals[i] - decoded[i];
+
+        stats.raw_bytes += n * (sizeof(husky::constants::Key) + sizeof(Val));
+        stats.compressed_bytes += bin.size() - begin_size;
+    }
+
+   private:
+    PushCompression config_;
+    std::mt19937 gen_;
+    FlatMap<Val> residual_;  // {key, error not sent yet}
+};
+
+}  // namespace kvstore
@@ -0,0 +1,140 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "kvstore/val_codec.hpp"
+
+namespace husky {
+namespace {
+
+using Key = husky::constants::Key;
+
+class TestValCodec: public testing::Test {
+   public:
+    TestValCodec() {}
+    ~TestValCodec() {}
+
+   protected:
+    void SetUp() {}
+    void TearDown() {}
+};
+
+TEST_F(TestValCodec, Half) {
+    using namespace kvstore::val_codec;
+    for (float f : {0.f, -0.f, 1.f, -2.5f, 0.1f, 65504.f, 6.1035156e-05f, 5.9604645e-08f, 1e-3f}) {
+        EXPECT_NEAR(HalfToFloat(FloatToHalf(f)), f, std::abs(f) / 1024 + 1e-8);
+    }
+    EXPECT_EQ(FloatToHalf(1.f), 0x3c00);
+    EXPECT_EQ(FloatToHalf(-2.f), 0xc000);
+    EXPECT_EQ(FloatToHalf(65504.f), 0x7bff);
+    EXPECT_EQ(FloatToHalf(1e6f), 0x7c00);  // overflow to inf
+    EXPECT_EQ(FloatToHalf(5.9604645e-08f), 0x0001);  // smallest subnormal
+    EXPECT_TRUE(std::isnan(HalfToFloat(FloatToHalf(std::nanf("")))));
+}
+
+TEST_F(TestValCodec, BF16) {
+    using namespace kvstore::val_codec;
+    for (float f : {0.f, 1.f, -3.75f, 0.1f, 1e30f, -1e-30f}) {
+        EXPECT_NEAR(BF16ToFloat(FloatToBF16(f)), f, std::abs(f) / 128);
+    }
+    EXPECT_EQ(FloatToBF16(1.f), 0x3f80);
+}
+
+TEST_F(TestValCodec, EncodeDecode) {
+    std::mt19937 gen(0);
+    std::vector<float> vals{0.5, -0.25, 0.1, 3.0, -7.5, 0.0};
+    for (auto codec : {kvstore::ValCodec::kRaw, kvstore::ValCodec::kFP16, kvstore::ValCodec::kBF16,
+                       kvstore::ValCodec::kInt8, kvstore::ValCodec::kTopK}) {
+        base::BinStream bin;
+        std::vector<float> decoded(vals.size());
+        kvstore::EncodeVals(codec, vals.data(), vals.size(), bin, &gen, decoded.data());
+        kvstore::pslite::SArray<float> res;
+        kvstore::DecodeVals(bin, &res);
+        EXPECT_EQ(bin.size(), 0);
+        ASSERT_EQ(res.size(), vals.size());
+        for (size_t i = 0; i < vals.size(); ++ i) {
+            EXPECT_EQ(res[i], decoded[i]);  // the sender knows exactly what the receiver gets
+            EXPECT_NEAR(res[i], vals[i], 7.5 / 127 + 1e-6);
+        }
+    }
+}
+
+/*
+ * With error feedback, what is sent plus the residual equals what is pushed
+ */
+void TestErrorFeedback(kvstore::PushCompression compression) {
+    kvstore::PushCompressor<float> compressor(compression);
+    std::vector<Key> keys{1, 3, 4, 8, 9, 10, 20, 30};
+    std::vector<float> pushed(keys.size(), 0.0), received(31, 0.0);
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    for (int iter = 0; iter < 50; ++ iter) {
+        kvstore::KVPairs<float> kvs;
+        kvs.keys = kvstore::pslite::SArray<Key>(keys);
+        std::vector<float> vals(keys.size());
+        for (size_t i = 0; i < keys.size(); ++ i) {
+            vals[i] = dist(gen);
+            pushed[i] += vals[i];
+        }
+        kvs.vals = kvstore::pslite::SArray<float>(vals);
+        base::BinStream bin;
+        compressor.Compress(kvs, kvstore::KeyCodec::kDeltaVarint, bin);
+        kvstore::pslite::SArray<Key> recv_keys;
+        kvstore::pslite::SArray<float> recv_vals;
+        kvstore::DecodeKeys(bin, &recv_keys);
+        kvstore::DecodeVals(bin, &recv_vals);
+        ASSERT_EQ(recv_keys.size(), recv_vals.size());
+        for (size_t i = 0; i < recv_keys.size(); ++ i)
+            received[recv_keys[i]] += recv_vals[i];
+    }
+    // the residual is bounded by one round of error, so the totals stay close
+    for (size_t i = 0; i < keys.size(); ++ i) {
+        EXPECT_NEAR(received[keys[i]], pushed[i], 8.0) << "codec " << static_cast<int>(compression.codec);
+    }
+    auto stats = compressor.stats;
+    EXPECT_EQ(stats.raw_bytes, 50 * keys.size() * (sizeof(Key) + sizeof(float)));
+    EXPECT_GT(stats.ratio(), 1.0);
+}
+
+TEST_F(TestValCodec, ErrorFeedback) {
+    kvstore::PushCompression compression;
+    for (auto codec : {kvstore::ValCodec::kFP16, kvstore::ValCodec::kBF16, kvstore::ValCodec::kInt8}) {
+        compression.codec = codec;
+        TestErrorFeedback(compression);
+    }
+    compression.codec = kvstore::ValCodec::kTopK;
+    compression.topk_ratio = 0.25;
+    TestErrorFeedback(compression);
+}
+
+TEST_F(TestValCodec, TopK) {
+    kvstore::PushCompression compression;
+    compression.codec = kvstore::ValCodec::kTopK;
+    compression.topk_ratio = 0.5;
+    kvstore::PushCompressor<float> compressor(compression);
+    kvstore::KVPairs<float> kvs;
+    kvs.keys = kvstore::pslite::SArray<Key>(std::vector<Key>{0, 1, 2, 3});
+    kvs.vals = kvstore::pslite::SArray<float>(std::vector<float>{0.1, -5.0, 0.2, 3.0});
+    base::BinStream bin;
+    compressor.Compress(kvs, kvstore::KeyCodec::kRaw, bin);
+    kvstore::pslite::SArray<Key> keys;
+    kvstore::pslite::SArray<float> vals;
+    kvstore::DecodeKeys(bin, &keys);
+    kvstore::DecodeVals(bin, &vals);
+    EXPECT_EQ(std::vector<Key>(keys.begin(), keys.end()), std::vector<Key>({1, 3}));
+    EXPECT_EQ(std::vector<float>(vals.begin(), vals.end()), std::vector<float>({-5.0, 3.0}));
+
+    // the residual of key 0 and 2 is sent next time
+    kvs.vals = kvstore::pslite::SArray<float>(std::vector<float>{0.0, 0.0, 0.0, 0.0});
+    base::BinStream bin2;
+    compressor.Compress(kvs, kvstore::KeyCodec::kRaw, bin2);
+    kvstore::DecodeKeys(bin2, &keys);
+    kvstore::DecodeVals(bin2, &vals);
+    EXPECT_EQ(std::vector<Key>(keys.begin(), keys.end()), std::vector<Key>({0, 2}));
+    EXPECT_EQ(std::vector<float>(vals.begin(), vals.end()), std::vector<float>({0.1, 0.2}));
+}
+
+}  // namespace
+}  // namespace husky
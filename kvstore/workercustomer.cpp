@@ -1,5 +1,7 @@
 #include "kvstore/workercustomer.hpp"
 
+#include "core/tracer.hpp"
+
 namespace kvstore {
 
 void WorkerCustomer::Start() {
@@ -13,21 +15,37 @@ void WorkerCustomer::Stop() {
 }
 
 int WorkerCustomer::NewRequest(int kv_id, int num_responses) {
-    std::lock_guard<std::mutex> lk(tracker_mu_);
-    if (kv_id >= tracker_.size())
-        tracker_.resize(kv_id + 1);
-    tracker_[kv_id].push_back({num_responses, 0});
-    return tracker_[kv_id].size() - 1;
+    int ts = next_ts_.fetch_add(1) & 0x7fffffff;  // server_push_ts_ is never used
+    Slot& slot = slots_[ts % kNumSlots];
+    // wait if the request kNumSlots before is still in flight
+    WaitSlot(slot, [&slot] { return slot.current.load() == slot.expected.load(); });
+    slot.ts.store(ts);  // first, so that the waiters of the old request see it done
+    slot.current.store(0);
+    slot.expected.store(num_responses);
+    if (husky::Tracer::Enabled() && husky::Tracer::Get().SampleId(ts))
+        husky::Tracer::Get().AsyncBegin("request", "kvworker", TraceId(ts), "kv_id", kv_id);
+    return ts;
 }
 void WorkerCustomer::WaitRequest(int kv_id, int timestamp) {
-    std::unique_lock<std::mutex> lk(tracker_mu_);
-    tracker_cond_.wait(lk, [this, kv_id, timestamp] {
-        return tracker_[kv_id][timestamp].first == tracker_[kv_id][timestamp].second;
-    });
+    Slot& slot = slots_[timestamp % kNumSlots];
+    auto done = [&slot, timestamp] {
+        return slot.ts.load() != timestamp || slot.current.load() == slot.expected.load();
+    };
+    WaitSlot(slot, done);
+}
+void WorkerCustomer::WaitSlot(Slot& slot, const std::function<bool()>& done) {
+    if (done())
+        return;
+    std::unique_lock<std::mutex> lk(slot.mu);
+    slot.num_waiters.fetch_add(1);  // seen by the receiving thread, or done() sees its response
+    slot.cond.wait(lk, done);
+    slot.num_waiters.fetch_sub(1);
 }
 int WorkerCustomer::NumResponse(int kv_id, int timestamp) {
-    std::lock_guard<std::mutex> lk(tracker_mu_);
-    return tracker_[kv_id][timestamp].second;
+    Slot& slot = slots_[timestamp % kNumSlots];
+    if (slot.ts.load() != timestamp)  // the slot is reused, so the request is done
+        return -1;
+    return slot.current.load();
 }
 void WorkerCustomer::send(int dst, husky::base::BinStream& bin) { mailbox_.send(dst, channel_id_, 0, bin); }
 
@@ -43,16 +61,22 @@ void WorkerCustomer::Receiving() {
         int kv_id;
         int ts;
         bin >> kv_id >> ts;
-        tracker_mu_.lock();
-        bool runCallback = tracker_[kv_id][ts].second == tracker_[kv_id][ts].first - 1 ? true : false;
-        tracker_mu_.unlock();
+        if (ts == server_push_ts_) {  // not a response, nothing to track
+            recv_handle_(kv_id, ts, bin, false);
+            continue;
+        }
+        Slot& slot = slots_[ts % kNumSlots];
+        int expected = slot.expected.load();
+        bool runCallback = slot.current.load() == expected - 1;
         // invoke the callback
         recv_handle_(kv_id, ts, bin, runCallback);
-        {
-            std::lock_guard<std::mutex> lk(tracker_mu_);
-            tracker_[kv_id][ts].second += 1;
-            if (tracker_[kv_id][ts].second == tracker_[kv_id][ts].first)
-                tracker_cond_.notify_all();
+        bool done = slot.current.fetch_add(1) + 1 == expected;
+        if (done && husky::Tracer::Enabled() && husky::Tracer::Get().SampleId(ts))
+            husky::Tracer::Get().AsyncEnd("request", "kvworker", TraceId(ts));
+        if (done && slot.num_waiters.load() > 0) {
+            // take the slot lock so that a waiter can't miss the notification
+            std::lock_guard<std::mutex> lk(slot.mu);
+            slot.cond.notify_all();
         }
     }
 }
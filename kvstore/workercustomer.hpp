@@ -1,7 +1,9 @@
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include "base/serialization.hpp"
@@ -36,10 +38,20 @@ class WorkerCustomer {
     void Start();
     void Stop();
 
+    /*
+     * The requests are tracked in a fixed table of kNumSlots slots, the request with timestamp ts
+     * uses slot ts % kNumSlots. A slot is free again once all the responses of its request arrive,
+     * so WaitRequest on an old timestamp whose slot is reused returns directly.
+     * NewRequest blocks if kNumSlots requests are still in flight.
+     * Timestamps are unique among all kv_ids of the customer.
+     */
     int NewRequest(int kv_id, int num_responses);
     void WaitRequest(int kv_id, int timestamp);
     int NumResponse(int kv_id, int timestamp);
     void send(int dst, husky::base::BinStream& bin); 
+
+    // ts of the messages initiated by the servers (e.g. Eager SSP), they don't belong to any request
+    static const int server_push_ts_ = -1;
    private:
     void Receiving();
 
@@ -51,9 +63,23 @@ class WorkerCustomer {
     std::unique_ptr<std::thread> recv_thread_;
 
     // tracker
-    std::mutex tracker_mu_;
-    std::condition_variable tracker_cond_;
-    std::vector<std::vector<std::pair<int, int>>> tracker_;  // kv_id, ts, <expected, current>
+    struct Slot {
+        std::atomic<int> ts{-1};
+        std::atomic<int> expected{0};
+        std::atomic<int> current{0};  // only increased by the receiving thread
+        // only used to wake up the waiters of this slot, the receiving thread skips it if there is none
+        std::atomic<int> num_waiters{0};
+        std::mutex mu;
+        std::condition_variable cond;
+    };
+    static const int kNumSlots = 1024;
+    std::unique_ptr<Slot[]> slots_{new Slot[kNumSlots]};
+    std::atomic<int> next_ts_{0};
+
+    void WaitSlot(Slot& slot, const std::function<bool()>& done);
+
+    // the id of the request in the trace, ts is only unique in the customer
+    uint64_t TraceId(int ts) { return (static_cast<uint64_t>(mailbox_.get_thread_id()) << 32) | ts; }
 
     // some info
     int channel_id_;
@@ -1,4 +1,5 @@
 #include "consistency_controller.hpp"
+#include "core/tracer.hpp"
 
 #include <mutex>
 #include <condition_variable>
@@ -12,6 +13,7 @@ class BSPConsistencyController : public AbstractConsistencyController {
     virtual void BeforePush(int tid) override {
         // Acquire lock
         std::unique_lock<std::mutex> lck(mtx_);
+        husky::TraceScope scope("bsp wait push", "consistency", "tid", tid, true);
         while (reply_phase_) {
             cv_.wait(lck);
         }
@@ -31,6 +33,7 @@ class BSPConsistencyController : public AbstractConsistencyController {
     virtual void BeforePull(int tid) override {
         // Acquire lock
         std::unique_lock<std::mutex> lck(mtx_);
+        husky::TraceScope scope("bsp wait pull", "consistency", "tid", tid, true);
         while (!reply_phase_) {
             cv_.wait(lck);
         }
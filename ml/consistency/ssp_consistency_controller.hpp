@@ -1,5 +1,8 @@
 #include "consistency_controller.hpp"
+#include "core/tracer.hpp"
+#include "kvstore/clock_window.hpp"
 
+#include <cassert>
 #include <mutex>
 #include <condition_variable>
 #include <vector>
@@ -9,6 +12,10 @@ namespace consistency {
 
 class SSPConsistencyController : public AbstractConsistencyController {
    public:
+    explicit SSPConsistencyController(int staleness = 1) : staleness_(staleness), clock_count_(staleness + 1) {
+        assert(staleness_ >= 0);
+    }
+
     /*
      * In SSPConsistencyController, only AfterPush is needed since Push will never be blocked.
      *
@@ -21,13 +28,12 @@ class SSPConsistencyController : public AbstractConsistencyController {
     virtual void AfterPush(int tid) override {
         // Acquire lock
         std::unique_lock<std::mutex> lck(mtx_);
-        if (tid > worker_progress_.size())
+        if (tid >= worker_progress_.size())
             worker_progress_.resize(tid + 1);
         int progress = worker_progress_[tid];
-        if (progress >= clock_count_.size())
-            clock_count_.resize(progress + 1);
         clock_count_[progress] += 1;
         if (progress == min_clock_ && clock_count_[min_clock_] == num_local_workers_) {
+            clock_count_.PopFront();
             min_clock_ += 1;
             // release all pull blocked at min_clock_
             cv_.notify_all();
@@ -55,6 +61,7 @@ class SSPConsistencyController : public AbstractConsistencyController {
         if (tid >= worker_progress_.size())
             worker_progress_.resize(tid + 1);
         int expected_min_lock = worker_progress_[tid] - staleness_;
+        husky::TraceScope scope("ssp wait", "consistency", "tid", tid, true);
         while (expected_min_lock > min_clock_) {
             cv_.wait(lck);
         }
@@ -64,8 +71,8 @@ class SSPConsistencyController : public AbstractConsistencyController {
     std::mutex mtx_;
     std::condition_variable cv_;
     std::vector<int> worker_progress_;
-    std::vector<int> clock_count_;
     int staleness_ = 1;
+    kvstore::ClockWindow<int> clock_count_;  // the clocks from min_clock_ on, at most staleness_ + 1
     int min_clock_ = 0;
 };
 
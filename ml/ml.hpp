@@ -10,6 +10,7 @@
 #include "core/utility.hpp"
 
 #include "ml/mlworker/mlworker.hpp"
+#include "ml/mlworker/allreduce.hpp"
 #include "ml/mlworker/hogwild.hpp"
 #include "ml/mlworker/spmt.hpp"
 #include "ml/mlworker/ps.hpp"
@@ -51,6 +52,8 @@ CreateMLWorker(const husky::Info& info, const husky::TableInfo& table_info) {
             husky::LOG_I << "table_info error: " << table_info.DebugString();
             assert(false);
         }
+    } else if (table_info.mode_type == husky::ModeType::AllReduce) {
+        mlworker.reset(new ml::mlworker::AllReduceWorker<Val>(info, table_info));
     } else {
         husky::LOG_I << "table_info error: " << table_info.DebugString();
         assert(false);
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "core/info.hpp"
+#include "husky/base/exception.hpp"
+
+#include "ml/mlworker/mlworker.hpp"
+
+#include "kvstore/kvstore.hpp"
+
+#include "core/color.hpp"
+
+namespace ml {
+namespace mlworker {
+
+/*
+ * AllReduceWorker: BSP without the servers for dense models
+ *
+ * Every worker keeps a full replica of the model. Push accumulates the updates locally, and
+ * the next Pull sums the updates of all the workers with a ring allreduce (see kvstore::Collective)
+ * and applies them to the replica, so the traffic per worker doesn't grow with the number of workers.
+ *
+ * The model is read from the kvstore by the first worker and broadcast at the beginning,
+ * and the first worker pushes the change back to the kvstore at the end, so the kvstore
+ * should use an add hint, e.g. default_add_vector.
+ *
+ * Like PSBspWorker, the usage should be Pull, Push, Pull, Push... on all the workers.
+ */
+template<typename Val>
+class AllReduceWorker : public mlworker::GenericMLWorker<Val> {
+   public:
+    AllReduceWorker() = delete;
+    AllReduceWorker(const AllReduceWorker&) = delete;
+    AllReduceWorker& operator=(const AllReduceWorker&) = delete;
+    AllReduceWorker(AllReduceWorker&&) = delete;
+    AllReduceWorker& operator=(AllReduceWorker&&) = delete;
+
+    AllReduceWorker(const husky::Info& info, const husky::TableInfo& table_info)
+        : info_(info),
+          model_id_(table_info.kv_id) {
+        if (table_info.consistency != husky::Consistency::BSP) {
+            throw husky::base::HuskyException("[AllReduce] only BSP is supported: " + table_info.DebugString());
+        }
+        size_t num_params = table_info.dims;
+        kvworker_ = kvstore::KVStore::Get().get_kvworker(info.get_local_id());
+        // the group is the workers of this task, ranked by cluster_id
+        std::vector<int> tids;
+        for (int i = 0; i < info.get_num_workers(); ++ i)
+            tids.push_back(kvstore::KVStore::Get().get_kvworker_tid(info.get_tid(i)));
+        collective_.reset(new kvstore::Collective(
+            *kvstore::KVStore::Get().get_kvworker_mailbox(info.get_local_id()), tids, info.get_cluster_id(), model_id_));
+
+        // 1. Load
+        if (collective_->rank() == 0) {
+            std::vector<husky::constants::Key> keys(num_params);
+            for (size_t i = 0; i < num_params; ++ i)
+                keys[i] = i;
+            kvworker_->Wait(model_id_, kvworker_->Pull(model_id_, keys, &params_));
+        }
+        collective_->Broadcast(&params_);
+        init_params_ = params_;
+        delta_.resize(num_params);
+
+        if (info.get_cluster_id() == 0) {
+            husky::LOG_I << CLAY("[AllReduce] model_id: "+std::to_string(model_id_)
+                    +"; num_workers: "+std::to_string(collective_->size())
+                    +"; model_size: "+std::to_string(num_params));
+        }
+    }
+
+    ~AllReduceWorker() {
+        // the last Push, all the workers have it pending as well
+        if (pending_)
+            Sync();
+        // 2. Dump
+        if (collective_->rank() == 0) {
+            std::vector<husky::constants::Key> keys;
+            std::vector<Val> vals;
+            for (size_t i = 0; i < params_.size(); ++ i) {
+                if (params_[i] != init_params_[i]) {
+                    keys.push_back(i);
+                    vals.push_back(params_[i] - init_params_[i]);
+                }
+            }
+            kvworker_->Wait(model_id_, kvworker_->Push(model_id_, keys, vals));
+        }
+    }
+
+    virtual void Push(const std::vector<husky::constants::Key>& keys, const std::vector<Val>& vals) override {
+        assert(keys.size() == vals.size());
+        for (size_t i = 0; i < keys.size(); ++ i)
+            delta_[keys[i]] += vals[i];
+        pending_ = true;
+    }
+
+    virtual void Pull(const std::vector<husky::constants::Key>& keys, std::vector<Val>* vals) override {
+        if (pending_)
+            Sync();
+        vals->resize(keys.size());
+        for (size_t i = 0; i < keys.size(); ++ i)
+            (*vals)[i] = params_[keys[i]];
+    }
+
+    // For v2
+    virtual void Prepare_v2(const std::vector<husky::constants::Key>& keys) override {
+        keys_ = const_cast<std::vector<husky::constants::Key>*>(&keys);
+        if (pending_)
+            Sync();
+    }
+    virtual Val Get_v2(size_t idx) override { return params_[(*keys_)[idx]]; }
+    virtual void Update_v2(size_t idx, Val val) override {
+        delta_[(*keys_)[idx]] += val;
+        pending_ = true;
+    }
+    virtual void Update_v2(const std::vector<Val>& vals) override {
+        assert(vals.size() == keys_->size());
+        Push(*keys_, vals);
+    }
+    virtual void Clock_v2() override { pending_ = true; }
+
+   private:
+    /*
+     * Sum the pending updates of all the workers and apply them
+     */
+    void Sync() {
+        collective_->AllReduce(&delta_);
+        for (size_t i = 0; i < params_.size(); ++ i)
+            params_[i] += delta_[i];
+        std::fill(delta_.begin(), delta_.end(), Val());
+        pending_ = false;
+    }
+
+    const husky::Info& info_;
+    int model_id_;
+    kvstore::KVWorker* kvworker_ = nullptr;
+    std::unique_ptr<kvstore::Collective> collective_;
+
+    std::vector<Val> params_;       // the replica
+    std::vector<Val> init_params_;  // the replica when loaded, to push the change at the end
+    std::vector<Val> delta_;        // the updates since the last Sync
+    bool pending_ = false;
+
+    // For v2
+    std::vector<husky::constants::Key>* keys_;
+};
+
+}  // namespace mlworker
+}  // namespace ml
@@ -0,0 +1,97 @@
+#include "gtest/gtest.h"
+
+#include "ml/mlworker/allreduce.hpp"
+
+#include "boost/thread.hpp"
+#include "core/instance.hpp"
+#include "core/info.hpp"
+#include "core/utility.hpp"
+
+namespace husky {
+namespace {
+
+class TestAllReduce: public testing::Test {
+   public:
+    TestAllReduce() {}
+    ~TestAllReduce() {}
+
+   protected:
+    void SetUp() {
+        zmq_context = new zmq::context_t;
+        worker_info = new WorkerInfo;
+        // 1. Create WorkerInfo
+        worker_info->add_worker(0,0,0);
+        worker_info->add_worker(0,1,1);
+        worker_info->set_process_id(0);
+
+        // 2. Create Mailbox
+        el = new MailboxEventLoop(zmq_context);
+        el->set_process_id(0);
+        recver = new CentralRecver(zmq_context, "inproc://test");
+        // 3. Start KVStore
+        kvstore::KVStore::Get().Start(*worker_info, el, zmq_context);
+    }
+
+    void TearDown() {
+        kvstore::KVStore::Get().Stop();
+        delete worker_info;
+        delete el;
+        delete recver;
+        delete zmq_context;
+    }
+
+   public:
+    WorkerInfo* worker_info;
+    zmq::context_t* zmq_context;
+    MailboxEventLoop* el;
+    CentralRecver * recver;
+};
+
+TEST_F(TestAllReduce, PushPull) {
+    int dims = 10;
+    int kv1 = kvstore::KVStore::Get().CreateKVStore<float>("default_add_vector", -1, -1, dims, 2);
+    // Create a task
+    husky::Task task(0);
+    task.set_total_epoch(1);
+    // Create an Instance
+    husky::Instance instance;
+    instance.add_thread(0, 0, 0);  // pid, tid, cid
+    instance.add_thread(0, 1, 1);  // pid, tid, cid
+    instance.set_task(task);
+    // Create a TableInfo
+    TableInfo table_info {
+        kv1, dims,
+        husky::ModeType::AllReduce,
+        husky::Consistency::BSP,
+        husky::WorkerType::None,
+        husky::ParamType::None
+    };
+    int iters = 5;
+    auto run = [this, &instance, &table_info, iters, dims](int tid) {
+        husky::Info info = husky::utility::instance_to_info(instance, *worker_info, {tid, tid}, tid == 0);
+        ml::mlworker::AllReduceWorker<float> worker(info, table_info);
+        std::vector<husky::constants::Key> keys;
+        for (int i = 0; i < dims; ++ i)
+            keys.push_back(i);
+        std::vector<float> vals;
+        for (int i = 0; i < iters; ++ i) {
+            worker.Pull(keys, &vals);
+            // the Push of both workers in the last round
+            EXPECT_EQ(vals, std::vector<float>(dims, 2.0 * i));
+            worker.Push(keys, std::vector<float>(dims, 1.0));
+        }
+    };
+    boost::thread t1(run, 0);
+    boost::thread t2(run, 1);
+    t1.join();
+    t2.join();
+
+    // the model is pushed back to the kvstore
+    auto* kvworker = kvstore::KVStore::Get().get_kvworker(0);
+    std::vector<float> res;
+    kvworker->Wait(kv1, kvworker->Pull(kv1, {0, 9}, &res));
+    EXPECT_EQ(res, std::vector<float>({2.0f * iters, 2.0f * iters}));
+}
+
+}  // namespace
+}  // namespace husky
@@ -34,12 +34,17 @@ class HogwildWorker : public SPMTWorker<Val> {
             int model_id = table_info.kv_id;
             chunk_size_ = kvstore::RangeManager::Get().GetChunkSize(model_id);
             p_chunk_params_ = static_cast<model::ChunkBasedMTModel<Val>*>(shared_state_.Get()->p_model_)->GetParamsPtr();
+        } else if (table_info.kEnableNumaReplicas) {
+            p_replicated_ = static_cast<model::ReplicatedIntegralModel<Val>*>(shared_state_.Get()->p_model_);
+            p_replicated_->BindThread(info_.get_local_id(), info_.get_num_local_workers());
         } else {
             p_integral_params_ = static_cast<model::IntegralModel<Val>*>(shared_state_.Get()->p_model_)->GetParamsPtr();
         }
     }
 
     ~HogwildWorker() {
+        if (p_replicated_)
+            p_replicated_->UnbindThread();
     }
 
     virtual void Push(const std::vector<husky::constants::Key>& keys, const std::vector<Val>& vals) override {
@@ -52,17 +57,21 @@ class HogwildWorker : public SPMTWorker<Val> {
     // For v2
     virtual void Prepare_v2(const std::vector<husky::constants::Key>& keys) override {
         keys_ = const_cast<std::vector<husky::constants::Key>*>(&keys);
-        if (!p_integral_params_)
+        if (!p_integral_params_ && !p_replicated_)
             static_cast<model::ChunkBasedMTModel<Val>*>(shared_state_.Get()->p_model_)->Prepare(keys, info_.get_local_id());
     }
     virtual Val Get_v2(size_t idx) override { 
-        if (p_integral_params_)
+        if (p_replicated_)
+            return p_replicated_->Get((*keys_)[idx]);
+        else if (p_integral_params_)
             return (*p_integral_params_)[(*keys_)[idx]];
         else
             return (*p_chunk_params_)[(*keys_)[idx]/chunk_size_][(*keys_)[idx]%chunk_size_];
     }
     virtual void Update_v2(size_t idx, Val val) override { 
-        if (p_integral_params_)
+        if (p_replicated_)
+            p_replicated_->Update((*keys_)[idx], val);
+        else if (p_integral_params_)
             (*p_integral_params_)[(*keys_)[idx]] += val;
         else
             (*p_chunk_params_)[(*keys_)[idx]/chunk_size_][(*keys_)[idx]%chunk_size_] += val;
@@ -70,12 +79,16 @@ class HogwildWorker : public SPMTWorker<Val> {
     virtual void Update_v2(const std::vector<Val>& vals) override {
         throw husky::base::HuskyException("Not implemented in Hogwild");
     }
-    virtual void Clock_v2() override {}
+    virtual void Clock_v2() override {
+        if (p_replicated_)
+            p_replicated_->Clock();
+    }
 
    private:
     // A pointer points to the parameter directly
     std::vector<Val>* p_integral_params_ = nullptr;
     std::vector<std::vector<Val>>* p_chunk_params_ = nullptr;
+    model::ReplicatedIntegralModel<Val>* p_replicated_ = nullptr;  // with kEnableNumaReplicas
     int chunk_size_ = -1;  // Only for ChunkBasedModel
 };
 
@@ -29,6 +29,12 @@ class GenericMLWorker {
     virtual void Pull(const std::vector<husky::constants::Key>& keys, std::vector<Val>* vals) {
         throw husky::base::HuskyException("Pull Not implemented");
     }
+    /*
+     * Hand over the keys of the next Pull early, so that a worker can fetch them in the background
+     *
+     * Only a hint, ignored by default
+     */
+    virtual void Prefetch(const std::vector<husky::constants::Key>& keys) {}
 
     virtual void PushChunks(const std::vector<husky::constants::Key>& keys, const std::vector<std::vector<Val>*>& vals) {
         throw husky::base::HuskyException("Push Not implemented");
@@ -17,6 +17,13 @@ namespace mlworker {
  * SSP may have other workers
  *
  * Assume that in each epoch, Pull will be invoked first and then the Push.
+ *
+ * Pipelined mode: call Prefetch with the keys of the next mini-batch (e.g. from
+ * BatchDataSampler::prepare_next_batch) and the next Pull with the same keys takes the
+ * prefetched vals, while Push no longer waits for the servers (at most one Push in flight).
+ * Under ASP the prefetch is sent at once and overlaps the current computation. Under SSP/BSP
+ * it is sent right after the current Push, so the servers check it at the new clock and the
+ * staleness bound still holds.
  */
 template<typename Val>
 class PSWorker : public mlworker::GenericMLWorker<Val> {
@@ -28,7 +35,7 @@ class PSWorker : public mlworker::GenericMLWorker<Val> {
     PSWorker& operator=(PSWorker&&) = delete;
 
     PSWorker(const husky::Info& info, const husky::TableInfo& table_info)
-        : model_id_(table_info.kv_id) {
+        : model_id_(table_info.kv_id), consistency_(table_info.consistency) {
         // set kvworker
         int local_id = info.get_local_id();
         kvworker_ = kvstore::KVStore::Get().get_kvworker(local_id);
@@ -38,20 +45,74 @@ class PSWorker : public mlworker::GenericMLWorker<Val> {
         } else {
             send_all_ = false;
         }
+        if (table_info.kEnablePullCombiner && table_info.consistency != husky::Consistency::BSP) {  // BSP has PSBspWorker
+            pull_combiner_ = kvstore::KVStore::Get().GetPullCombiner<Val>(model_id_, info.get_num_local_workers());
+            ssp_ = table_info.consistency == husky::Consistency::SSP;
+        }
+        if (table_info.kEnablePushCombiner && table_info.consistency == husky::Consistency::ASP) {
+            push_combiner_ = kvstore::KVStore::Get().GetPushCombiner<Val>(model_id_);
+        }
+    }
+    ~PSWorker() {
+        DropPrefetch_();
+        if (ts_ != -1)  // the last Push in pipelined mode
+            kvworker_->Wait(model_id_, ts_);
+        if (push_combiner_)  // send what is left
+            FlushPushCombiner_();
     }
 
     virtual void Push(const std::vector<husky::constants::Key>& keys, const std::vector<Val>& vals) override {
         assert(push_count_ + 1 == pull_count_);
         push_count_ += 1;
-        ts_ = kvworker_->Push(model_id_, keys, vals, send_all_, true);
-        kvworker_->Wait(model_id_, ts_);
+        if (push_combiner_) {  // flushed to the servers by size or time
+            ts_ = push_combiner_->Push(kvworker_, keys, vals);
+        } else {
+            if (pipelined_ && ts_ != -1)
+                kvworker_->Wait(model_id_, ts_);  // the previous Push
+            ts_ = kvworker_->Push(model_id_, keys, vals, send_all_, true);
+            if (!pipelined_)
+                kvworker_->Wait(model_id_, ts_);
+        }
+        if (prefetch_deferred_)
+            SendPrefetch_();
+    }
+
+    /*
+     * Pull keys (sorted) for the next iteration in the background, see the pipelined mode above
+     *
+     * The keys are copied. Not combined with the PullCombiner.
+     */
+    virtual void Prefetch(const std::vector<husky::constants::Key>& keys) override {
+        if (pull_combiner_)
+            return;
+        pipelined_ = true;
+        DropPrefetch_();
+        prefetch_keys_ = keys;
+        if (consistency_ != husky::Consistency::ASP && push_count_ != pull_count_)
+            prefetch_deferred_ = true;  // wait for the Push of this clock
+        else
+            SendPrefetch_();
     }
-    
+
     virtual void Pull(const std::vector<husky::constants::Key>& keys, std::vector<Val>* vals) override {
         assert(push_count_ == pull_count_);
         pull_count_ += 1;
+        if (push_combiner_)  // the clock boundary, so the Pull sees the Push of the last clock
+            FlushPushCombiner_();
+        if (prefetch_ts_ != -1 && keys == prefetch_keys_) {
+            kvworker_->Wait(model_id_, prefetch_ts_);
+            prefetch_ts_ = -1;
+            vals->swap(prefetch_vals_);  // the old buffer of the caller is reused by the next Prefetch
+            return;
+        }
+        DropPrefetch_();
         if (ts_ != -1)
             kvworker_->Wait(model_id_, ts_);  // Wait for last Push, TODO: Will this cause anything wrong when changing epochs?
+        if (pull_combiner_) {  // the Pull of the same clock are merged under SSP
+            pull_combiner_->Pull(kvworker_, keys, vals, send_all_, ssp_ ? pull_count_ : -1);
+            ts_ = -1;
+            return;
+        }
         ts_ = kvworker_->Pull(model_id_, keys, vals, send_all_, true);
         kvworker_->Wait(model_id_, ts_);  // Wait for this Pull
     }
@@ -93,7 +154,33 @@ class PSWorker : public mlworker::GenericMLWorker<Val> {
     virtual void Clock_v2() override { Push(*keys_, delta_); }
 
    private:
+    /*
+     * Send the updates accumulated in the PushCombiner (also by the other threads) and wait for them
+     */
+    void FlushPushCombiner_() {
+        if (ts_ != -1)  // a flush by the last Push
+            kvworker_->Wait(model_id_, ts_);
+        ts_ = push_combiner_->Flush(kvworker_);
+        if (ts_ != -1)
+            kvworker_->Wait(model_id_, ts_);
+        ts_ = -1;
+    }
+
+    void SendPrefetch_() {
+        prefetch_deferred_ = false;
+        prefetch_ts_ = kvworker_->Pull(model_id_, prefetch_keys_, &prefetch_vals_, send_all_, true);
+    }
+
+    // the servers may still be writing into prefetch_vals_
+    void DropPrefetch_() {
+        prefetch_deferred_ = false;
+        if (prefetch_ts_ != -1)
+            kvworker_->Wait(model_id_, prefetch_ts_);
+        prefetch_ts_ = -1;
+    }
+
     int model_id_;
+    husky::Consistency consistency_;
     kvstore::KVWorker* kvworker_ = nullptr;
 
     // Just to restrict the usage of the Push/Pull APIs,
@@ -103,6 +190,19 @@ class PSWorker : public mlworker::GenericMLWorker<Val> {
     int ts_ = -1;
     bool send_all_ = true;
 
+    // process-level Pull merging, nullptr if disabled
+    kvstore::PullCombiner<Val>* pull_combiner_ = nullptr;
+    bool ssp_ = false;
+    // process-level Push merging, nullptr if disabled
+    kvstore::PushCombiner<Val>* push_combiner_ = nullptr;
+
+    // pipelined mode, set by the first Prefetch
+    bool pipelined_ = false;
+    bool prefetch_deferred_ = false;  // under SSP/BSP, sent by the next Push
+    int prefetch_ts_ = -1;
+    std::vector<husky::constants::Key> prefetch_keys_;
+    std::vector<Val> prefetch_vals_;  // the back buffer
+
     // For v2
     // Pointer to keys
     std::vector<husky::constants::Key>* keys_;
@@ -448,6 +548,8 @@ class PSNoneChunkWorker : public mlworker::GenericMLWorker<Val> {
         if (info.is_leader()) {
             PSState* state = new PSState;
             state->p_model_ = new model::ChunkBasedPSModel<Val>(model_id_, num_params);
+            if (table_info.kEnableEagerSSP && table_info.consistency == husky::Consistency::SSP)
+                state->p_model_->Subscribe(info.get_local_id());
             state->p_push_buffer_ = new model::PushBuffer<Val>(model_id_, num_params);
             // 1. Init
             shared_state_.Init(state);
@@ -462,6 +564,8 @@ class PSNoneChunkWorker : public mlworker::GenericMLWorker<Val> {
     }
 
     ~PSNoneChunkWorker() {
+        if (info_.is_leader())  // the subscriber, before the others may delete the model
+            shared_state_.Get()->p_model_->Unsubscribe();
         shared_state_.Barrier();
         if (info_.get_local_tids().at(0) == info_.get_global_id()) {
             delete shared_state_.Get()->p_model_;
@@ -568,6 +672,8 @@ class PSMapChunkWorker : public mlworker::GenericMLWorker<Val> {
         if (info.is_leader()) {
             PSState* state = new PSState;
             state->p_model_ = new model::ChunkBasedPSModel<Val>(model_id_, num_params);
+            if (table_info.kEnableEagerSSP && table_info.consistency == husky::Consistency::SSP)
+                state->p_model_->Subscribe(info.get_local_id());
             // 1. Init
             shared_state_.Init(state);
         }
@@ -581,6 +687,8 @@ class PSMapChunkWorker : public mlworker::GenericMLWorker<Val> {
     }
 
     ~PSMapChunkWorker() {
+        if (info_.is_leader())  // the subscriber, before the others may delete the model
+            shared_state_.Get()->p_model_->Unsubscribe();
         shared_state_.Barrier();
         if (info_.get_local_tids().at(0) == info_.get_global_id()) {
             delete shared_state_.Get()->p_model_;
@@ -714,6 +822,8 @@ class PSChunkChunkWorker : public mlworker::GenericMLWorker<Val> {
         if (info.is_leader()) {
             PSState* state = new PSState;
             state->p_model_ = new model::ChunkBasedPSModel<Val>(model_id_, num_params);
+            if (table_info.kEnableEagerSSP && table_info.consistency == husky::Consistency::SSP)
+                state->p_model_->Subscribe(info.get_local_id());
             // 1. Init
             shared_state_.Init(state);
         }
@@ -728,6 +838,8 @@ class PSChunkChunkWorker : public mlworker::GenericMLWorker<Val> {
     }
 
     ~PSChunkChunkWorker() {
+        if (info_.is_leader())  // the subscriber, before the others may delete the model
+            shared_state_.Get()->p_model_->Unsubscribe();
         shared_state_.Barrier();
         if (info_.get_local_tids().at(0) == info_.get_global_id()) {
             delete shared_state_.Get()->p_model_;
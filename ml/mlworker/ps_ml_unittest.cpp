@@ -90,6 +90,75 @@ TEST_F(TestPS, Construct) {
     ml::mlworker::PSMapNoneWorker<float> worker4(info, table_info);
 }
 
+TEST_F(TestPS, PSWorkerPrefetch) {
+    int dims = 10;
+    int kv1 = kvstore::KVStore::Get().CreateKVStore<float>("default_add_vector", -1, -1, dims, 2);
+    // Create a task
+    husky::Task task(0);
+    task.set_total_epoch(1);
+    // Create an Instance
+    husky::Instance instance;
+    instance.add_thread(0, 0, 0);  // pid, tid, cid
+    instance.set_task(task);
+    // Create an Info
+    husky::Info info = husky::utility::instance_to_info(instance, *worker_info, {0, 0}, true);
+    // Create a TableInfo
+    TableInfo table_info {
+        kv1, dims,
+        husky::ModeType::PS, 
+        husky::Consistency::ASP, 
+        husky::WorkerType::PSWorker, 
+        husky::ParamType::None
+    };
+    ml::mlworker::PSWorker<float> worker(info, table_info);
+    std::vector<std::vector<husky::constants::Key>> batches = {{0, 2, 4}, {1, 2, 3}, {5, 9}};
+    std::vector<float> vals;
+    worker.Prefetch(batches[0]);
+    for (int i = 0; i < batches.size(); ++ i) {
+        worker.Pull(batches[i], &vals);
+        EXPECT_EQ(vals.size(), batches[i].size());
+        if (i + 1 < batches.size())
+            worker.Prefetch(batches[i + 1]);  // overlaps the computation below
+        worker.Push(batches[i], std::vector<float>(batches[i].size(), 1.0));
+    }
+    // a Pull with other keys than the prefetched ones falls back to a normal Pull
+    worker.Prefetch({0});
+    worker.Pull({0, 1, 2}, &vals);
+    EXPECT_EQ(vals, std::vector<float>({1.0, 1.0, 2.0}));
+    worker.Push({0}, {1.0});
+}
+
+TEST_F(TestPS, PSWorkerPushCombiner) {
+    int dims = 10;
+    int kv1 = kvstore::KVStore::Get().CreateKVStore<float>("default_add_vector", -1, -1, dims, 2);
+    // Create a task
+    husky::Task task(0);
+    task.set_total_epoch(1);
+    // Create an Instance
+    husky::Instance instance;
+    instance.add_thread(0, 0, 0);  // pid, tid, cid
+    instance.set_task(task);
+    // Create an Info
+    husky::Info info = husky::utility::instance_to_info(instance, *worker_info, {0, 0}, true);
+    // Create a TableInfo
+    TableInfo table_info {
+        kv1, dims,
+        husky::ModeType::PS, 
+        husky::Consistency::ASP, 
+        husky::WorkerType::PSWorker, 
+        husky::ParamType::None
+    };
+    table_info.kEnablePushCombiner = true;
+    ml::mlworker::PSWorker<float> worker(info, table_info);
+    std::vector<float> vals;
+    for (int i = 0; i < 3; ++ i) {
+        // the Push of the last clock are flushed before the Pull, not only by size or time
+        worker.Pull({0, 1}, &vals);
+        EXPECT_EQ(vals, std::vector<float>(2, i));
+        worker.Push({0, 1}, {1.0, 1.0});
+    }
+}
+
 void testPushPull(ml::mlworker::GenericMLWorker<float>* worker) {
     // PushPull
     std::vector<husky::constants::Key> keys = {0,10,20,30,40,50,60,70,80,90};
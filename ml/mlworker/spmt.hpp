@@ -18,6 +18,7 @@
 #include "ml/model/chunk_based_mt_model.hpp"
 #include "ml/shared/shared_state.hpp"
 #include "ml/model/model_with_cm.hpp"
+#include "ml/model/replicated_model.hpp"
 
 #include "kvstore/kvstore.hpp"
 
@@ -77,7 +78,7 @@ class SPMTWorker : public mlworker::GenericMLWorker<Val> {
                 if (table_info.consistency == husky::Consistency::BSP) {
                     state->p_controller_  = new consistency::BSPConsistencyController;
                 } else if (table_info.consistency == husky::Consistency::SSP) {
-                    state->p_controller_ = new consistency::SSPConsistencyController;
+                    state->p_controller_ = new consistency::SSPConsistencyController(table_info.kStaleness);
                 } else if (table_info.consistency == husky::Consistency::ASP) {
                     state->p_controller_ = new consistency::ASPConsistencyController;
                 } else {
@@ -95,7 +96,10 @@ class SPMTWorker : public mlworker::GenericMLWorker<Val> {
                 if (is_hogwild_) {
                     state->p_model_ = (model::Model<Val>*) new model::ChunkBasedMTModel<Val>(model_id, num_params);
                 } else {
-                    if (table_info.cache_info.cache_strategy == husky::CacheStrategy::None) {
+                    if (table_info.cache_info.cache_strategy == husky::CacheStrategy::None && table_info.kEnableLockFreeModel) {
+                        state->p_model_ = (model::Model<Val>*) new model::ChunkBasedMTAtomicModel<Val>(model_id, num_params);
+                        husky::LOG_I << "Using ChunkBasedMTAtomicModel";
+                    } else if (table_info.cache_info.cache_strategy == husky::CacheStrategy::None) {
                         state->p_model_ = (model::Model<Val>*) new model::ChunkBasedMTLockModel<Val>(model_id, num_params);
                         husky::LOG_I << "Using ChunkBasedMTLockModel";
                     } else {
@@ -119,8 +123,12 @@ class SPMTWorker : public mlworker::GenericMLWorker<Val> {
                 }
             } else {
                 // Use Integral model
-                if (is_hogwild_)
+                if (is_hogwild_ && table_info.kEnableNumaReplicas)
+                    state->p_model_ = (model::Model<Val>*) new model::ReplicatedIntegralModel<Val>(model_id, num_params, table_info.kReplicaMergeInterval);
+                else if (is_hogwild_)
                     state->p_model_ = (model::Model<Val>*) new model::IntegralModel<Val>(model_id, num_params);
+                else if (table_info.kEnableLockFreeModel)
+                    state->p_model_ = (model::Model<Val>*) new model::ChunkBasedMTAtomicModel<Val>(model_id, num_params);
                 else
                     state->p_model_ = (model::Model<Val>*) new model::ChunkBasedMTLockModel<Val>(model_id, num_params);
             }
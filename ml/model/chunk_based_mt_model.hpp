@@ -1,6 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include <cassert>
+#include <memory>
 #include <vector>
 
 #include "boost/thread/shared_mutex.hpp"
@@ -204,5 +206,166 @@ class ChunkBasedMTLockModel : public ChunkBasedMTModel<Val> {
     }
 };
 
+/*
+ * ChunkBasedMTAtomicModel
+ *
+ * Lock-free ChunkBasedMTModel for multi-threads, for hot chunks on which ChunkBasedMTLockModel
+ * serializes the threads
+ *
+ * Push adds to each param with an atomic CAS loop, so concurrent updates are never lost.
+ * Pull reads a chunk under its seqlock: the writers of a chunk bump begin before and end after
+ * their updates, and a reader retries if a writer was active during the read, so the values
+ * read from a chunk are a consistent snapshot. A reader that fails kMaxRetries times (a chunk
+ * that is always being written) takes the values as they are, each one is still read atomically.
+ */
+template<typename Val>
+class ChunkBasedMTAtomicModel : public ChunkBasedMTModel<Val> {
+   public:
+    using Model<Val>::model_id_;
+    using ChunkBasedModel<Val>::params_;
+    using ChunkBasedModel<Val>::num_chunks_;
+
+    static_assert(sizeof(Val) == 4 || sizeof(Val) == 8, "ChunkBasedMTAtomicModel needs lock-free atomics on Val");
+    static const int kMaxRetries = 64;
+
+    ChunkBasedMTAtomicModel(int model_id, int num_params):
+        ChunkBasedMTModel<Val>(model_id, num_params),
+        seqlocks_(new SeqLock[num_chunks_]) {}
+
+    void Push(const std::vector<husky::constants::Key>& keys, const std::vector<Val>& vals) override {
+        if (keys.empty()) return;
+        auto& range_manager = kvstore::RangeManager::Get();
+
+        size_t current_chunk_id;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            auto loc = range_manager.GetLocation(model_id_, keys[i]);
+            auto chunk_id = loc.first;
+            if (i == 0 || chunk_id != current_chunk_id) {
+                if (i != 0)
+                    seqlocks_[current_chunk_id].EndWrite();
+                seqlocks_[chunk_id].BeginWrite();
+                current_chunk_id = chunk_id;
+            }
+            AtomicAdd_(&params_[chunk_id][loc.second], vals[i]);
+        }
+        seqlocks_[current_chunk_id].EndWrite();
+    }
+
+    void Pull(const std::vector<husky::constants::Key>& keys, std::vector<Val>* vals, int local_id) override {
+        if (keys.empty()) return;
+        this->Prepare(keys, local_id);
+
+        vals->resize(keys.size());
+
+        auto& range_manager = kvstore::RangeManager::Get();
+        std::vector<std::pair<size_t, size_t>> locs(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i)
+            locs[i] = range_manager.GetLocation(model_id_, keys[i]);
+        // read the keys of each chunk in one snapshot
+        size_t begin = 0;
+        while (begin < keys.size()) {
+            size_t chunk_id = locs[begin].first;
+            size_t end = begin + 1;
+            while (end < keys.size() && locs[end].first == chunk_id)
+                end += 1;
+            auto& chunk = params_[chunk_id];
+            Read_(chunk_id, [&]() {
+                for (size_t i = begin; i < end; ++i)
+                    (*vals)[i] = AtomicLoad_(&chunk[locs[i].second]);
+            });
+            begin = end;
+        }
+    }
+
+    void PushChunks(const std::vector<size_t>& chunk_keys, const std::vector<std::vector<Val>*>& chunk_vals) override {
+        if (chunk_keys.empty()) return;
+        assert(chunk_keys.size() == chunk_vals.size());
+
+        for (size_t i = 0; i < chunk_keys.size(); i++) {
+            auto chunk_id = chunk_keys[i];
+            assert(params_[chunk_id].size() == chunk_vals[i]->size());
+            seqlocks_[chunk_id].BeginWrite();
+            for (size_t j = 0; j < chunk_vals[i]->size(); j++)
+                AtomicAdd_(&params_[chunk_id][j], (*(chunk_vals[i]))[j]);
+            seqlocks_[chunk_id].EndWrite();
+        }
+    }
+
+    void PullChunks(const std::vector<size_t>& chunk_keys, std::vector<std::vector<Val>*>& chunk_vals, int local_id) override {
+        if (chunk_keys.empty()) return;
+        assert(chunk_keys.size() == chunk_vals.size());
+
+        this->PrepareChunks(chunk_keys, local_id);
+
+        for (size_t i = 0; i < chunk_keys.size(); i++) {
+            auto chunk_id = chunk_keys[i];
+            auto& chunk = params_[chunk_id];
+            auto& dst = *(chunk_vals[i]);
+            dst.resize(chunk.size());
+            Read_(chunk_id, [&]() {
+                for (size_t j = 0; j < dst.size(); j++)
+                    dst[j] = AtomicLoad_(&chunk[j]);
+            });
+        }
+    }
+
+   private:
+    /*
+     * The seqlock of a chunk, for many writers: begin - end is the number of active writers
+     * Padded to a cache line so that the hot chunks don't share one
+     */
+    struct SeqLock {
+        std::atomic<uint64_t> begin{0};
+        std::atomic<uint64_t> end{0};
+        char padding[64 - 2 * sizeof(std::atomic<uint64_t>)];
+
+        void BeginWrite() {
+            begin.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);  // before the updates
+        }
+        void EndWrite() { end.fetch_add(1, std::memory_order_release); }
+        // false if a writer is active
+        bool BeginRead(uint64_t* version) const {
+            uint64_t e = end.load(std::memory_order_acquire);
+            *version = begin.load(std::memory_order_acquire);
+            return *version == e;
+        }
+        // true if no writer started since BeginRead
+        bool Validate(uint64_t version) const {
+            std::atomic_thread_fence(std::memory_order_acquire);  // after the reads
+            return begin.load(std::memory_order_relaxed) == version;
+        }
+    };
+
+    template <typename ReadF>
+    void Read_(size_t chunk_id, const ReadF& read) {
+        auto& seqlock = seqlocks_[chunk_id];
+        for (int retry = 0; retry < kMaxRetries; ++ retry) {
+            uint64_t version;
+            if (!seqlock.BeginRead(&version))
+                continue;
+            read();
+            if (seqlock.Validate(version))
+                return;
+        }
+        read();
+    }
+
+    static void AtomicAdd_(Val* param, Val delta) {
+        Val old_val, new_val;
+        __atomic_load(param, &old_val, __ATOMIC_RELAXED);
+        do {
+            new_val = old_val + delta;
+        } while (!__atomic_compare_exchange(param, &old_val, &new_val, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    }
+    static Val AtomicLoad_(Val* param) {
+        Val val;
+        __atomic_load(param, &val, __ATOMIC_RELAXED);
+        return val;
+    }
+
+    std::unique_ptr<SeqLock[]> seqlocks_;
+};
+
 }  // namespace model
 }  // namespace ml
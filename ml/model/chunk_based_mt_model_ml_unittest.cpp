@@ -77,7 +77,8 @@ TEST_F(TestChunkBasedMTModel, PullPush) {
     EXPECT_EQ(vals, res);
 }
 
-void push_pull_job(ChunkBasedMTLockModel<float>* model, std::vector<husky::constants::Key> keys, int local_id) {
+template <typename ModelT>
+void push_pull_job(ModelT* model, std::vector<husky::constants::Key> keys, int local_id) {
     std::vector<float> res;
     std::vector<float> update(keys.size(), 1.0);
     for (int i = 0; i < 10; ++i) {
@@ -101,9 +102,9 @@ TEST_F(TestChunkBasedMTModel, MTPushPull) {
     std::vector<husky::constants::Key> even_keys(num_params / 2);
     for (int i = 0; i < num_params / 2; ++i) { even_keys[i] = 2 * i; }
 
-    boost::thread t1(push_pull_job, &model, all_keys, 0);
-    boost::thread t2(push_pull_job, &model, odd_keys, 1);
-    boost::thread t3(push_pull_job, &model, even_keys, 2);
+    boost::thread t1(push_pull_job<ChunkBasedMTLockModel<float>>, &model, all_keys, 0);
+    boost::thread t2(push_pull_job<ChunkBasedMTLockModel<float>>, &model, odd_keys, 1);
+    boost::thread t3(push_pull_job<ChunkBasedMTLockModel<float>>, &model, even_keys, 2);
 
     t1.join();
     t2.join();
@@ -113,5 +114,63 @@ TEST_F(TestChunkBasedMTModel, MTPushPull) {
     model.Pull(all_keys, &res, 0);
     EXPECT_EQ(res, std::vector<float>(all_keys.size(), 20.0));
 }
+
+TEST_F(TestChunkBasedMTModel, AtomicMTPushPull) {
+    ChunkBasedMTAtomicModel<float> model(kv, num_params);
+
+    std::vector<husky::constants::Key> all_keys(num_params);
+    for (int i = 0; i < num_params; ++i) { all_keys[i] = i; }
+    std::vector<husky::constants::Key> odd_keys(num_params / 2);
+    for (int i = 0; i < num_params / 2; ++i) { odd_keys[i] = 2 * i + 1; }
+    std::vector<husky::constants::Key> even_keys(num_params / 2);
+    for (int i = 0; i < num_params / 2; ++i) { even_keys[i] = 2 * i; }
+
+    boost::thread t1(push_pull_job<ChunkBasedMTAtomicModel<float>>, &model, all_keys, 0);
+    boost::thread t2(push_pull_job<ChunkBasedMTAtomicModel<float>>, &model, odd_keys, 1);
+    boost::thread t3(push_pull_job<ChunkBasedMTAtomicModel<float>>, &model, even_keys, 2);
+    t1.join();
+    t2.join();
+    t3.join();
+
+    std::vector<float> res;
+    model.Pull(all_keys, &res, 0);
+    EXPECT_EQ(res, std::vector<float>(all_keys.size(), 20.0));
+}
+
+TEST_F(TestChunkBasedMTModel, AtomicHotChunk) {
+    ChunkBasedMTAtomicModel<float> model(kv, num_params);
+    // the threads share one chunk, prepared beforehand so that they don't use the kvworkers
+    std::vector<husky::constants::Key> hot_keys(chunk_size);
+    for (int i = 0; i < chunk_size; ++i) { hot_keys[i] = i; }
+    std::vector<float> res;
+    model.Pull(hot_keys, &res, 0);
+
+    const int num_threads = 8;
+    const int num_iters = 1000;
+    std::vector<boost::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&model, &hot_keys, t]() {
+            std::vector<float> update(hot_keys.size(), 1.0);
+            std::vector<float> vals;
+            std::vector<std::vector<float>*> update_chunk{&update};
+            std::vector<std::vector<float>*> vals_chunk{&vals};
+            for (int i = 0; i < num_iters; ++i) {
+                if (i % 2 == 0)
+                    model.Push(hot_keys, update);
+                else
+                    model.PushChunks({0}, update_chunk);
+                model.PullChunks({0}, vals_chunk, 0);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    std::vector<std::vector<float>> chunk(1);
+    std::vector<std::vector<float>*> chunk_ptrs{&chunk[0]};
+    model.PullChunks({0}, chunk_ptrs, 0);
+    EXPECT_EQ(chunk[0], std::vector<float>(chunk_size, num_threads * num_iters));
+}
+
 }  // namespace model
 }  // namespace ml
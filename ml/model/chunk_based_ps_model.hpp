@@ -74,7 +74,38 @@ class ChunkBasedPSModel {
     ChunkBasedPSModel(int model_id, int num_params):
         model_id_(model_id), num_params_(num_params),
         num_chunks_(kvstore::RangeManager::Get().GetChunkNum(model_id)),
-        params_(num_chunks_), fetch_mgr_(num_chunks_), chunk_clocks_(num_chunks_, -1), mtx_(num_chunks_) {}
+        params_(num_chunks_), fetch_mgr_(num_chunks_), chunk_clocks_(num_chunks_, -1),
+        chunk_versions_(num_chunks_, kvstore::ChunkVersions::kNoVersion), mtx_(num_chunks_) {}
+
+    ~ChunkBasedPSModel() {
+        assert(eager_local_id_ == -1);  // Unsubscribe before, the handler holds this
+    }
+
+    /*
+     * Eager SSP: subscribe to the whole model through the kvworker of local_id,
+     * so the servers push the modified chunks to this process cache whenever their min_clock advances
+     * and the pulls mostly find the chunks fresh enough without a round-trip
+     */
+    void Subscribe(int local_id) {
+        std::vector<size_t> chunk_ids(num_chunks_);
+        for (size_t i = 0; i < chunk_ids.size(); ++ i)
+            chunk_ids[i] = i;
+        auto* kvworker = kvstore::KVStore::Get().get_kvworker(local_id);
+        eager_local_id_ = local_id;
+        kvworker->Wait(model_id_, kvworker->Subscribe<Val>(model_id_, chunk_ids,
+                    [this](kvstore::EagerChunks<Val>& chunks) { apply_eager_chunks(chunks); }));
+    }
+
+    /*
+     * Stop the pushes of Subscribe, by the thread that subscribed, no-op if not subscribed
+     */
+    void Unsubscribe() {
+        if (eager_local_id_ == -1)
+            return;
+        auto* kvworker = kvstore::KVStore::Get().get_kvworker(eager_local_id_);
+        kvworker->Wait(model_id_, kvworker->Subscribe<Val>(model_id_, {}, nullptr));
+        eager_local_id_ = -1;
+    }
 
     int PullWithMinClock(const std::vector<husky::constants::Key>& keys, std::vector<Val>* vals, int local_id, int min_clock) {
         // Prepare the keys
@@ -253,17 +284,27 @@ class ChunkBasedPSModel {
             chunks_to_fetch.swap(chunks_to_wait);
         }
     }
+    /*
+     * Only the chunks modified since the cached versions are shipped by the servers,
+     * the clocks of the unmodified chunks are advanced as well
+     */
     int fetch_chunk(const std::vector<size_t>& chunks, int local_id) {
         int clock;
         // 1. get kvworker
         auto* kvworker = kvstore::KVStore::Get().get_kvworker(local_id);
 
-        // 2. pull chunks
+        // 2. pull the modified chunks
         std::vector<std::vector<Val>*> chunk_ptrs;
         chunk_ptrs.reserve(chunks.size());
         std::vector<std::vector<Val>> tmp_chunks(chunks.size());
-        for (int i = 0; i < chunks.size(); ++i) { chunk_ptrs.push_back(&tmp_chunks[i]); }
-        auto ts = kvworker->PullChunksWithMinClock(this->model_id_, chunks, chunk_ptrs, &clock);
+        std::vector<uint32_t> versions(chunks.size());
+        for (int i = 0; i < chunks.size(); ++i) {
+            chunk_ptrs.push_back(&tmp_chunks[i]);
+            boost::lock_guard<boost::mutex> chunk_lock(mtx_[chunks[i]]);
+            versions[i] = chunk_versions_[chunks[i]];
+        }
+        std::vector<uint32_t> held_versions = versions;
+        auto ts = kvworker->PullChunksIfModified(this->model_id_, chunks, chunk_ptrs, &versions, &clock);
         kvworker->Wait(this->model_id_, ts);
 
         // 3. update chunk clocks
@@ -272,12 +313,40 @@ class ChunkBasedPSModel {
             boost::lock_guard<boost::mutex> chunk_lock(mtx_[chunk_id]);
             if (chunk_clocks_[chunk_id] < clock) {
                 chunk_clocks_[chunk_id] = clock;
-                params_[chunk_id] = std::move(tmp_chunks[i]);
+                if (versions[i] != held_versions[i]) {  // modified
+                    params_[chunk_id] = std::move(tmp_chunks[i]);
+                    chunk_versions_[chunk_id] = versions[i];
+                }
             }
         }
         return clock;
     }
 
+    /*
+     * Apply the chunks pushed by a server, invoked on the receiving thread of the kvworker
+     */
+    void apply_eager_chunks(kvstore::EagerChunks<Val>& chunks) {
+        size_t chunk_size = kvstore::RangeManager::Get().GetChunkSize(model_id_);
+        size_t start = 0;
+        for (size_t i = 0; i < chunks.kvs.keys.size(); ++ i) {
+            size_t chunk_id = chunks.kvs.keys[i];
+            size_t real_chunk_size = chunk_id == num_chunks_ - 1 ? chunks.kvs.vals.size() - start : chunk_size;
+            boost::lock_guard<boost::mutex> chunk_lock(mtx_[chunk_id]);
+            if (chunk_clocks_[chunk_id] < chunks.min_clock) {
+                chunk_clocks_[chunk_id] = chunks.min_clock;
+                params_[chunk_id].assign(chunks.kvs.vals.begin() + start, chunks.kvs.vals.begin() + start + real_chunk_size);
+                chunk_versions_[chunk_id] = chunks.versions[i];
+            }
+            start += real_chunk_size;
+        }
+        for (auto chunk_id : chunks.unmodified) {
+            boost::lock_guard<boost::mutex> chunk_lock(mtx_[chunk_id]);
+            // the cached copy is the one last pushed or a newer fetched one
+            if (chunk_versions_[chunk_id] != kvstore::ChunkVersions::kNoVersion && chunk_clocks_[chunk_id] < chunks.min_clock)
+                chunk_clocks_[chunk_id] = chunks.min_clock;
+        }
+    }
+
     void print_debug_info(const std::vector<size_t>& chunks_to_fetch, 
             const std::vector<size_t>& chunks_to_fetch_real, 
             const std::vector<size_t>& chunks_to_wait,
@@ -317,12 +386,16 @@ class ChunkBasedPSModel {
     int num_chunks_;
     std::vector<std::vector<Val>> params_;
     std::vector<int> chunk_clocks_;
+    std::vector<uint32_t> chunk_versions_;  // the server versions of params_, for PullChunksIfModified
     std::vector<boost::mutex> mtx_;
 
     // for fetch_mgr
     boost::mutex fetch_mgr_mtx_;
     boost::condition_variable fetch_mgr_cv_;
     std::vector<std::list<std::pair<int, int>>> fetch_mgr_;
+
+    // for Eager SSP
+    int eager_local_id_ = -1;
 };
 
 template<typename Val>
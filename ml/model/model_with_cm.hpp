@@ -1,15 +1,24 @@
 #pragma once
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <atomic>
 #include <cassert>
-#include <unordered_map>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <utility>
-#include <stdio.h>
 #include <vector>
 
 #include "boost/iterator/indirect_iterator.hpp"
 #include "core/constants.hpp"
+#include "husky/base/exception.hpp"
 #include "ml/model/chunk_based_mt_model.hpp"
 #include "kvstore/kvstore.hpp"
 
@@ -18,68 +27,140 @@ namespace model {
 
 enum CacheStatus { InKVStore = 0, InDisk = 1 };
 
+/*
+ * ChunkFileEditor
+ *
+ * Spill the evicted chunks to a memory-mapped file, for ModelWithCM to hold models larger than RAM
+ *
+ * The file (unlinked on creation, in dir, or TMPDIR, or /tmp) is sized to the whole model and
+ * each chunk has a fixed slot at chunk_id * chunk_size, so no space is allocated or reused and the
+ * file is sparse: only the written slots take disk space. Reading and writing are memcpy into and
+ * out of the mapping without a lock, the caller must not access a chunk from two threads at once
+ * (ModelWithCM holds the chunk mutex).
+ *
+ * The written slots are handed to a background thread, which starts their write-back and drops
+ * them from the mapping, so that the spilled chunks don't stay in the page tables of the process.
+ * read_chunks asks the kernel to read all the slots ahead (MADV_WILLNEED) before copying the first.
+ */
 template<typename Val>
 class ChunkFileEditor {
    public:
-    ChunkFileEditor(std::vector<std::vector<Val>>* params, int chunk_size, int last_chunk_size, int num_chunks):
-        chunks_ptr_(params), chunk_size_(chunk_size), last_chunk_size_(last_chunk_size), num_chunks_(num_chunks) {
-            file_ = tmpfile();
-            if (file_ == NULL) {
-                throw husky::base::HuskyException("Cannot create tmp file");
-            }
+    ChunkFileEditor(std::vector<std::vector<Val>>* params, int chunk_size, int last_chunk_size, int num_chunks,
+                    const std::string& dir = ""):
+        chunks_ptr_(params), chunk_size_(chunk_size), last_chunk_size_(last_chunk_size), num_chunks_(num_chunks),
+        written_(num_chunks, 0) {
+        std::string path = dir;
+        if (path.empty())
+            path = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+        path += "/husky_chunks_XXXXXX";
+        fd_ = mkstemp(&path[0]);
+        if (fd_ == -1)
+            throw husky::base::HuskyException("Cannot create chunk file in " + path);
+        unlink(path.c_str());
+        size_ = (static_cast<size_t>(chunk_size_) * (num_chunks_ - 1) + last_chunk_size_) * sizeof(Val);
+        if (size_ > 0) {
+            if (ftruncate(fd_, size_) != 0)
+                throw husky::base::HuskyException("Cannot resize chunk file to " + std::to_string(size_) + " bytes");
+            void* addr = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+            if (addr == MAP_FAILED)
+                throw husky::base::HuskyException("Cannot mmap chunk file of " + std::to_string(size_) + " bytes");
+            base_ = static_cast<char*>(addr);
+            madvise(base_, size_, MADV_RANDOM);  // the chunks are accessed out of order
         }
+        writeback_thread_ = std::thread(&ChunkFileEditor::WritebackLoop, this);
+    }
 
     ~ChunkFileEditor() {
-        if (file_ != NULL) {
-            fclose(file_);
+        {
+            std::lock_guard<std::mutex> lk(writeback_mtx_);
+            writeback_stopped_ = true;
         }
+        writeback_cond_.notify_one();
+        writeback_thread_.join();
+        if (base_)
+            munmap(base_, size_);
+        close(fd_);
     }
 
     void read_chunks(const std::vector<size_t>& ids) {
-        boost::lock_guard<boost::mutex> lock(mtx_);
         for (auto id : ids) {
-            auto iter = chunk_map_.find(id);
-            if (iter == chunk_map_.end()) throw husky::base::HuskyException("Target chunk is not in disk");
-
+            if (!written_[id]) throw husky::base::HuskyException("Target chunk is not in disk");
+            Advise_(offset(id), size(id) * sizeof(Val), MADV_WILLNEED, false);
+        }
+        for (auto id : ids) {
             // allocate memory to chunk
-            int size = chunk_size_;
-            if (id == num_chunks_ - 1) size = last_chunk_size_;
-            (*chunks_ptr_)[id].resize(size);
-
-            fseek(file_, iter->second, SEEK_SET);
-            fread((*chunks_ptr_)[id].data(), sizeof(Val), size, file_);
+            (*chunks_ptr_)[id].resize(size(id));
+            memcpy((*chunks_ptr_)[id].data(), base_ + offset(id), size(id) * sizeof(Val));
         }
     }
 
     void write_chunks(const std::vector<size_t>& ids) {
-        boost::lock_guard<boost::mutex> lock(mtx_);
+        std::vector<std::pair<size_t, size_t>> ranges;
+        ranges.reserve(ids.size());
         for (auto id : ids) {
-            auto iter = chunk_map_.find(id);
-            // get actual size of chunk
-            int size = chunk_size_;
-            if (id == num_chunks_ - 1) size = last_chunk_size_;
-
-            if (iter != chunk_map_.end()) {  // if the chunk is previously written
-                fseek(file_, iter->second, SEEK_SET);
-                fwrite((*chunks_ptr_)[id].data(), sizeof(Val), size, file_);
-            } else {  // first time to write the chunk
-                chunk_map_[id] = bytes_written_;
-                fseek(file_, 0, SEEK_END);
-                fwrite((*chunks_ptr_)[id].data(), sizeof(Val), size, file_);
-                bytes_written_ += size * sizeof(Val);
-            }
+            assert((*chunks_ptr_)[id].size() == size(id));
+            memcpy(base_ + offset(id), (*chunks_ptr_)[id].data(), size(id) * sizeof(Val));
+            written_[id] = 1;
+            ranges.push_back({offset(id), size(id) * sizeof(Val)});
         }
+        {
+            std::lock_guard<std::mutex> lk(writeback_mtx_);
+            writeback_queue_.insert(writeback_queue_.end(), ranges.begin(), ranges.end());
+        }
+        writeback_cond_.notify_one();
     }
 
+    // the byte position of the slot of chunk id
+    size_t offset(size_t id) const { return id * chunk_size_ * sizeof(Val); }
+    // the number of params in chunk id
+    size_t size(size_t id) const { return id == num_chunks_ - 1 ? last_chunk_size_ : chunk_size_; }
+
    protected:
-    FILE* file_;
-    boost::mutex mtx_;
-    std::unordered_map<size_t, int> chunk_map_;  // chunk_id, byte position
+    /*
+     * madvise on [offset, offset + len), on the pages inside it if inner (not to affect the neighbour slots)
+     */
+    void Advise_(size_t offset, size_t len, int advice, bool inner) {
+        static const size_t page_size = sysconf(_SC_PAGESIZE);
+        size_t begin = inner ? (offset + page_size - 1) / page_size * page_size : offset / page_size * page_size;
+        size_t end = inner ? (offset + len) / page_size * page_size : offset + len;
+        if (begin < end)
+            madvise(base_ + begin, end - begin, advice);
+    }
+
+    void WritebackLoop() {
+        while (true) {
+            std::vector<std::pair<size_t, size_t>> ranges;
+            {
+                std::unique_lock<std::mutex> lk(writeback_mtx_);
+                writeback_cond_.wait(lk, [this] { return writeback_stopped_ || !writeback_queue_.empty(); });
+                if (writeback_queue_.empty())  // stopped and drained
+                    break;
+                ranges.swap(writeback_queue_);
+            }
+            for (auto& range : ranges) {
+#ifdef SYNC_FILE_RANGE_WRITE
+                sync_file_range(fd_, range.first, range.second, SYNC_FILE_RANGE_WRITE);  // start the write-back
+#endif
+                Advise_(range.first, range.second, MADV_DONTNEED, true);  // the data stays in the file
+            }
+        }
+    }
+
+    int fd_ = -1;
+    char* base_ = nullptr;
+    size_t size_ = 0;  // bytes of the mapping
     std::vector<std::vector<Val>> * chunks_ptr_ = NULL;
-    int bytes_written_ = 0;
-    int last_chunk_size_;
     int chunk_size_;
+    int last_chunk_size_;
     int num_chunks_;
+    std::vector<char> written_;  // whether the slot of a chunk has been written
+
+    // write-back
+    std::thread writeback_thread_;
+    std::mutex writeback_mtx_;
+    std::condition_variable writeback_cond_;
+    std::vector<std::pair<size_t, size_t>> writeback_queue_;  // offset, bytes
+    bool writeback_stopped_ = false;
 };
 
 template<typename Val>
@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
 
+#include <thread>
+
 #include "husky/core/mailbox.hpp"
 #include "husky/core/worker_info.hpp"
 #include "kvstore/kvstore.hpp"
@@ -73,8 +75,6 @@ class TestModelWithCM : public testing::Test {
     husky::MailboxEventLoop* el;
     husky::CentralRecver* recver;
 };
-/*
-
 TEST_F(TestChunkFileEditor, ReadWrite) {
     int num_chunks = 10;
     int chunk_size = 20;
@@ -108,6 +108,50 @@ TEST_F(TestChunkFileEditor, ReadWrite) {
     EXPECT_EQ(chunks, origin);
 }
 
+TEST_F(TestChunkFileEditor, Concurrent) {
+    size_t num_chunks = 64;
+    int chunk_size = 1000;
+    std::vector<std::vector<float>> chunks(num_chunks);
+    ChunkFileEditor<float> edi(&chunks, chunk_size, chunk_size, num_chunks);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {  // each thread spills and reads back its own chunks
+            for (int round = 0; round < 10; ++round) {
+                for (size_t id = t; id < num_chunks; id += 4) {
+                    chunks[id].assign(chunk_size, id * 100 + round);
+                    edi.write_chunks({id});
+                    chunks[id].clear();
+                }
+                for (size_t id = t; id < num_chunks; id += 4) {
+                    edi.read_chunks({id});
+                    ASSERT_EQ(chunks[id], std::vector<float>(chunk_size, id * 100 + round));
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+}
+
+TEST_F(TestChunkFileEditor, LargeOffset) {
+    // 2.2GB in total, the file is sparse so only the written chunks take space
+    size_t num_chunks = 1100;
+    int chunk_size = 1 << 19;
+    std::vector<std::vector<float>> chunks(num_chunks);
+    ChunkFileEditor<float> edi(&chunks, chunk_size, 1, num_chunks);
+    EXPECT_GT(edi.offset(num_chunks - 1), size_t(1) << 31);
+    chunks[num_chunks - 2].assign(chunk_size, 1.0);
+    chunks[num_chunks - 1].assign(1, 2.0);
+    edi.write_chunks({num_chunks - 2, num_chunks - 1});
+    chunks[num_chunks - 2].clear();
+    chunks[num_chunks - 1].clear();
+    edi.read_chunks({num_chunks - 1, num_chunks - 2});
+    EXPECT_EQ(chunks[num_chunks - 2], std::vector<float>(chunk_size, 1.0));
+    EXPECT_EQ(chunks[num_chunks - 1], std::vector<float>(1, 2.0));
+    EXPECT_THROW(edi.read_chunks({0}), husky::base::HuskyException);
+}
+
+/*
 TEST_F(TestModelWithCM, Start) {}  // For Setup and TearDown
 */
 
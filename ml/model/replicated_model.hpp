@@ -0,0 +1,218 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "core/numa.hpp"
+#include "ml/model/integral_model.hpp"
+
+namespace ml {
+namespace model {
+
+/*
+ * ReplicatedIntegralModel
+ *
+ * IntegralModel for Hogwild on multi-socket machines, with one replica per NUMA node
+ *
+ * Each thread calls BindThread once, which pins it to the cpus of its node. The first thread of a
+ * node copies the params into the replica of the node, so that its pages are first touched (and
+ * allocated) on the node. Then the threads Push/Pull on the replica of their node only, in the
+ * Hogwild manner, and the updates are also accumulated in a delta of the replica.
+ *
+ * The replicas are merged every merge_interval Push/Clock on a node, by the thread that reaches it:
+ * the deltas are added to params_, then each replica is reset to params_ plus its new delta.
+ * Like Hogwild, an update racing with the merge may be lost. Dump merges all before dumping.
+ * A thread that is not bound uses params_ directly. The binding is per model, and UnbindThread
+ * restores the affinity the thread had before BindThread.
+ */
+template<typename Val>
+class ReplicatedIntegralModel : public IntegralModel<Val> {
+   public:
+    using IntegralModel<Val>::params_;
+
+    ReplicatedIntegralModel(int model_id, int num_params, int merge_interval = 1000):
+        IntegralModel<Val>(model_id, num_params),
+        merge_interval_(merge_interval) {
+        int num_nodes = husky::NumaTopology::Get().num_nodes();
+        for (int i = 0; i < num_nodes; ++i)
+            replicas_.emplace_back(new Replica);
+    }
+
+    /*
+     * Pin the calling thread to its node and prepare the replica, after Load
+     */
+    void BindThread(int local_id, int num_local_workers) {
+        auto& topology = husky::NumaTopology::Get();
+        int node = topology.NodeOf(local_id, num_local_workers);
+        Binding binding;
+        if (!UnbindThread_(&binding))  // if bound again, keep the affinity before the first BindThread
+            binding.restore = husky::NumaTopology::GetThreadAffinity(&binding.affinity);
+        binding.node = node;
+        topology.PinThread(node);
+        Bindings_().emplace_back(this, binding);
+        auto& replica = *replicas_[node];
+        std::call_once(replica.init, [this, &replica]() {  // on the node, for the first touch
+            replica.params = params_;
+            replica.delta.assign(params_.size(), Val());
+            replica.ready.store(true);
+        });
+    }
+    void UnbindThread() {
+        Binding binding;
+        if (UnbindThread_(&binding) && binding.restore)
+            husky::NumaTopology::SetThreadAffinity(binding.affinity);
+    }
+
+    void Push(const std::vector<husky::constants::Key>& keys, const std::vector<Val>& vals) override {
+        Replica* replica = CurrentReplica_();
+        if (!replica) {
+            IntegralModel<Val>::Push(keys, vals);
+            return;
+        }
+        for (size_t i = 0; i < keys.size(); ++i) {
+            assert(keys[i] < replica->params.size());
+            replica->params[keys[i]] += vals[i];
+            replica->delta[keys[i]] += vals[i];
+        }
+        Clock();
+    }
+
+    void Pull(const std::vector<husky::constants::Key>& keys, std::vector<Val>* vals, int local_id) override {
+        Replica* replica = CurrentReplica_();
+        if (!replica) {
+            IntegralModel<Val>::Pull(keys, vals, local_id);
+            return;
+        }
+        vals->resize(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            assert(keys[i] < replica->params.size());
+            (*vals)[i] = replica->params[keys[i]];
+        }
+    }
+
+    /*
+     * Direct access to the replica of the calling thread, for the v2 APIs
+     */
+    Val Get(husky::constants::Key key) {
+        Replica* replica = CurrentReplica_();
+        return replica ? replica->params[key] : params_[key];
+    }
+    void Update(husky::constants::Key key, Val val) {
+        Replica* replica = CurrentReplica_();
+        if (!replica) {
+            params_[key] += val;
+            return;
+        }
+        replica->params[key] += val;
+        replica->delta[key] += val;
+    }
+
+    /*
+     * Count a Push/Clock of the calling thread and merge if its node reaches merge_interval
+     */
+    void Clock() {
+        Replica* replica = CurrentReplica_();
+        if (!replica || merge_interval_ <= 0)
+            return;
+        if ((replica->clocks.fetch_add(1, std::memory_order_relaxed) + 1) % merge_interval_ != 0)
+            return;
+        std::unique_lock<std::mutex> lk(merge_mu_, std::try_to_lock);
+        if (lk.owns_lock())  // skip if another node is merging
+            Merge_();
+    }
+
+    /*
+     * Merge all the updates into params_, call when no thread updates
+     */
+    void Merge() {
+        std::lock_guard<std::mutex> lk(merge_mu_);
+        Merge_();
+    }
+
+    void Dump(int local_id, int task_id, const std::string& hint) override {
+        Merge();
+        IntegralModel<Val>::Dump(local_id, task_id, hint);
+    }
+
+    int get_num_replicas() const { return replicas_.size(); }
+
+   private:
+    struct Replica {
+        std::vector<Val> params;
+        std::vector<Val> delta;  // updates not merged into params_ yet
+        std::atomic<int64_t> clocks{0};
+        std::atomic<bool> ready{false};
+        std::once_flag init;
+    };
+
+    struct Binding {
+        int node = -1;
+        cpu_set_t affinity;  // of the thread before BindThread
+        bool restore = false;  // whether affinity was read
+    };
+
+    // the bindings of the calling thread, by model, few so a vector
+    static std::vector<std::pair<const ReplicatedIntegralModel*, Binding>>& Bindings_() {
+        thread_local std::vector<std::pair<const ReplicatedIntegralModel*, Binding>> bindings;
+        return bindings;
+    }
+    // remove the binding of the calling thread to this model, return false if not bound
+    bool UnbindThread_(Binding* binding = nullptr) {
+        auto& bindings = Bindings_();
+        for (auto it = bindings.begin(); it != bindings.end(); ++it) {
+            if (it->first == this) {
+                if (binding)
+                    *binding = it->second;
+                bindings.erase(it);
+                return true;
+            }
+        }
+        return false;
+    }
+    // the node the calling thread is bound to for this model, -1 if not bound
+    int CurrentNode_() const {
+        for (auto& binding : Bindings_()) {
+            if (binding.first == this)
+                return binding.second.node;
+        }
+        return -1;
+    }
+    // nullptr if the thread is not bound to this model, or its replica is not prepared
+    Replica* CurrentReplica_() {
+        int node = CurrentNode_();
+        if (node == -1 || !replicas_[node]->ready.load(std::memory_order_acquire))
+            return nullptr;
+        return replicas_[node].get();
+    }
+
+    void Merge_() {
+        for (auto& replica : replicas_) {
+            if (!replica->ready.load())
+                continue;
+            auto& delta = replica->delta;
+            for (size_t i = 0; i < delta.size(); ++i) {
+                Val d = delta[i];
+                if (d != Val()) {
+                    delta[i] -= d;  // not = 0, to keep the updates since the read
+                    params_[i] += d;
+                }
+            }
+        }
+        for (auto& replica : replicas_) {
+            if (!replica->ready.load())
+                continue;
+            for (size_t i = 0; i < params_.size(); ++i)
+                replica->params[i] = params_[i] + replica->delta[i];
+        }
+    }
+
+    int merge_interval_;
+    std::vector<std::unique_ptr<Replica>> replicas_;  // one per node
+    std::mutex merge_mu_;
+};
+
+}  // namespace model
+}  // namespace ml
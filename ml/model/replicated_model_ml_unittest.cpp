@@ -0,0 +1,98 @@
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <vector>
+
+#include "core/numa.hpp"
+#include "ml/model/replicated_model.hpp"
+
+namespace ml {
+namespace model {
+
+class TestReplicatedModel : public testing::Test {
+   public:
+    TestReplicatedModel() {}
+    ~TestReplicatedModel() {}
+};
+
+TEST_F(TestReplicatedModel, NumaTopology) {
+    EXPECT_EQ(husky::NumaTopology::ParseCpuList("0-3,8,10-11\n"), std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+    auto& topology = husky::NumaTopology::Get();
+    EXPECT_GE(topology.num_nodes(), 1);
+    EXPECT_FALSE(topology.get_cpus(0).empty());
+    // spread evenly, the consecutive threads share a node
+    int last = 0;
+    for (int i = 0; i < 16; ++i) {
+        int node = topology.NodeOf(i, 16);
+        EXPECT_GE(node, last);
+        EXPECT_LT(node, topology.num_nodes());
+        last = node;
+    }
+    EXPECT_EQ(topology.NodeOf(15, 16), topology.num_nodes() - 1);
+}
+
+TEST_F(TestReplicatedModel, PushPullMerge) {
+    const int num_params = 100;
+    const int num_threads = 4;
+    ReplicatedIntegralModel<float> model(0, num_params, 10);
+    model.GetParamsPtr()->assign(num_params, 1.0);  // as loaded
+    std::vector<husky::constants::Key> keys(num_params);
+    for (int i = 0; i < num_params; ++i) { keys[i] = i; }
+
+    // one at a time, the updates of the threads on a node don't race
+    for (int t = 0; t < num_threads; ++t) {
+        std::thread thread([&model, &keys, t]() {
+            model.BindThread(t, num_threads);
+            std::vector<float> vals;
+            model.Pull(keys, &vals, t);
+            EXPECT_GE(vals[0], 1.0);
+            for (int i = 0; i < 25; ++i)
+                model.Push(keys, std::vector<float>(keys.size(), 1.0));
+            model.Update(keys[0], 1.0);
+            model.Pull(keys, &vals, t);
+            // the replica sees its own updates
+            EXPECT_GE(vals[0], 27.0);
+            model.UnbindThread();
+        });
+        thread.join();
+    }
+    model.Merge();
+    std::vector<float> expected(num_params, 1.0 + num_threads * 25);
+    expected[0] += num_threads;
+    EXPECT_EQ(*model.GetParamsPtr(), expected);
+
+    // not bound, on params_
+    std::vector<float> vals;
+    model.Pull(keys, &vals, 0);
+    EXPECT_EQ(vals, expected);
+}
+
+TEST_F(TestReplicatedModel, BindPerModel) {
+    const int num_params = 10;
+    ReplicatedIntegralModel<float> bound(0, num_params, 0);
+    ReplicatedIntegralModel<float> other(1, num_params, 0);
+    bound.GetParamsPtr()->assign(num_params, 0.0);
+    other.GetParamsPtr()->assign(num_params, 0.0);
+    std::thread thread([&]() {
+        // narrower than the node, so that BindThread changes it
+        cpu_set_t before, after;
+        CPU_ZERO(&before);
+        CPU_SET(husky::NumaTopology::Get().get_cpus(0).front(), &before);
+        ASSERT_TRUE(husky::NumaTopology::SetThreadAffinity(before));
+        bound.BindThread(0, 1);
+        // the binding to bound doesn't apply to other, which is updated in place
+        other.Update(0, 1.0);
+        EXPECT_EQ((*other.GetParamsPtr())[0], 1.0);
+        bound.Update(0, 1.0);
+        EXPECT_EQ((*bound.GetParamsPtr())[0], 0.0);  // in the replica
+        bound.UnbindThread();
+        ASSERT_TRUE(husky::NumaTopology::GetThreadAffinity(&after));
+        EXPECT_TRUE(CPU_EQUAL(&before, &after));
+    });
+    thread.join();
+    bound.Merge();
+    EXPECT_EQ((*bound.GetParamsPtr())[0], 1.0);
+}
+
+}  // namespace model
+}  // namespace ml
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "core/tracer.hpp"
 #include "husky/base/exception.hpp"
 #include "husky/core/zmq_helpers.hpp"
 
@@ -90,6 +91,7 @@ class SharedState {
      * Process level Barrier
      */
     void Barrier() {
+        husky::TraceScope scope("Barrier", "task", "task_id", task_id_);
         if (is_leader_ == true) {  // leader
             std::vector<std::string> identity_store;
             for (int i = 0; i < num_threads_ - 1; ++i) {
@@ -1,5 +1,8 @@
 #include "worker/engine.hpp"
 
+#include "core/tracer.hpp"
+#include "kvstore/metrics.hpp"
+
 namespace husky {
 
 void Engine::Submit() {
@@ -9,9 +12,13 @@ void Engine::Submit() {
 void Engine::Exit() {
     StopWorker();
     StopCoordinator();
+    StopTracer();
+    StopMetrics();
 }
 
 Engine::Engine() {
+    StartTracer();
+    StartMetrics();
     StartWorker();
     StartCoordinator();
 }
@@ -40,6 +47,36 @@ void Engine::StartWorker() {
 void Engine::StartCoordinator() { 
     Context::get_coordinator()->serve(); 
 }
+void Engine::StartTracer() {
+    if (Context::get_param("trace_path").empty())
+        return;
+    std::string sample_every = Context::get_param("trace_sample_every");
+    int proc_id = Context::get_worker_info().get_process_id();
+    Tracer::Get().SetProcess(proc_id, Context::get_param("hostname") + " proc " + std::to_string(proc_id));
+    Tracer::Get().Enable(sample_every.empty() ? 1 : std::stoi(sample_every));
+}
+void Engine::StopTracer() {
+    if (!Tracer::Enabled())
+        return;
+    Tracer::Get().Disable();
+    Tracer::Get().WriteChromeTrace(Context::get_param("trace_path") + "." +
+                                   std::to_string(Context::get_worker_info().get_process_id()) + ".json");
+}
+void Engine::StartMetrics() {
+    if (Context::get_param("metrics_path").empty())
+        return;
+    std::string interval_ms = Context::get_param("metrics_interval_ms");
+    kvstore::Metrics::Enable();
+    kvstore::Metrics::Get().StartDump(Context::get_param("metrics_path") + "." +
+                                          std::to_string(Context::get_worker_info().get_process_id()) + ".prom",
+                                      interval_ms.empty() ? 10000 : std::stoi(interval_ms));
+}
+void Engine::StopMetrics() {
+    if (!kvstore::Metrics::Enabled())
+        return;
+    kvstore::Metrics::Get().StopDump();  // writes the final values
+    kvstore::Metrics::Enable(false);
+}
 void Engine::StopWorker() {
     worker->send_exit(); 
 }
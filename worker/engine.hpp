@@ -60,6 +60,20 @@ class Engine {
 
     void StartCoordinator();
 
+    /*
+     * Enable the Tracer if trace_path is set (and trace_sample_every, default 1),
+     * the trace is written to trace_path.<proc_id>.json on Exit
+     */
+    void StartTracer();
+    void StopTracer();
+
+    /*
+     * Enable the kvstore Metrics if metrics_path is set, they are written in the Prometheus text
+     * format to metrics_path.<proc_id>.prom every metrics_interval_ms (default 10000) and on Exit
+     */
+    void StartMetrics();
+    void StopMetrics();
+
     // Function to stop the worker
     void StopWorker();
 
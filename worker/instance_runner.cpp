@@ -1,5 +1,7 @@
 #include "worker/instance_runner.hpp"
 
+#include "core/tracer.hpp"
+
 namespace husky {
 
 /*
@@ -30,6 +32,8 @@ void InstanceRunner::run_instance(std::shared_ptr<Instance> instance) {
                           std::to_string(local_threads.size()) + "/" + std::to_string(instance->get_num_threads()) +
                           " current epoch " + std::to_string(instance->get_epoch()) + " run on process " +
                           std::to_string(worker_info_.get_process_id()));
+    if (Tracer::Enabled())
+        Tracer::Get().Instant("run instance", "task", "instance_id", instance->get_id());
     bool is_leader = true;  // the first thread in each process is the leader
     for (auto tid_cid : local_threads) {
         // worker threads must not be joinable (must be free)
@@ -49,8 +53,13 @@ void InstanceRunner::assign_worker(const std::pair<int, int>& tid_cid, std::shar
     if (instance->get_type() == Task::Type::AutoParallelismTaskType) {
         units_[tid_cid.first] = boost::thread([this, instance, tid_cid, is_leader] {
             Info info = utility::instance_to_info(*instance, worker_info_, tid_cid, is_leader);
+            if (Tracer::Enabled())
+                Tracer::Get().SetThreadName("worker " + std::to_string(tid_cid.first));
             auto& lambda = static_cast<AutoParallelismTask*>(task_store_.get_task(instance->get_id()).get())->get_epoch_lambda();
-            lambda(info, static_cast<AutoParallelismTask*>(instance->get_task())->get_current_stage_iters());
+            {
+                TraceScope scope("instance", "task", "instance_id", instance->get_id());
+                lambda(info, static_cast<AutoParallelismTask*>(instance->get_task())->get_current_stage_iters());
+            }
 
             zmq::socket_t socket = cluster_manager_connector_.get_socket_to_recv();
             zmq_sendmore_int32(&socket, constants::kThreadFinished);
@@ -61,13 +70,18 @@ void InstanceRunner::assign_worker(const std::pair<int, int>& tid_cid, std::shar
         units_[tid_cid.first] = boost::thread([this, instance, tid_cid, is_leader] {
             // set the info
             Info info = utility::instance_to_info(*instance, worker_info_, tid_cid, is_leader);
+            if (Tracer::Enabled())
+                Tracer::Get().SetThreadName("worker " + std::to_string(tid_cid.first));
 
             // if (info.get_cluster_id() == 0)
             //     husky::LOG_I << "[Running Task] current_epoch: "+std::to_string(info.get_current_epoch()) + "
             //     starts!";
 
             // run the UDF!!!
-            task_store_.get_func(instance->get_id())(info);
+            {
+                TraceScope scope("instance", "task", "instance_id", instance->get_id());
+                task_store_.get_func(instance->get_id())(info);
+            }
 
             // if (info.get_cluster_id() == 0)
             //     husky::LOG_I << "[Running Task] current_epoch: "+std::to_string(info.get_current_epoch()) + "
@@ -86,6 +100,8 @@ void InstanceRunner::assign_worker(const std::pair<int, int>& tid_cid, std::shar
  * Finish a thread and join the unit
  */
 void InstanceRunner::finish_thread(int instance_id, int tid) {
+    if (Tracer::Enabled())
+        Tracer::Get().Instant("thread finished", "task", "instance_id", instance_id);
     instance_keeper_[instance_id].erase(tid);
     // husky::LOG_I << "[InstanceRunner]: instance_id: " + std::to_string(instance_id) + " tid: "+
     // std::to_string(tid) + " finished");